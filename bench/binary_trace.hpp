@@ -0,0 +1,169 @@
+#pragma once
+
+#include "./trace.hpp"
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// pre parsed trace, so loading is a mmap instead of parsing json
+//
+// layout (native endian):
+//   Header
+//   ActorID[actor_count]
+//   padding to 8
+//   Op[op_count]
+namespace trace::binary {
+
+static constexpr char c_magic[8] {'G', 'C', 'R', 'D', 'T', 'T', 'R', '1'};
+static constexpr uint32_t c_version {2}; // 2: INSERT_ORIGINS, 48 byte ops
+
+struct Header {
+	char magic[8];
+	uint32_t version {c_version};
+	uint32_t actor_count {0};
+	uint64_t op_count {0};
+	uint64_t inserts {0};
+	uint64_t deletes {0};
+};
+static_assert(sizeof(Header) == 40);
+
+inline size_t opsOffset(size_t actor_count) {
+	const size_t offset = sizeof(Header) + actor_count * sizeof(ActorID);
+	return (offset + alignof(Op) - 1) & ~(alignof(Op) - 1);
+}
+
+// true if the file starts with the magic
+inline bool isBinaryTrace(const std::string& path) {
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr) {
+		return false;
+	}
+
+	char magic[sizeof(c_magic)] {};
+	const bool r = std::fread(magic, sizeof(magic), 1, file) == 1 && std::memcmp(magic, c_magic, sizeof(c_magic)) == 0;
+	std::fclose(file);
+	return r;
+}
+
+inline bool save(const std::string& path, const View& trace) {
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr) {
+		return false;
+	}
+
+	Header header;
+	std::memcpy(header.magic, c_magic, sizeof(c_magic));
+	header.actor_count = trace.actor_count;
+	header.op_count = trace.op_count;
+	header.inserts = trace.inserts;
+	header.deletes = trace.deletes;
+
+	const size_t padding = opsOffset(trace.actor_count) - (sizeof(Header) + trace.actor_count * sizeof(ActorID));
+	const char zeros[alignof(Op)] {};
+
+	bool r = std::fwrite(&header, sizeof(header), 1, file) == 1;
+	r = r && std::fwrite(trace.actors, sizeof(ActorID), trace.actor_count, file) == trace.actor_count;
+	r = r && std::fwrite(zeros, 1, padding, file) == padding;
+	r = r && std::fwrite(trace.ops, sizeof(Op), trace.op_count, file) == trace.op_count;
+
+	return std::fclose(file) == 0 && r;
+}
+
+// keeps the file mapped as long as it lives
+struct MappedTrace {
+	void* _data {nullptr};
+	size_t _size {0};
+
+	View view;
+
+	MappedTrace(void) = default;
+	MappedTrace(const MappedTrace&) = delete;
+	MappedTrace& operator=(const MappedTrace&) = delete;
+
+	~MappedTrace(void) {
+		close();
+	}
+
+	bool open(const std::string& path) {
+		close();
+
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+
+		struct stat st {};
+		if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+			::close(fd);
+			return false;
+		}
+
+		_size = st.st_size;
+		_data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (_data == MAP_FAILED) {
+			_data = nullptr;
+			_size = 0;
+			return false;
+		}
+
+		// read only front to back
+		madvise(_data, _size, MADV_SEQUENTIAL);
+
+		const auto* bytes = static_cast<const uint8_t*>(_data);
+
+		Header header;
+		std::memcpy(&header, bytes, sizeof(header));
+		if (std::memcmp(header.magic, c_magic, sizeof(c_magic)) != 0 || header.version != c_version) {
+			close();
+			return false;
+		}
+
+		const size_t ops_offset = opsOffset(header.actor_count);
+		if (ops_offset > _size || (_size - ops_offset) / sizeof(Op) < header.op_count) {
+			close();
+			return false;
+		}
+
+		view.actors = reinterpret_cast<const ActorID*>(bytes + sizeof(Header));
+		view.actor_count = header.actor_count;
+		view.ops = reinterpret_cast<const Op*>(bytes + ops_offset);
+		view.op_count = header.op_count;
+		view.inserts = header.inserts;
+		view.deletes = header.deletes;
+
+		// dont trust the file
+		for (size_t i = 0; i < view.op_count; i++) {
+			const auto& op = view.ops[i];
+			if (
+				op.type > Op::INSERT_ORIGINS ||
+				op.actor >= view.actor_count ||
+				(op.has_parent_left && op.parent_left_actor >= view.actor_count) ||
+				(op.has_parent_right && op.parent_right_actor >= view.actor_count)
+			) {
+				close();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void close(void) {
+		if (_data != nullptr) {
+			munmap(_data, _size);
+		}
+		_data = nullptr;
+		_size = 0;
+		view = {};
+	}
+};
+
+} // trace::binary
+
@@ -0,0 +1,45 @@
+#define EXTRA_ASSERTS 0
+
+#include "./trace.hpp"
+#include "./jpaper_trace.hpp"
+#include "./binary_trace.hpp"
+
+#include <string>
+#include <iostream>
+
+// one-off, converts the automerge-perf json trace to the binary trace format
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		std::cerr << "usage: " << argv[0] << " <paper.json> <out.bin>\n";
+		return 1;
+	}
+
+	const std::string in_path {argv[1]};
+	const std::string out_path {argv[2]};
+
+	std::cout << "reading '" << in_path << "'...\n";
+	const auto trace_opt = trace::jpaper::load(in_path);
+	if (!trace_opt.has_value()) {
+		std::cerr << "failed to read '" << in_path << "'\n";
+		return 1;
+	}
+	const auto& trace = trace_opt.value();
+
+	std::cout << "writing " << trace.ops.size() << " ops by " << trace.actors.size() << " actors to '" << out_path << "'...\n";
+	if (!trace::binary::save(out_path, trace.view())) {
+		std::cerr << "failed to write '" << out_path << "'\n";
+		return 1;
+	}
+
+	// read it back, so we know it is good
+	trace::binary::MappedTrace mapped;
+	if (!mapped.open(out_path) || mapped.view.op_count != trace.ops.size()) {
+		std::cerr << "failed to read back '" << out_path << "'\n";
+		return 1;
+	}
+
+	std::cout << "done\n";
+
+	return 0;
+}
+
@@ -0,0 +1,39 @@
+#define EXTRA_ASSERTS 0
+
+#include "./trace.hpp"
+#include "./gen_trace.hpp"
+#include "./binary_trace.hpp"
+
+#include <string>
+#include <iostream>
+
+// writes a synthetic concurrent editing trace as binary trace
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		std::cerr << "usage: " << argv[0] << " <key=value,...> <out.bin>\n";
+		std::cerr << "  keys: actors ops initial latency hotspot locality paste paste_max del del_max seed\n";
+		return 1;
+	}
+
+	trace::gen::Config config;
+	if (!trace::gen::parseConfig(argv[1], config)) {
+		std::cerr << "invalid config '" << argv[1] << "'\n";
+		return 1;
+	}
+
+	const std::string out_path {argv[2]};
+
+	std::cout << "generating...\n";
+	const auto trace = trace::gen::generate(config);
+
+	std::cout << "writing " << trace.ops.size() << " ops by " << trace.actors.size() << " actors to '" << out_path << "'...\n";
+	if (!trace::binary::save(out_path, trace.view())) {
+		std::cerr << "failed to write '" << out_path << "'\n";
+		return 1;
+	}
+
+	std::cout << "done\n";
+
+	return 0;
+}
+
@@ -0,0 +1,413 @@
+#pragma once
+
+#include "./trace.hpp"
+
+#include <green_crdt/v3/list.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cassert>
+
+// synthetic traces with concurrent editors
+//
+// every actor edits its own replica, ops are broadcast to the other replicas with random delay
+// (fifo per sender), so actors edit without having seen each others latest ops.
+// the trace is the order the ops arrive at an extra observing replica.
+namespace trace::gen {
+
+struct Config {
+	uint32_t actors {4};
+	size_t ops {20'000}; // list ops, a paste of 10 chars is 10 ops
+	size_t initial {100}; // chars actor 0 types before anyone else starts, seen by everyone
+
+	// max delay of an op to reach another replica, in edits. 0 means everyone sees everything right away
+	size_t latency {8};
+
+	// probability of a jump to the shared hotspot, instead of a random spot.
+	// all actors typing at the same spot is the worst case for integration
+	double hotspot {0.5};
+
+	// probability of continuing at the own cursor, instead of jumping
+	double locality {0.9};
+
+	// probability an insert is a paste, and the max paste size
+	double paste {0.02};
+	size_t paste_max {200};
+
+	// probability an edit deletes (backspace), and the max number of chars deleted at once
+	double del {0.3};
+	size_t del_max {10};
+
+	uint64_t seed {1337};
+};
+
+// parses "key=value,key=value", unknown keys or bad values fail
+inline bool parseConfig(std::string_view str, Config& config) {
+	while (!str.empty()) {
+		const auto kv = str.substr(0, str.find(','));
+		str.remove_prefix(std::min(str.size(), kv.size() + 1));
+
+		const auto eq_pos = kv.find('=');
+		if (eq_pos == kv.npos) {
+			return false;
+		}
+
+		const std::string key {kv.substr(0, eq_pos)};
+		const std::string value {kv.substr(eq_pos + 1)};
+
+		try {
+			size_t parsed {0};
+			if (key == "actors") {
+				config.actors = std::stoul(value, &parsed);
+			} else if (key == "ops") {
+				config.ops = std::stoull(value, &parsed);
+			} else if (key == "initial") {
+				config.initial = std::stoull(value, &parsed);
+			} else if (key == "latency") {
+				config.latency = std::stoull(value, &parsed);
+			} else if (key == "hotspot") {
+				config.hotspot = std::stod(value, &parsed);
+			} else if (key == "locality") {
+				config.locality = std::stod(value, &parsed);
+			} else if (key == "paste") {
+				config.paste = std::stod(value, &parsed);
+			} else if (key == "paste_max") {
+				config.paste_max = std::stoull(value, &parsed);
+			} else if (key == "del") {
+				config.del = std::stod(value, &parsed);
+			} else if (key == "del_max") {
+				config.del_max = std::stoull(value, &parsed);
+			} else if (key == "seed") {
+				config.seed = std::stoull(value, &parsed);
+			} else {
+				return false;
+			}
+
+			if (parsed != value.size()) {
+				return false;
+			}
+		} catch (...) {
+			return false;
+		}
+	}
+
+	return config.actors != 0 && config.paste_max != 0 && config.del_max != 0;
+}
+
+namespace detail {
+	using List = GreenCRDT::V3::List<char, ActorID>;
+	using ListID = List::ListID;
+
+	struct Msg {
+		size_t arrival {0};
+		size_t op_idx {0}; // into the global op list
+	};
+
+	struct Replica {
+		List list;
+
+		uint64_t next_seq {0};
+
+		// inserts continue after it, deletes delete it
+		std::optional<ListID> cursor;
+
+		// sorted by arrival (fifo per sender, so only appends at the back of each sender)
+		std::vector<Msg> inbox;
+		std::vector<size_t> pending; // arrived, but not causally ready
+	};
+
+	// returns false if not ready yet (missing parents)
+	inline bool applyOp(List& list, const std::vector<ActorID>& actors, const Op& op, bool& dropped) {
+		dropped = false;
+		if (op.type == Op::DELETE) {
+			const ListID id {actors[op.actor], op.seq};
+			const auto idx_opt = list.findIdx(id);
+			if (!idx_opt.has_value()) {
+				return false;
+			}
+			if (!list._list_data[idx_opt.value()].value.has_value()) {
+				// someone else deleted it concurrently
+				dropped = true;
+				return true;
+			}
+			return list.del(id);
+		}
+
+		std::optional<ListID> parent_left;
+		if (op.has_parent_left) {
+			parent_left = ListID{actors[op.parent_left_actor], op.parent_left_seq};
+		}
+		std::optional<ListID> parent_right;
+		if (op.has_parent_right) {
+			parent_right = ListID{actors[op.parent_right_actor], op.parent_right_seq};
+		}
+		return list.add({actors[op.actor], op.seq}, op.value, parent_left, parent_right);
+	}
+
+	// applies everything ready, in causal order. calls fn(op_idx) for every applied op
+	template<typename FN>
+	void drainPending(List& list, const std::vector<ActorID>& actors, const std::vector<Op>& ops, std::vector<size_t>& pending, FN&& fn) {
+		for (bool progress = true; progress && !pending.empty();) {
+			progress = false;
+			for (auto it = pending.begin(); it != pending.end();) {
+				bool dropped {false};
+				if (applyOp(list, actors, ops[*it], dropped)) {
+					if (!dropped) {
+						fn(*it);
+					}
+					it = pending.erase(it);
+					progress = true;
+				} else {
+					it++;
+				}
+			}
+		}
+	}
+
+	// list idx of the pos-th visible entry, size() for the end
+	inline size_t idxOfPos(const List& list, size_t pos) {
+		size_t idx {0};
+		for (; idx < list.size(); idx++) {
+			if (list._list_data[idx].value.has_value()) {
+				if (pos == 0) {
+					break;
+				}
+				pos--;
+			}
+		}
+		return idx;
+	}
+
+	// visible entry at or before idx
+	inline std::optional<size_t> visibleAtOrBefore(const List& list, size_t idx) {
+		for (size_t i = std::min(idx + 1, list.size()); i > 0; i--) {
+			if (list._list_data[i - 1].value.has_value()) {
+				return i - 1;
+			}
+		}
+		return std::nullopt;
+	}
+} // detail
+
+inline Trace generate(const Config& config) {
+	using namespace detail;
+
+	std::mt19937_64 rng {config.seed};
+	std::uniform_real_distribution<double> dist_prob {0.0, 1.0};
+	const auto chance = [&](double p) { return dist_prob(rng) < p; };
+
+	Trace trace;
+
+	for (uint32_t i = 0; i < config.actors; i++) {
+		ActorID actor;
+		for (auto& byte : actor) {
+			byte = rng();
+		}
+		trace.actors.push_back(actor);
+	}
+
+	// every op ever made, trace gets them in the order they arrive at the observer
+	std::vector<Op> ops;
+	std::vector<size_t> ops_emit_time;
+
+	std::vector<Replica> replicas(config.actors);
+
+	// last arrival per (receiver, sender) for fifo links, the observer is the last receiver
+	std::vector<size_t> link_last_arrival((config.actors + 1) * config.actors, 0);
+
+	std::uniform_int_distribution<size_t> dist_latency {0, config.latency};
+	const auto arrival = [&](size_t receiver, size_t sender, size_t now) {
+		size_t& last = link_last_arrival[receiver * config.actors + sender];
+		last = std::max(last, now + dist_latency(rng));
+		return last;
+	};
+
+	std::vector<Msg> observer_inbox;
+
+	size_t now {0};
+
+	const auto emit = [&](size_t sender, const Op& op) {
+		const size_t op_idx = ops.size();
+		ops.push_back(op);
+		ops_emit_time.push_back(now);
+
+		for (size_t receiver = 0; receiver < replicas.size(); receiver++) {
+			if (receiver == sender) {
+				continue;
+			}
+			replicas[receiver].inbox.push_back({arrival(receiver, sender, now), op_idx});
+		}
+		observer_inbox.push_back({arrival(config.actors, sender, now), op_idx});
+	};
+
+	const auto deliver = [&](Replica& replica) {
+		// inbox is not globally sorted, only per sender
+		for (auto it = replica.inbox.begin(); it != replica.inbox.end();) {
+			if (it->arrival <= now) {
+				replica.pending.push_back(it->op_idx);
+				it = replica.inbox.erase(it);
+			} else {
+				it++;
+			}
+		}
+		std::sort(replica.pending.begin(), replica.pending.end());
+		drainPending(replica.list, trace.actors, ops, replica.pending, [](size_t) {});
+	};
+
+	const auto insert_after_cursor = [&](size_t actor, char value) {
+		Replica& replica = replicas[actor];
+
+		Op op;
+		op.type = Op::INSERT_ORIGINS;
+		op.value = value;
+		op.actor = actor;
+		op.seq = replica.next_seq++;
+
+		size_t right_idx {0};
+		if (replica.cursor.has_value()) {
+			const auto cursor_idx = replica.list.findIdx(replica.cursor.value());
+			assert(cursor_idx.has_value());
+			const auto left_id = replica.list.getIDInternal(cursor_idx.value());
+			op.has_parent_left = true;
+			op.parent_left_actor = std::find(trace.actors.cbegin(), trace.actors.cend(), replica.list._actors[left_id.actor_idx]) - trace.actors.cbegin();
+			op.parent_left_seq = left_id.seq;
+			right_idx = cursor_idx.value() + 1;
+		}
+
+		if (right_idx < replica.list.size()) {
+			const auto right_id = replica.list.getIDInternal(right_idx);
+			op.has_parent_right = true;
+			op.parent_right_actor = std::find(trace.actors.cbegin(), trace.actors.cend(), replica.list._actors[right_id.actor_idx]) - trace.actors.cbegin();
+			op.parent_right_seq = right_id.seq;
+		}
+
+		bool dropped {false};
+		const bool r = applyOp(replica.list, trace.actors, op, dropped);
+		assert(r);
+		(void)r;
+
+		replica.cursor = ListID{trace.actors[actor], op.seq};
+		emit(actor, op);
+	};
+
+	// deletes the entry at the cursor and moves the cursor left
+	const auto backspace = [&](size_t actor) -> bool {
+		Replica& replica = replicas[actor];
+		if (!replica.cursor.has_value()) {
+			return false;
+		}
+
+		const auto cursor_idx_opt = replica.list.findIdx(replica.cursor.value());
+		assert(cursor_idx_opt.has_value());
+		const auto del_idx = visibleAtOrBefore(replica.list, cursor_idx_opt.value());
+		if (!del_idx.has_value()) {
+			replica.cursor.reset();
+			return false;
+		}
+
+		const auto del_id = replica.list.getID(del_idx.value());
+
+		Op op;
+		op.type = Op::DELETE;
+		op.actor = std::find(trace.actors.cbegin(), trace.actors.cend(), del_id.id) - trace.actors.cbegin();
+		op.seq = del_id.seq;
+
+		const bool r = replica.list.del(del_id);
+		assert(r);
+		(void)r;
+
+		// cursor stays on the tombstone, next insert still lands at the same spot
+		replica.cursor = del_id;
+		emit(actor, op);
+		return true;
+	};
+
+	const auto random_char = [&]() -> char {
+		static constexpr std::string_view chars {"abcdefghijklmnopqrstuvwxyz     \n"};
+		return chars[rng() % chars.size()];
+	};
+
+	// initial text, everyone has it before editing starts
+	for (size_t i = 0; i < config.initial && ops.size() < config.ops; i++) {
+		insert_after_cursor(0, random_char());
+	}
+	for (auto& replica : replicas) {
+		for (auto& msg : replica.inbox) {
+			msg.arrival = 0;
+		}
+		deliver(replica);
+	}
+	for (auto& msg : observer_inbox) {
+		msg.arrival = 0;
+	}
+
+	// the hotspot is right after the first char
+	std::optional<ListID> hotspot;
+	if (!ops.empty()) {
+		hotspot = ListID{trace.actors[0], 0u};
+	}
+
+	while (ops.size() < config.ops) {
+		now++;
+
+		const size_t actor = rng() % config.actors;
+		Replica& replica = replicas[actor];
+
+		deliver(replica);
+
+		// move the cursor
+		if (!replica.cursor.has_value() || !chance(config.locality)) {
+			if (hotspot.has_value() && chance(config.hotspot)) {
+				replica.cursor = hotspot;
+			} else if (replica.list.getDocSize() == 0) {
+				replica.cursor.reset();
+			} else {
+				const size_t pos = rng() % replica.list.getDocSize();
+				replica.cursor = replica.list.getID(idxOfPos(replica.list, pos));
+			}
+		}
+
+		if (replica.list.getDocSize() != 0 && chance(config.del)) {
+			const size_t count = 1 + rng() % config.del_max;
+			for (size_t i = 0; i < count && ops.size() < config.ops; i++) {
+				if (!backspace(actor)) {
+					break;
+				}
+			}
+		} else {
+			const size_t count = chance(config.paste) ? 1 + rng() % config.paste_max : 1;
+			for (size_t i = 0; i < count && ops.size() < config.ops; i++) {
+				insert_after_cursor(actor, random_char());
+			}
+		}
+	}
+
+	// the observer applies in arrival order, as soon as causally possible
+	std::stable_sort(observer_inbox.begin(), observer_inbox.end(), [](const Msg& lhs, const Msg& rhs) { return lhs.arrival < rhs.arrival; });
+
+	List observer;
+	std::vector<size_t> pending;
+	const auto on_applied = [&](size_t op_idx) {
+		const auto& op = ops[op_idx];
+		trace.ops.push_back(op);
+		if (op.type == Op::DELETE) {
+			trace.deletes++;
+		} else {
+			trace.inserts++;
+		}
+	};
+	for (const auto& msg : observer_inbox) {
+		pending.push_back(msg.op_idx);
+		drainPending(observer, trace.actors, ops, pending, on_applied);
+	}
+	assert(pending.empty());
+
+	return trace;
+}
+
+} // trace::gen
+
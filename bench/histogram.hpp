@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// log-linear histogram (like HdrHistogram), fixed relative error instead of fixed bucket width.
+// values below 2^c_sub_bits are exact, above that each power of 2 is split into 2^(c_sub_bits-1) buckets,
+// so the error is below 1/2^(c_sub_bits-1) (~3% for 6 bits)
+struct Histogram {
+	static constexpr size_t c_sub_bits {6};
+	static constexpr uint64_t c_half {1ull << (c_sub_bits - 1)};
+	static constexpr size_t c_max_bits {42}; // ~73min in ns, larger values are clamped
+
+	std::vector<uint64_t> _counts = std::vector<uint64_t>(bucketIdx((1ull << c_max_bits) - 1) + 1, 0);
+
+	uint64_t _total {0};
+	uint64_t _max {0};
+	uint64_t _min {UINT64_MAX};
+	double _sum {0.0};
+
+	static size_t bucketIdx(uint64_t value) {
+		if (value < 2*c_half) {
+			return value;
+		}
+
+		const size_t msb = 63 - __builtin_clzll(value);
+		const size_t shift = msb - (c_sub_bits - 1);
+		return (shift + 1) * c_half + ((value >> shift) - c_half);
+	}
+
+	// highest value that still lands in the bucket
+	static uint64_t bucketValue(size_t idx) {
+		if (idx < 2*c_half) {
+			return idx;
+		}
+
+		const size_t shift = idx / c_half - 1;
+		const uint64_t sub = idx % c_half + c_half;
+		return ((sub + 1) << shift) - 1;
+	}
+
+	void record(uint64_t value) {
+		value = std::min<uint64_t>(value, (1ull << c_max_bits) - 1);
+
+		_counts[bucketIdx(value)]++;
+		_total++;
+		_max = std::max(_max, value);
+		_min = std::min(_min, value);
+		_sum += value;
+	}
+
+	Histogram& operator+=(const Histogram& other) {
+		for (size_t i = 0; i < _counts.size(); i++) {
+			_counts[i] += other._counts[i];
+		}
+		_total += other._total;
+		_max = std::max(_max, other._max);
+		_min = std::min(_min, other._min);
+		_sum += other._sum;
+		return *this;
+	}
+
+	[[nodiscard]] uint64_t count(void) const {
+		return _total;
+	}
+
+	[[nodiscard]] uint64_t max(void) const {
+		return _max;
+	}
+
+	[[nodiscard]] uint64_t min(void) const {
+		return _total == 0 ? 0 : _min;
+	}
+
+	[[nodiscard]] double mean(void) const {
+		return _total == 0 ? 0.0 : _sum / _total;
+	}
+
+	// p in [0, 1]
+	[[nodiscard]] uint64_t percentile(double p) const {
+		if (_total == 0) {
+			return 0;
+		}
+
+		const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * _total + 0.5));
+		uint64_t seen {0};
+		for (size_t i = 0; i < _counts.size(); i++) {
+			seen += _counts[i];
+			if (seen >= rank) {
+				// never report more than we actually saw
+				return std::min(bucketValue(i), _max);
+			}
+		}
+
+		return _max;
+	}
+};
+
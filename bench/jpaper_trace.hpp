@@ -0,0 +1,163 @@
+#pragma once
+
+#include "./trace.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <unordered_map>
+#include <string_view>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <cassert>
+
+// for dev, benching in debug is usefull, but only if the ammount of asserts is reasonable
+#if !defined(extra_assert)
+	#if defined(EXTRA_ASSERTS) && EXTRA_ASSERTS == 1
+		#define extra_assert(...) assert(__VA_ARGS__)
+	#else
+		#define extra_assert(...) void(0)
+	#endif
+#endif
+
+// reads the automerge-perf editing trace (res/paper.json, one change per line)
+namespace trace::jpaper {
+
+namespace detail {
+	inline uint8_t nib_from_hex(char c) {
+		extra_assert((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'));
+
+		if (c >= '0' && c <= '9') {
+			return static_cast<uint8_t>(c) - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			return (static_cast<uint8_t>(c) - 'a') + 10u;
+		} else {
+			return 0u;
+		}
+	}
+
+	inline ActorID ActorIDFromStr(std::string_view str) {
+		extra_assert(str.size() == 32*2);
+		ActorID tmp;
+
+		for (size_t i = 0; i < tmp.size(); i++) {
+			tmp[i] = nib_from_hex(str[i*2]) << 4 | nib_from_hex(str[i*2+1]);
+		}
+
+		return tmp;
+	}
+
+	// seq@ID type format used in the json
+	struct JObj {
+		ActorID id;
+		uint64_t seq {0};
+	};
+
+	inline JObj JObjFromStr(std::string_view str) {
+		extra_assert(str.size() > 32*2 + 1);
+
+		size_t at_pos = str.find_first_of('@');
+		auto seq_sv = str.substr(0, at_pos);
+		auto id_sv = str.substr(at_pos+1);
+
+		assert(seq_sv.size() != 0);
+		assert(id_sv.size() == 32*2);
+
+		uint64_t tmp_seq {0};
+		for (size_t i = 0; i < seq_sv.size(); i++) {
+			assert(seq_sv[i] >= '0' && seq_sv[i] <= '9');
+			tmp_seq *= 10;
+			tmp_seq += seq_sv[i] - '0';
+		}
+
+		return {ActorIDFromStr(id_sv), tmp_seq};
+	}
+} // detail
+
+// returns nullopt if the file could not be opened
+inline std::optional<Trace> load(const std::string& path) {
+	std::ifstream file {path};
+	if (!file.is_open()) {
+		return std::nullopt;
+	}
+
+	Trace trace;
+
+	std::unordered_map<ActorID, uint32_t> actor_idx;
+	const auto get_actor_idx = [&](const ActorID& actor) -> uint32_t {
+		const auto it = actor_idx.find(actor);
+		if (it != actor_idx.cend()) {
+			return it->second;
+		}
+
+		const uint32_t idx = trace.actors.size();
+		trace.actors.push_back(actor);
+		actor_idx[actor] = idx;
+		return idx;
+	};
+
+	std::unordered_map<ActorID, uint64_t> seq_inserts; // the opsec are not sequentially growing for inserts, so we sidestep
+	std::unordered_map<ActorID, std::unordered_map<uint64_t, uint64_t>> map_seq; // maps json op_seq -> list id seq
+
+	for (std::string line; std::getline(file, line); ) {
+		nlohmann::json j_entry = nlohmann::json::parse(line);
+		const ActorID actor = detail::ActorIDFromStr(static_cast<const std::string&>(j_entry["actor"]));
+		uint64_t op_seq = j_entry["startOp"];
+		for (const auto& j_op : j_entry["ops"]) {
+			if (j_op["action"] == "set") {
+				const auto obj = detail::JObjFromStr(static_cast<const std::string&>(j_op["obj"]));
+				if (obj.seq != 1) {
+					// skip all non text edits (create text doc, curser etc)
+					continue;
+				}
+
+				if (j_op["insert"]) {
+					const auto& j_parent = j_op["key"];
+					extra_assert(!j_parent.is_null());
+					extra_assert(static_cast<const std::string&>(j_op["value"]).size() == 1);
+
+					Op op;
+					op.type = Op::INSERT;
+					op.actor = get_actor_idx(actor);
+					op.seq = seq_inserts[actor]++;
+					op.value = static_cast<const std::string&>(j_op["value"]).front();
+
+					if (j_parent != "_head") {
+						const auto parent_left = detail::JObjFromStr(static_cast<const std::string&>(j_parent));
+						op.has_parent_left = true;
+						op.parent_left_actor = get_actor_idx(parent_left.id);
+						op.parent_left_seq = map_seq[parent_left.id][parent_left.seq];
+					}
+
+					map_seq[actor][op_seq] = op.seq;
+					trace.ops.push_back(op);
+					trace.inserts++;
+				} else {
+					// i think this is curser movement
+				}
+			} else if (j_op["action"] == "del") {
+				const auto list_id = detail::JObjFromStr(static_cast<const std::string&>(j_op["key"]));
+
+				Op op;
+				op.type = Op::DELETE;
+				op.actor = get_actor_idx(list_id.id);
+				op.seq = map_seq[list_id.id][list_id.seq];
+				trace.ops.push_back(op);
+				trace.deletes++;
+			} else if (j_op["action"] == "makeText") {
+				// doc.clear();
+			} else if (j_op["action"] == "makeMap") {
+				// no idea
+			} else {
+				std::cerr << "op: " << j_op << "\n";
+			}
+
+			op_seq++;
+		}
+	}
+
+	return trace;
+}
+
+} // trace::jpaper
+
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <green_crdt/v0/list.hpp>
+#include <green_crdt/v1/list.hpp>
+#include <green_crdt/v2/list.hpp>
+#include <green_crdt/v3/list.hpp>
+
+#include <optional>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+// uniform access to the different List versions, so the bench can be written once
+template<typename List>
+struct ListTraits;
+
+namespace detail {
+	// rough heap usage of node based containers, we only count the payload + link pointers
+	template<typename K, typename V>
+	size_t memoryUsage(const std::map<K, V>& map) {
+		return map.size() * (sizeof(typename std::map<K, V>::value_type) + 3*sizeof(void*) + sizeof(int));
+	}
+
+	template<typename K, typename V>
+	size_t memoryUsage(const std::unordered_map<K, V>& map) {
+		return map.size() * (sizeof(typename std::unordered_map<K, V>::value_type) + sizeof(void*)) + map.bucket_count() * sizeof(void*);
+	}
+
+	template<typename T>
+	size_t memoryUsage(const std::vector<T>& vec) {
+		return vec.capacity() * sizeof(T);
+	}
+} // detail
+
+template<typename ValueType, typename ActorType>
+struct ListTraits<GreenCRDT::V0::List<ValueType, ActorType>> {
+	using List = GreenCRDT::V0::List<ValueType, ActorType>;
+	using ListID = typename List::ListID;
+
+	static constexpr const char* name {"v0"};
+
+	// no hints
+	static std::optional<size_t> findIdx(const List& list, const ListID& id, const ActorType& actor) {
+		(void)actor;
+		return list.findIdx(id);
+	}
+
+	static ListID getID(const List& list, size_t idx) {
+		return list.list.at(idx).id;
+	}
+
+	static size_t size(const List& list) {
+		return list.list.size();
+	}
+
+	static bool hasValue(const List& list, size_t idx) {
+		return list.list[idx].value.has_value();
+	}
+
+	static size_t docSize(const List& list) {
+		return list.doc_size;
+	}
+
+	static std::vector<ValueType> getArray(const List& list) {
+		std::vector<ValueType> array;
+		for (const auto& it : list.list) {
+			if (it.value.has_value()) {
+				array.push_back(it.value.value());
+			}
+		}
+		return array;
+	}
+
+	static size_t memoryUsage(const List& list) {
+		return
+			detail::memoryUsage(list.list) +
+			detail::memoryUsage(list.last_seen_seq)
+		;
+	}
+};
+
+template<typename ValueType, typename ActorType>
+struct ListTraits<GreenCRDT::V1::List<ValueType, ActorType>> {
+	using List = GreenCRDT::V1::List<ValueType, ActorType>;
+	using ListID = typename List::ListID;
+
+	static constexpr const char* name {"v1"};
+
+	// no hints
+	static std::optional<size_t> findIdx(const List& list, const ListID& id, const ActorType& actor) {
+		(void)actor;
+		return list.findIdx(id);
+	}
+
+	static ListID getID(const List& list, size_t idx) {
+		const auto& id = list.list.at(idx).id;
+		return {list._actors[id.actor_idx], id.seq};
+	}
+
+	static size_t size(const List& list) {
+		return list.list.size();
+	}
+
+	static bool hasValue(const List& list, size_t idx) {
+		return list.list[idx].value.has_value();
+	}
+
+	static size_t docSize(const List& list) {
+		return list.doc_size;
+	}
+
+	static std::vector<ValueType> getArray(const List& list) {
+		return list.getArray();
+	}
+
+	static size_t memoryUsage(const List& list) {
+		return
+			detail::memoryUsage(list._actors) +
+			detail::memoryUsage(list.list) +
+			detail::memoryUsage(list.last_seen_seq)
+		;
+	}
+};
+
+template<typename ValueType, typename ActorType>
+struct ListTraits<GreenCRDT::V2::List<ValueType, ActorType>> {
+	using List = GreenCRDT::V2::List<ValueType, ActorType>;
+	using ListID = typename List::ListID;
+
+	static constexpr const char* name {"v2"};
+
+	// uses the last insert position of the inserting actor as hint
+	static std::optional<size_t> findIdx(const List& list, const ListID& id, const ActorType& actor) {
+		size_t hint {0};
+		const auto actor_idx_opt = list.findActor(actor);
+		if (actor_idx_opt.has_value() && list.last_inserted_idx.count(actor_idx_opt.value())) {
+			hint = list.last_inserted_idx.at(actor_idx_opt.value());
+		}
+		return list.findIdx(id, hint);
+	}
+
+	static ListID getID(const List& list, size_t idx) {
+		const auto& id = list.list.at(idx).id;
+		return {list._actors[id.actor_idx], id.seq};
+	}
+
+	static size_t size(const List& list) {
+		return list.list.size();
+	}
+
+	static bool hasValue(const List& list, size_t idx) {
+		return list.list[idx].value.has_value();
+	}
+
+	static size_t docSize(const List& list) {
+		return list.doc_size;
+	}
+
+	static std::vector<ValueType> getArray(const List& list) {
+		return list.getArray();
+	}
+
+	static size_t memoryUsage(const List& list) {
+		return
+			detail::memoryUsage(list._actors) +
+			detail::memoryUsage(list.list) +
+			detail::memoryUsage(list.last_seen_seq) +
+			detail::memoryUsage(list.last_inserted_idx)
+		;
+	}
+};
+
+template<typename ValueType, typename ActorType>
+struct ListTraits<GreenCRDT::V3::List<ValueType, ActorType>> {
+	using List = GreenCRDT::V3::List<ValueType, ActorType>;
+	using ListID = typename List::ListID;
+
+	static constexpr const char* name {"v3"};
+
+	// uses the last insert position of the inserting actor as hint
+	static std::optional<size_t> findIdx(const List& list, const ListID& id, const ActorType& actor) {
+		size_t hint {0};
+		const auto actor_idx_opt = list.findActor(actor);
+		if (actor_idx_opt.has_value() && actor_idx_opt.value() < list._last_inserted_idx.size()) {
+			hint = list._last_inserted_idx[actor_idx_opt.value()];
+		}
+		return list.findIdx(id, hint);
+	}
+
+	static ListID getID(const List& list, size_t idx) {
+		return list.getID(idx);
+	}
+
+	static size_t size(const List& list) {
+		return list.size();
+	}
+
+	static bool hasValue(const List& list, size_t idx) {
+		return list._list_data[idx].value.has_value();
+	}
+
+	static size_t docSize(const List& list) {
+		return list.getDocSize();
+	}
+
+	static std::vector<ValueType> getArray(const List& list) {
+		return list.getArray();
+	}
+
+	static size_t memoryUsage(const List& list) {
+		return
+			detail::memoryUsage(list._actors) +
+			detail::memoryUsage(list._actor_rank) +
+			detail::memoryUsage(list._list_ids) +
+			detail::memoryUsage(list._list_data) +
+			detail::memoryUsage(list._last_seen_seq) +
+			detail::memoryUsage(list._last_inserted_idx) +
+			detail::memoryUsage(list._hint_windows)
+		;
+	}
+};
+
@@ -0,0 +1,348 @@
+#define EXTRA_ASSERTS 0
+
+#include "./list_traits.hpp"
+#include "./trace.hpp"
+
+#include <green_crdt/v0/text_document.hpp>
+#include <green_crdt/v3/text_document.hpp>
+
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <type_traits>
+#include <cassert>
+
+// microbenchmarks for the single List primitives, at different list sizes
+
+using ActorID = trace::ActorID;
+
+static ActorID makeActor(uint32_t n) {
+	ActorID actor {};
+	// big endian, so the order of the actors is the order of n
+	actor[0] = n >> 24;
+	actor[1] = n >> 16;
+	actor[2] = n >> 8;
+	actor[3] = n;
+	return actor;
+}
+
+static const ActorID c_actor_base {makeActor(1)};
+static constexpr size_t c_actor_count {8}; // in the base list, base is the last one
+
+// target time per benchmark
+static constexpr std::chrono::milliseconds c_min_time {100};
+
+// runs fn(state) rounds, each on a fresh state from setup(), only fn is timed
+// fn returns the number of ops it did
+template<typename Setup, typename FN>
+static double measure(Setup&& setup, FN&& fn, size_t& ops_total) {
+	using clock = std::chrono::steady_clock;
+
+	clock::duration timed {0};
+	ops_total = 0;
+	for (size_t round = 0; round < 4 || timed < c_min_time; round++) {
+		auto state = setup();
+
+		const auto start = clock::now();
+		ops_total += fn(state);
+		timed += clock::now() - start;
+	}
+
+	return std::chrono::duration<double, std::nano>(timed).count() / ops_total;
+}
+
+// list with size entries, typed front to back by c_actor_count actors, every 8th deleted
+template<typename List>
+static List buildList(size_t size) {
+	using Traits = ListTraits<List>;
+	using ListID = typename List::ListID;
+
+	List list;
+
+	std::vector<uint64_t> seqs(c_actor_count, 0);
+	std::optional<ListID> last;
+	for (size_t i = 0; i < size; i++) {
+		// base actor is interned last
+		const uint32_t actor_n = i < c_actor_count ? 100 + i : 100 + i % c_actor_count;
+		const ListID id {actor_n == 100 + c_actor_count - 1 ? c_actor_base : makeActor(actor_n), seqs[actor_n - 100]++};
+		const bool r = list.add(id, 'a' + i % 26, last, std::nullopt);
+		assert(r);
+		(void)r;
+		last = id;
+	}
+
+	for (size_t i = 0; i < size; i += 8) {
+		const bool r = list.del(Traits::getID(list, i));
+		assert(r);
+		(void)r;
+	}
+
+	return list;
+}
+
+template<typename List, typename = void>
+struct HasFindActor : std::false_type {};
+template<typename List>
+struct HasFindActor<List, std::void_t<decltype(std::declval<const List&>().findActor(std::declval<ActorID>()))>> : std::true_type {};
+
+template<typename List, typename = void>
+struct HasHintedFindIdx : std::false_type {};
+template<typename List>
+struct HasHintedFindIdx<List, std::void_t<decltype(std::declval<const List&>().findIdx(std::declval<typename List::ListID>(), size_t{}))>> : std::true_type {};
+
+template<typename List>
+static void benchList(size_t size, nlohmann::json& j_results) {
+	using Traits = ListTraits<List>;
+	using ListID = typename List::ListID;
+
+	const List base = buildList<List>(size);
+	std::mt19937_64 rng {1337};
+
+	const auto report = [&](std::string_view primitive, double ns_per_op, size_t ops) {
+		std::cerr << Traits::name << " " << primitive << " size:" << size << " " << ns_per_op << "ns/op\n";
+		j_results.push_back({
+			{"version", Traits::name},
+			{"primitive", primitive},
+			{"size", size},
+			{"ns_per_op", ns_per_op},
+			{"ops", ops},
+		});
+	};
+
+	// read only benchmarks share the base list
+	const auto setup_none = [&]() { return 0; };
+	const auto setup_copy = [&]() { return base; };
+	size_t ops {0};
+	static constexpr size_t c_batch {64};
+
+	if constexpr (HasFindActor<List>::value) {
+		const double t = measure(setup_none, [&](int) {
+			size_t found {0};
+			for (size_t i = 0; i < c_batch; i++) {
+				found += base.findActor(c_actor_base).has_value();
+			}
+			assert(found == c_batch);
+			return c_batch;
+		}, ops);
+		report("find_actor", t, ops);
+	}
+
+	{
+		const double t = measure(setup_none, [&](int) {
+			size_t found {0};
+			for (size_t i = 0; i < c_batch; i++) {
+				found += base.findIdx(Traits::getID(base, rng() % size)).has_value();
+			}
+			assert(found == c_batch);
+			return c_batch;
+		}, ops);
+		report("find_idx_hit", t, ops);
+	}
+
+	{
+		const ListID unknown {c_actor_base, UINT64_MAX};
+		const double t = measure(setup_none, [&](int) {
+			size_t found {0};
+			for (size_t i = 0; i < c_batch; i++) {
+				found += base.findIdx(unknown).has_value();
+			}
+			assert(found == 0);
+			return c_batch;
+		}, ops);
+		report("find_idx_miss", t, ops);
+	}
+
+	if constexpr (HasHintedFindIdx<List>::value) {
+		const double t = measure(setup_none, [&](int) {
+			size_t found {0};
+			for (size_t i = 0; i < c_batch; i++) {
+				const size_t idx = rng() % size;
+				const size_t hint = idx >= 2 ? idx - 2 : idx + 2;
+				found += base.findIdx(Traits::getID(base, idx), hint).has_value();
+			}
+			assert(found == c_batch);
+			return c_batch;
+		}, ops);
+		report("find_idx_hinted", t, ops);
+	}
+
+	// inserts by a new actor, at a position relative to the current list
+	const auto bench_add = [&](std::string_view primitive, auto&& left_idx_fn) {
+		const ActorID actor = makeActor(1000);
+		const double t = measure(setup_copy, [&](List& list) {
+			for (size_t i = 0; i < c_batch; i++) {
+				const std::optional<size_t> left_idx = left_idx_fn(list);
+
+				std::optional<ListID> parent_left;
+				size_t right_idx {0};
+				if (left_idx.has_value()) {
+					parent_left = Traits::getID(list, left_idx.value());
+					right_idx = left_idx.value() + 1;
+				}
+
+				std::optional<ListID> parent_right;
+				if (right_idx < Traits::size(list)) {
+					parent_right = Traits::getID(list, right_idx);
+				}
+
+				const bool r = list.add({actor, i}, 'x', parent_left, parent_right);
+				assert(r);
+				(void)r;
+			}
+			return c_batch;
+		}, ops);
+		report(primitive, t, ops);
+	};
+
+	bench_add("add_head", [](const List&) -> std::optional<size_t> { return std::nullopt; });
+	bench_add("add_middle", [](const List& list) -> std::optional<size_t> { return Traits::size(list) / 2; });
+	bench_add("add_tail", [](const List& list) -> std::optional<size_t> { return Traits::size(list) - 1; });
+
+	{ // c_batch actors insert concurrently at the same spot, each insert has to scan past all previous
+		const std::optional<ListID> parent_left = Traits::getID(base, size / 2);
+		const std::optional<ListID> parent_right = Traits::getID(base, size / 2 + 1);
+		const double t = measure(setup_copy, [&](List& list) {
+			for (size_t i = 0; i < c_batch; i++) {
+				const bool r = list.add({makeActor(2000 + i), 0u}, 'x', parent_left, parent_right);
+				assert(r);
+				(void)r;
+			}
+			return c_batch;
+		}, ops);
+		report("add_concurrent", t, ops);
+	}
+
+	{ // deletes of random not yet deleted entries
+		std::vector<ListID> ids;
+		for (size_t i = 0; i < size && ids.size() < c_batch; i++) {
+			const size_t idx = rng() % size;
+			if (Traits::hasValue(base, idx)) {
+				ids.push_back(Traits::getID(base, idx));
+			}
+		}
+		std::sort(ids.begin(), ids.end());
+		ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+		const double t = measure(setup_copy, [&](List& list) {
+			for (const auto& id : ids) {
+				const bool r = list.del(id);
+				assert(r);
+				(void)r;
+			}
+			return ids.size();
+		}, ops);
+		report("del", t, ops);
+	}
+
+	{
+		const double t = measure(setup_none, [&](int) {
+			size_t chars {0};
+			for (size_t i = 0; i < 4; i++) {
+				chars += Traits::getArray(base).size();
+			}
+			assert(chars != 0);
+			return 4;
+		}, ops);
+		report("get_text", t, ops);
+	}
+}
+
+// TextDocument::merge, a single char typed in the middle of the text
+template<typename Doc>
+static void benchDoc(std::string_view name, size_t size, nlohmann::json& j_results) {
+	Doc base;
+	if constexpr (std::is_same_v<Doc, GreenCRDT::V0::TextDocument<ActorID>>) {
+		base.local_agent = c_actor_base;
+	} else {
+		base.local_actor = c_actor_base;
+	}
+
+	{
+		std::string text;
+		for (size_t i = 0; i < size; i++) {
+			text += (i % 40 == 39) ? '\n' : char('a' + i % 26);
+		}
+		base.merge(text);
+	}
+
+	static constexpr size_t c_batch {16};
+
+	size_t ops {0};
+	const double t = measure([&]() { return base; }, [&](Doc& doc) {
+		for (size_t i = 0; i < c_batch; i++) {
+			std::string text = doc.getText();
+			text.insert(text.begin() + text.size() / 2, 'x');
+			const auto merge_ops = doc.merge(text);
+			assert(merge_ops.size() == 1);
+			(void)merge_ops;
+		}
+		return c_batch;
+	}, ops);
+
+	std::cerr << name << " text_document_merge size:" << size << " " << t << "ns/op\n";
+	j_results.push_back({
+		{"version", name},
+		{"primitive", "text_document_merge"},
+		{"size", size},
+		{"ns_per_op", t},
+		{"ops", ops},
+	});
+}
+
+int main(int argc, char** argv) {
+	std::vector<size_t> sizes {100, 1'000, 10'000};
+	std::vector<std::string_view> versions;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg {argv[i]};
+		if (arg == "--sizes" && i + 1 < argc) {
+			sizes.clear();
+			std::string_view list {argv[++i]};
+			while (!list.empty()) {
+				const auto item = list.substr(0, list.find(','));
+				list.remove_prefix(std::min(list.size(), item.size() + 1));
+				sizes.push_back(std::stoull(std::string{item}));
+			}
+		} else if (arg == "v0" || arg == "v1" || arg == "v2" || arg == "v3") {
+			versions.push_back(arg);
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--sizes 100,1000,...] [v0] [v1] [v2] [v3]\n";
+			std::cerr << "  results are printed as json to stdout\n";
+			return 1;
+		}
+	}
+	if (versions.empty()) {
+		versions = {"v0", "v1", "v2", "v3"};
+	}
+
+	nlohmann::json j_results = nlohmann::json::array();
+	for (const auto version : versions) {
+		for (const size_t size : sizes) {
+			if (size < 2) {
+				continue;
+			}
+
+			if (version == "v0") {
+				benchList<GreenCRDT::V0::List<char, ActorID>>(size, j_results);
+				benchDoc<GreenCRDT::V0::TextDocument<ActorID>>(version, size, j_results);
+			} else if (version == "v1") {
+				benchList<GreenCRDT::V1::List<char, ActorID>>(size, j_results);
+			} else if (version == "v2") {
+				benchList<GreenCRDT::V2::List<char, ActorID>>(size, j_results);
+			} else if (version == "v3") {
+				benchList<GreenCRDT::V3::List<char, ActorID>>(size, j_results);
+				benchDoc<GreenCRDT::V3::TextDocument<ActorID>>(version, size, j_results);
+			}
+		}
+	}
+
+	std::cout << j_results.dump(1, '\t') << "\n";
+
+	return 0;
+}
+
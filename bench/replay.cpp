@@ -0,0 +1,483 @@
+#define EXTRA_ASSERTS 0
+// GREEN_CRDT_STATS is set by cmake (CRDT_BENCH_STATS)
+
+#include "./list_traits.hpp"
+#include "./trace.hpp"
+#include "./jpaper_trace.hpp"
+#include "./binary_trace.hpp"
+#include "./gen_trace.hpp"
+#include "./histogram.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <cassert>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using ActorID = trace::ActorID;
+
+// peak resident set size of this process, in KiB
+static size_t peakRSS(void) {
+	struct rusage usage {};
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+// FNV-1a, to compare the final text across versions without printing it
+static uint64_t hashText(const std::vector<char>& text) {
+	uint64_t hash {0xcbf29ce484222325};
+	for (const char c : text) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+// list index of the pos-th not deleted entry, or size() if pos is the end
+template<typename List>
+static size_t idxOfPos(const List& list, size_t pos) {
+	using Traits = ListTraits<List>;
+
+	size_t idx {0};
+	for (; idx < Traits::size(list); idx++) {
+		if (Traits::hasValue(list, idx)) {
+			if (pos == 0) {
+				break;
+			}
+			pos--;
+		}
+	}
+
+	assert(pos == 0);
+	return idx;
+}
+
+template<typename List>
+static void applyOp(List& list, const trace::View& trace, const trace::Op& op) {
+	using Traits = ListTraits<List>;
+	using ListID = typename List::ListID;
+
+	const ActorID& actor = trace.actors[op.actor];
+
+	switch (op.type) {
+		case trace::Op::INSERT_ORIGINS: {
+			std::optional<ListID> parent_left;
+			if (op.has_parent_left) {
+				parent_left = ListID{trace.actors[op.parent_left_actor], op.parent_left_seq};
+			}
+
+			std::optional<ListID> parent_right;
+			if (op.has_parent_right) {
+				parent_right = ListID{trace.actors[op.parent_right_actor], op.parent_right_seq};
+			}
+
+			const bool r = list.add({actor, op.seq}, op.value, parent_left, parent_right);
+			assert(r);
+			(void)r;
+			break;
+		}
+		case trace::Op::INSERT:
+		case trace::Op::INSERT_AT: {
+			std::optional<ListID> parent_left;
+			size_t right_idx {0};
+			if (op.type == trace::Op::INSERT) {
+				// the trace only has the left parent, the right one is whatever is next to it now
+				if (op.has_parent_left) {
+					const ListID parent_left_id {trace.actors[op.parent_left_actor], op.parent_left_seq};
+					const auto idx_opt = Traits::findIdx(list, parent_left_id, actor);
+					assert(idx_opt.has_value());
+					parent_left = parent_left_id;
+					right_idx = idx_opt.value() + 1;
+				}
+			} else if (op.pos != 0) {
+				const size_t left_idx = idxOfPos(list, op.pos - 1);
+				parent_left = Traits::getID(list, left_idx);
+				right_idx = left_idx + 1;
+			}
+
+			std::optional<ListID> parent_right;
+			if (right_idx < Traits::size(list)) {
+				parent_right = Traits::getID(list, right_idx);
+			}
+
+			const bool r = list.add({actor, op.seq}, op.value, parent_left, parent_right);
+			assert(r);
+			(void)r;
+			break;
+		}
+		case trace::Op::DELETE: {
+			const bool r = list.del({actor, op.seq});
+			assert(r);
+			(void)r;
+			break;
+		}
+		case trace::Op::DELETE_AT: {
+			const bool r = list.del(Traits::getID(list, idxOfPos(list, op.pos)));
+			assert(r);
+			(void)r;
+			break;
+		}
+	}
+}
+
+// latency of a single op, by op type and list size (with tombstones) when it was applied
+struct OpLatency {
+	Histogram all;
+	std::vector<Histogram> by_size; // [log10(size)]
+
+	void record(size_t list_size, uint64_t ns) {
+		all.record(ns);
+
+		size_t bucket {0};
+		for (; list_size >= 10; list_size /= 10) {
+			bucket++;
+		}
+		if (by_size.size() <= bucket) {
+			by_size.resize(bucket + 1);
+		}
+		by_size[bucket].record(ns);
+	}
+};
+
+static nlohmann::json toJson(const Histogram& histogram) {
+	return {
+		{"count", histogram.count()},
+		{"mean_ns", histogram.mean()},
+		{"p50_ns", histogram.percentile(0.5)},
+		{"p99_ns", histogram.percentile(0.99)},
+		{"p999_ns", histogram.percentile(0.999)},
+		{"max_ns", histogram.max()},
+	};
+}
+
+static nlohmann::json toJson(const OpLatency& latency) {
+	nlohmann::json j_latency;
+	j_latency["all"] = toJson(latency.all);
+
+	// "1e3" means a list size in [1000, 10000)
+	for (size_t i = 0; i < latency.by_size.size(); i++) {
+		if (latency.by_size[i].count() != 0) {
+			j_latency["size_1e" + std::to_string(i)] = toJson(latency.by_size[i]);
+		}
+	}
+
+	return j_latency;
+}
+
+// list internal counters, only V3 has them and only with GREEN_CRDT_STATS
+template<typename List>
+static void addStats(nlohmann::json&, const List&) {
+}
+
+#if defined(GREEN_CRDT_STATS) && GREEN_CRDT_STATS == 1
+template<typename ValueType, typename ActorType>
+static void addStats(nlohmann::json& j_res, const GreenCRDT::V3::List<ValueType, ActorType>& list) {
+	const auto& stats = list.getStats();
+	j_res["stats"] = {
+		{"find_actor", stats.find_actor},
+		{"find_actor_scanned", stats.find_actor_scanned},
+		{"find_with_hint", stats.find_with_hint},
+		{"find_with_hint_hit", stats.find_with_hint_hit},
+		{"find_full", stats.find_full},
+		{"find_full_scanned", stats.find_full_scanned},
+		{"integrate", stats.integrate},
+		{"integrate_conflict_iterations", stats.integrate_conflict_iterations},
+		{"integrate_moved_bytes", stats.integrate_moved_bytes},
+	};
+}
+#endif
+
+// the op of a later repetition of the trace, with its own actors and appended after what is already there
+static trace::Op repeatOp(const trace::Op& op, uint32_t actor_offset, std::optional<uint32_t> anchor_actor, uint64_t anchor_seq, uint64_t pos_offset) {
+	trace::Op rep_op = op;
+	rep_op.actor += actor_offset;
+	rep_op.parent_left_actor += actor_offset;
+	rep_op.parent_right_actor += actor_offset;
+	rep_op.pos += pos_offset;
+
+	const bool is_id_insert = op.type == trace::Op::INSERT || op.type == trace::Op::INSERT_ORIGINS;
+	if (is_id_insert && !op.has_parent_left && anchor_actor.has_value()) {
+		rep_op.has_parent_left = true;
+		rep_op.parent_left_actor = anchor_actor.value();
+		rep_op.parent_left_seq = anchor_seq;
+	}
+
+	return rep_op;
+}
+
+template<typename List>
+static nlohmann::json replay(const trace::View& trace, bool record_latency, size_t min_entries) {
+	using Traits = ListTraits<List>;
+	using clock = std::chrono::steady_clock;
+
+	const size_t rss_before = peakRSS();
+
+	List list;
+
+	OpLatency latency_insert;
+	OpLatency latency_delete;
+	OpLatency latency_lookup;
+
+	// the trace is replayed until the list has min_entries.
+	// every repetition gets its own copy of the actors and is appended at the end
+	std::vector<ActorID> actors(trace.actors, trace.actors + trace.actor_count);
+	size_t repetitions {0};
+	size_t ops_total {0};
+
+	clock::duration time_replay {0};
+
+	do {
+		const uint32_t actor_offset = repetitions * trace.actor_count;
+		std::optional<uint32_t> anchor_actor;
+		uint64_t anchor_seq {0};
+		const uint64_t pos_offset = Traits::docSize(list);
+
+		if (repetitions != 0) {
+			for (size_t i = 0; i < trace.actor_count; i++) {
+				ActorID actor = trace.actors[i];
+				for (size_t b = 0; b < 4; b++) {
+					actor[actor.size() - 1 - b] ^= repetitions >> (b*8);
+				}
+				actors.push_back(actor);
+			}
+
+			if (Traits::size(list) != 0) {
+				const auto last_id = Traits::getID(list, Traits::size(list) - 1);
+				anchor_actor = std::find(actors.cbegin(), actors.cend(), last_id.id) - actors.cbegin();
+				anchor_seq = last_id.seq;
+			}
+		}
+
+		trace::View rep_trace = trace;
+		rep_trace.actors = actors.data();
+		rep_trace.actor_count = actors.size();
+
+		const auto time_start = clock::now();
+
+		for (size_t i = 0; i < trace.op_count; i++) {
+			const auto& op = repetitions == 0 ? trace.ops[i] : repeatOp(trace.ops[i], actor_offset, anchor_actor, anchor_seq, pos_offset);
+
+			if (!record_latency) {
+				applyOp(list, rep_trace, op);
+				continue;
+			}
+
+			const size_t list_size = Traits::size(list);
+			const auto op_start = clock::now();
+			applyOp(list, rep_trace, op);
+			const uint64_t op_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - op_start).count();
+
+			if (op.type == trace::Op::DELETE || op.type == trace::Op::DELETE_AT) {
+				latency_delete.record(list_size, op_ns);
+			} else {
+				latency_insert.record(list_size, op_ns);
+			}
+		}
+
+		time_replay += clock::now() - time_start;
+		ops_total += trace.op_count;
+		repetitions++;
+
+		// when sweeping, also how lookups (by id, no hint) grow with the size. not part of the wall time
+		if (min_entries != 0 && Traits::size(list) != 0) {
+			std::mt19937_64 rng {repetitions};
+			for (size_t i = 0; i < 64; i++) {
+				const auto id = Traits::getID(list, rng() % Traits::size(list));
+				const auto op_start = clock::now();
+				const auto idx_opt = list.findIdx(id);
+				const uint64_t op_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - op_start).count();
+				assert(idx_opt.has_value());
+				(void)idx_opt;
+				latency_lookup.record(Traits::size(list), op_ns);
+			}
+		}
+	} while (Traits::size(list) < min_entries && trace.op_count != 0);
+
+	const std::chrono::duration<double> wall_time = time_replay;
+
+	const size_t entries = Traits::size(list);
+	const size_t memory = Traits::memoryUsage(list);
+
+	nlohmann::json j_res;
+	j_res["version"] = Traits::name;
+	j_res["repetitions"] = repetitions;
+	j_res["ops"] = ops_total;
+	j_res["inserts"] = trace.inserts * repetitions;
+	j_res["deletes"] = trace.deletes * repetitions;
+	j_res["wall_time_s"] = wall_time.count();
+	j_res["ops_per_s"] = ops_total / wall_time.count();
+	j_res["peak_rss_kib"] = peakRSS();
+	j_res["peak_rss_growth_kib"] = peakRSS() - rss_before;
+	j_res["entries"] = entries;
+	j_res["tombstones"] = entries - Traits::docSize(list);
+	j_res["doc_size"] = Traits::docSize(list);
+	j_res["list_bytes"] = memory;
+	j_res["bytes_per_entry"] = entries == 0 ? 0.0 : double(memory) / entries;
+	j_res["text_hash"] = hashText(Traits::getArray(list));
+
+	addStats(j_res, list);
+
+	if (record_latency) {
+		j_res["latency"]["insert"] = toJson(latency_insert);
+		j_res["latency"]["delete"] = toJson(latency_delete);
+	}
+	if (latency_lookup.all.count() != 0) {
+		j_res["latency"]["lookup"] = toJson(latency_lookup);
+	}
+
+	return j_res;
+}
+
+// runs fn in a child process, so each version gets its own peak rss
+// the child sends back the json result over a pipe
+template<typename FN>
+static nlohmann::json runIsolated(FN&& fn) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		return {{"error", "pipe() failed"}};
+	}
+
+	const pid_t pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return {{"error", "fork() failed"}};
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		const std::string res = fn().dump();
+		for (size_t written = 0; written < res.size();) {
+			const auto r = write(fds[1], res.data() + written, res.size() - written);
+			if (r <= 0) {
+				break;
+			}
+			written += r;
+		}
+		close(fds[1]);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	std::string res;
+	char buffer[4096];
+	for (ssize_t r; (r = read(fds[0], buffer, sizeof(buffer))) > 0;) {
+		res.append(buffer, r);
+	}
+	close(fds[0]);
+
+	int status {0};
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		return {{"error", "child failed"}, {"status", status}};
+	}
+
+	auto j_res = nlohmann::json::parse(res, nullptr, false);
+	if (!j_res.is_object()) {
+		return {{"error", "invalid result"}};
+	}
+	return j_res;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " [--no-latency] [--min-entries <n>] <trace> [v0] [v1] [v2] [v3]\n";
+		std::cerr << "  trace is a json or binary trace file, or gen:key=value,... to generate one (see gen_trace.hpp)\n";
+		std::cerr << "  --no-latency skips timing every single op, for slightly more accurate throughput\n";
+		std::cerr << "  --min-entries <n> replays the trace again and again (appended, new actors) until the list has n entries\n";
+		std::cerr << "  results are printed as json to stdout\n";
+		return 1;
+	}
+
+	bool record_latency {true};
+	size_t min_entries {0};
+	std::string trace_path;
+	std::vector<std::string_view> versions;
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg {argv[i]};
+		if (arg == "--no-latency") {
+			record_latency = false;
+		} else if (arg == "--min-entries" && i + 1 < argc) {
+			min_entries = std::stoull(argv[++i]);
+		} else if (trace_path.empty()) {
+			trace_path = arg;
+		} else {
+			versions.push_back(arg);
+		}
+	}
+	if (trace_path.empty()) {
+		std::cerr << "no trace given\n";
+		return 1;
+	}
+	if (versions.empty()) {
+		versions = {"v0", "v1", "v2", "v3"};
+	}
+
+	// binary traces are mapped, everything else is parsed as json into memory
+	trace::binary::MappedTrace mapped_trace;
+	std::optional<trace::Trace> parsed_trace;
+	trace::View trace;
+	if (trace_path.rfind("gen:", 0) == 0) {
+		trace::gen::Config config;
+		if (!trace::gen::parseConfig(std::string_view{trace_path}.substr(4), config)) {
+			std::cerr << "invalid generator config '" << trace_path << "'\n";
+			return 1;
+		}
+		std::cerr << "generating trace '" << trace_path << "'...\n";
+		parsed_trace = trace::gen::generate(config);
+		trace = parsed_trace.value().view();
+	} else if (trace::binary::isBinaryTrace(trace_path)) {
+		std::cerr << "mapping binary trace '" << trace_path << "'...\n";
+		if (!mapped_trace.open(trace_path)) {
+			std::cerr << "failed to map trace '" << trace_path << "'\n";
+			return 1;
+		}
+		trace = mapped_trace.view;
+	} else {
+		std::cerr << "reading json trace '" << trace_path << "'...\n";
+		parsed_trace = trace::jpaper::load(trace_path);
+		if (!parsed_trace.has_value()) {
+			std::cerr << "failed to read trace '" << trace_path << "'\n";
+			return 1;
+		}
+		trace = parsed_trace.value().view();
+	}
+	std::cerr << "trace has " << trace.op_count << " ops by " << trace.actor_count << " actors\n";
+
+	nlohmann::json j_results = nlohmann::json::array();
+	for (const auto version : versions) {
+		std::cerr << "replaying with " << version << "...\n";
+
+		nlohmann::json j_res;
+		if (version == "v0") {
+			j_res = runIsolated([&]() { return replay<GreenCRDT::V0::List<char, ActorID>>(trace, record_latency, min_entries); });
+		} else if (version == "v1") {
+			j_res = runIsolated([&]() { return replay<GreenCRDT::V1::List<char, ActorID>>(trace, record_latency, min_entries); });
+		} else if (version == "v2") {
+			j_res = runIsolated([&]() { return replay<GreenCRDT::V2::List<char, ActorID>>(trace, record_latency, min_entries); });
+		} else if (version == "v3") {
+			j_res = runIsolated([&]() { return replay<GreenCRDT::V3::List<char, ActorID>>(trace, record_latency, min_entries); });
+		} else {
+			std::cerr << "unknown version '" << version << "'\n";
+			return 1;
+		}
+
+		j_res["trace"] = trace_path;
+		std::cerr << j_res.dump() << "\n";
+		j_results.push_back(j_res);
+	}
+
+	std::cout << j_results.dump(1, '\t') << "\n";
+
+	return 0;
+}
+
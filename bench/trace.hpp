@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace trace {
+
+using ActorID = std::array<uint8_t, 32>;
+
+// fixed layout, this is also the layout in the binary trace file (see binary_trace.hpp)
+// actors are indices into the actor table, seqs are list seqs (starting at 0, per actor)
+struct Op {
+	enum Type : uint8_t {
+		INSERT, // by id, after parent_left, right parent is whatever is next to it when replayed
+		DELETE, // by id
+		INSERT_AT, // at pos in the visible text
+		DELETE_AT, // at pos in the visible text
+		INSERT_ORIGINS, // by id, with both parents as the author saw them (concurrent edits)
+	};
+
+	Type type {INSERT};
+
+	char value {0};
+
+	// INSERT*, inserted right after, or at the start if not set
+	bool has_parent_left {false};
+
+	// INSERT_ORIGINS only, inserted right before, or at the end if not set
+	bool has_parent_right {false};
+
+	// INSERT*: the new entry
+	// DELETE: the entry to delete
+	// DELETE_AT: only actor, who deleted
+	uint32_t actor {0};
+	uint64_t seq {0};
+
+	uint32_t parent_left_actor {0};
+	uint32_t parent_right_actor {0};
+	uint64_t parent_left_seq {0};
+	uint64_t parent_right_seq {0};
+
+	// *_AT only
+	uint64_t pos {0};
+};
+static_assert(sizeof(Op) == 48);
+static_assert(alignof(Op) == 8);
+
+// non owning view on a trace, so it does not matter where it lives (vector/mmap)
+struct View {
+	const ActorID* actors {nullptr};
+	size_t actor_count {0};
+
+	const Op* ops {nullptr};
+	size_t op_count {0};
+
+	size_t inserts {0};
+	size_t deletes {0};
+};
+
+struct Trace {
+	std::vector<ActorID> actors;
+	std::vector<Op> ops;
+
+	size_t inserts {0};
+	size_t deletes {0};
+
+	View view(void) const {
+		return {
+			actors.data(), actors.size(),
+			ops.data(), ops.size(),
+			inserts, deletes,
+		};
+	}
+};
+
+} // trace
+
+template<>
+struct std::hash<trace::ActorID> {
+	std::size_t operator()(trace::ActorID const& s) const noexcept {
+		static_assert(sizeof(size_t) == 8);
+		// TODO: maybe shuffle the indices a bit
+		return
+			(static_cast<size_t>(s[0]) << 8*0) |
+			(static_cast<size_t>(s[1]) << 8*1) |
+			(static_cast<size_t>(s[2]) << 8*2) |
+			(static_cast<size_t>(s[3]) << 8*3) |
+			(static_cast<size_t>(s[4]) << 8*4) |
+			(static_cast<size_t>(s[5]) << 8*5) |
+			(static_cast<size_t>(s[6]) << 8*6) |
+			(static_cast<size_t>(s[7]) << 8*7)
+		;
+	}
+};
+
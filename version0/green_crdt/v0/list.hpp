@@ -153,6 +153,10 @@ struct List {
 				if (insert_idx == list.size()) {
 					break;
 				}
+				// scanned to the end, insert_idx stays where the scan started
+				if (i == list.size()) {
+					break;
+				}
 
 				const Entry& at_i = list[i];
 				// parents left and right
@@ -110,6 +110,22 @@ void testConcurrent2(void) {
 	randomAddPermutations(ops, "adbc");
 }
 
+// the scan for the insert position ran past the end of the list, when the last entries
+// are children of an entry that is still being scanned over
+void testScanPastEnd(void) {
+	DocType doc;
+
+	doc.state.add({'A', 0}, 'a', std::nullopt, std::nullopt);
+	doc.state.add({'A', 1}, 'c', ListType::ListID{'A', 0u}, std::nullopt);
+	doc.state.add({'B', 0}, 'b', std::nullopt, ListType::ListID{'A', 1u});
+	assert(doc.getText() == "abc");
+
+	// same parents as 'a' and after it by agent. 'b' has an earlier right parent, so it
+	// goes after 'd' and the scan looks past it, over 'c' (not a sibling) to the end
+	doc.state.add({'C', 0}, 'd', std::nullopt, std::nullopt);
+	assert(doc.getText() == "adbc");
+}
+
 void testMain1(void) {
 	DocType doc;
 
@@ -186,6 +202,10 @@ int main(void) {
 	testConcurrent2();
 	std::cout << std::string(40, '-') << "\n";
 
+	std::cout << "testScanPastEnd:\n";
+	testScanPastEnd();
+	std::cout << std::string(40, '-') << "\n";
+
 	std::cout << "testMain1:\n";
 	testMain1();
 	std::cout << std::string(40, '-') << "\n";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <algorithm>
 #include <optional>
 #include <unordered_map>
 #include <vector>
@@ -16,6 +17,15 @@
 	#endif
 #endif
 
+// hot path counters, for tuning. off by default and then not even part of List
+#if !defined(green_crdt_stat)
+	#if defined(GREEN_CRDT_STATS) && GREEN_CRDT_STATS == 1
+		#define green_crdt_stat(...) __VA_ARGS__
+	#else
+		#define green_crdt_stat(...) void(0)
+	#endif
+#endif
+
 namespace GreenCRDT::V3 {
 
 template<typename ValueType, typename ActorType>
@@ -56,6 +66,10 @@ struct List {
 	// internally the index into this array is used to refer to an actor
 	std::vector<ActorType> _actors;
 
+	// position of each actor (by actor_idx) if _actors was sorted,
+	// so the concurrent insert tie breaker is an integer compare
+	std::vector<size_t> _actor_rank;
+
 	struct Entry_Data {
 		// Yjs
 		std::optional<ListIDInternal> parent_left;
@@ -68,76 +82,165 @@ struct List {
 	std::vector<ListIDInternal> _list_ids;
 	std::vector<Entry_Data> _list_data;
 
+	// for public interface, an entry with everything resolved
+	struct OrderedEntry {
+		ListID id;
+
+		std::optional<ListID> parent_left;
+		std::optional<ListID> parent_right;
+
+		std::optional<ValueType> value; // nullopt if deleted
+	};
+
 	// number of not deleted entries
 	size_t _doc_size {0};
 
 	// TODO: actor index instead of map
 	std::unordered_map<size_t, uint64_t> _last_seen_seq;
 
-	// caching only, contains the last index an actor inserted at
-	std::unordered_map<size_t, size_t> _last_inserted_idx;
+	// caching only, contains the last index an actor inserted at (by actor_idx)
+	// kept up to date when anyone inserts before it, so it stays a good hint with concurrent editors
+	std::vector<size_t> _last_inserted_idx;
+
+	// how far around the hint we look first, before expanding outward
+	// old fixed values, tuned by hand on the paper trace: 1-4 hits: 359928 (3m51s)
+	static constexpr size_t c_hint_pre = 1;
+	static constexpr size_t c_hint_post = 4;
+	static constexpr size_t c_hint_window_max = 64;
+
+	struct HintWindow {
+		size_t pre {c_hint_pre};
+		size_t post {c_hint_post};
+	};
+
+	// caching only, per actor, adapted to how far from the hint their parents are found
+	std::vector<HintWindow> _hint_windows;
+
+	struct Stats {
+		size_t find_actor {0};
+		size_t find_actor_scanned {0}; // actors compared
+
+		size_t find_with_hint {0};
+		size_t find_with_hint_hit {0}; // in the initial window
+		size_t find_with_hint_scanned {0}; // entries compared
+
+		size_t find_full {0}; // findIdx(id) without a hint, the hinted one expands outward instead of falling back
+		size_t find_full_scanned {0}; // entries compared
+
+		size_t integrate {0};
+		size_t integrate_conflict_iterations {0}; // entries looked at, between the parents
+		size_t integrate_moved_bytes {0}; // by inserting into the middle of the arrays
+	};
 
-	//size_t _stat_find_with_hint{0};
-	//size_t _stat_find_with_hint_hit{0};
+#if defined(GREEN_CRDT_STATS) && GREEN_CRDT_STATS == 1
+	// mutable, so the const finds can count too
+	mutable Stats _stats;
+
+	[[nodiscard]] const Stats& getStats(void) const {
+		return _stats;
+	}
+
+	void resetStats(void) {
+		_stats = {};
+	}
+#endif
 
 	[[nodiscard]] std::optional<size_t> findActor(const ActorType& actor) const {
+		green_crdt_stat(_stats.find_actor++);
 		for (size_t i = 0; i < _actors.size(); i++) {
 			if (_actors[i] == actor) {
+				green_crdt_stat(_stats.find_actor_scanned += i + 1);
 				return i;
 			}
 		}
+		green_crdt_stat(_stats.find_actor_scanned += _actors.size());
 		return std::nullopt;
 	}
 
 	[[nodiscard]] std::optional<size_t> findIdx(const ListIDInternal& list_id) const {
 		extra_assert(verify());
 
+		green_crdt_stat(_stats.find_full++);
 		for (size_t i = 0; i < _list_ids.size(); i++) {
 			if (_list_ids[i] == list_id) {
+				green_crdt_stat(_stats.find_full_scanned += i + 1);
 				return i;
 			}
 		}
 
+		green_crdt_stat(_stats.find_full_scanned += _list_ids.size());
 		return std::nullopt;
 	}
 
 	// search close to hint first
 	[[nodiscard]] std::optional<size_t> findIdx(const ListIDInternal& list_id, size_t hint) const {
-		extra_assert(verify());
+		return _findIdxAround(list_id, hint, c_hint_pre, c_hint_post);
+	}
 
-		//_stat_find_with_hint++;
+	// looks at [hint-pre, hint+post] first, then expands outward in both directions in doubling blocks.
+	// something at distance d from the hint is found after O(d) compares, and nothing is looked at twice
+	[[nodiscard]] std::optional<size_t> _findIdxAround(const ListIDInternal& list_id, size_t hint, size_t pre, size_t post) const {
+		extra_assert(verify());
 
-		// TODO: find some good magic values here
-		// total: 364150
-		// 2-9 hits: 360164 (3m54)
-		// 1-9 hits: 360161 (3m53)
-		// 1-2 hits: 359800 (3m55s)
-		// 0-2 hits: 359763 (3m54s)
-		// changed from loop to single if:
-		// 1-2 hits: 359800 (3m50s)
-		// 1-4 hits: 359928 (3m51s) (after cond reorder: 3m49s)
-		static constexpr size_t c_hint_pre = 1;
-		static constexpr size_t c_hint_post = 4;
+		green_crdt_stat(_stats.find_with_hint++);
 
-		{ // go back 2, so we dont miss // TODO: is this really needed
-			//for (size_t i = 0; hint > 0 && i < c_hint_pre; hint--, i++) {}
-			if (hint >= c_hint_pre) {
-				hint -= c_hint_pre;
-			}
+		const size_t size = _list_ids.size();
+		if (size == 0) {
+			return std::nullopt;
 		}
+		hint = std::min(hint, size - 1);
 
-		const size_t max_at_hint = hint + c_hint_post; // how many positions we check at hint, before falling back to full lookup
+		// [lo, hi) has been looked at
+		size_t lo = hint >= pre ? hint - pre : 0;
+		size_t hi = std::min(hint + post + 1, size);
 
-		for (size_t i = hint; i <= max_at_hint && i < _list_ids.size(); i++) {
+		for (size_t i = lo; i < hi; i++) {
 			if (_list_ids[i] == list_id) {
-				//_stat_find_with_hint_hit++;
+				green_crdt_stat(_stats.find_with_hint_hit++);
+				green_crdt_stat(_stats.find_with_hint_scanned += i - lo + 1);
 				return i;
 			}
 		}
 
-		// fall back to normal search
-		// TODO: in some cases we scan the list twice now!!
-		return findIdx(list_id);
+		size_t block = std::max<size_t>(hi - lo, 8);
+		while (lo > 0 || hi < size) {
+			// right first, typing moves forward
+			const size_t new_hi = std::min(hi + block, size);
+			for (size_t i = hi; i < new_hi; i++) {
+				if (_list_ids[i] == list_id) {
+					green_crdt_stat(_stats.find_with_hint_scanned += (hi - lo) + (i - hi + 1));
+					return i;
+				}
+			}
+			hi = new_hi;
+
+			const size_t new_lo = lo > block ? lo - block : 0;
+			for (size_t i = lo; i > new_lo; i--) {
+				if (_list_ids[i-1] == list_id) {
+					green_crdt_stat(_stats.find_with_hint_scanned += (hi - lo) + (lo - i + 1));
+					return i-1;
+				}
+			}
+			lo = new_lo;
+
+			block *= 2;
+		}
+
+		green_crdt_stat(_stats.find_with_hint_scanned += size);
+		return std::nullopt;
+	}
+
+	// grow the window to where we actually found it (capped), shrink it slowly if we hit well inside
+	static void _adaptHintWindow(HintWindow& window, size_t hint, size_t idx) {
+		size_t& side = idx >= hint ? window.post : window.pre;
+		const size_t side_min = idx >= hint ? c_hint_post : c_hint_pre;
+		const size_t distance = idx >= hint ? idx - hint : hint - idx;
+
+		if (distance > side) {
+			side = std::min(distance, c_hint_window_max);
+		} else if (distance < side/2 && side > side_min) {
+			side--;
+		}
 	}
 
 	[[nodiscard]] std::optional<size_t> findIdx(const ListID& list_id) const {
@@ -173,18 +276,8 @@ struct List {
 	bool add(const ListID& list_id, const ValueType& value, const std::optional<ListID>& parent_left, const std::optional<ListID>& parent_right) {
 		extra_assert(verify());
 
-		size_t actor_idx {0};
-		{ // new actor?
-			// add, even if op fails
-			const auto actor_opt = findActor(list_id.id);
-			if (!actor_opt.has_value()) {
-				actor_idx = _actors.size();
-				_last_inserted_idx[_actors.size()] = 0; // hack
-				_actors.push_back(list_id.id);
-			} else {
-				actor_idx = actor_opt.value();
-			}
-		}
+		// add, even if op fails
+		const size_t actor_idx = _internActor(list_id.id);
 
 		// check actor op order
 		if (!_last_seen_seq.count(actor_idx)) {
@@ -199,6 +292,101 @@ struct List {
 			}
 		}
 
+		// parents by actors we dont know cant be in the list
+		std::optional<ListIDInternal> parent_left_internal;
+		if (parent_left.has_value()) {
+			const auto parent_actor_opt = findActor(parent_left.value().id);
+			if (!parent_actor_opt.has_value()) {
+				return false;
+			}
+			parent_left_internal = ListIDInternal{parent_actor_opt.value(), parent_left.value().seq};
+		}
+
+		std::optional<ListIDInternal> parent_right_internal;
+		if (parent_right.has_value()) {
+			const auto parent_actor_opt = findActor(parent_right.value().id);
+			if (!parent_actor_opt.has_value()) {
+				return false;
+			}
+			parent_right_internal = ListIDInternal{parent_actor_opt.value(), parent_right.value().seq};
+		}
+
+		if (!_integrate(ListIDInternal{actor_idx, list_id.seq}, value, parent_left_internal, parent_right_internal)) {
+			return false;
+		}
+
+		_last_seen_seq[actor_idx] = list_id.seq;
+
+		extra_assert(verify());
+		return true;
+	}
+
+	// returns the actors index, adds unknown actors
+	size_t _internActor(const ActorType& actor) {
+		const auto actor_opt = findActor(actor);
+		if (actor_opt.has_value()) {
+			return actor_opt.value();
+		}
+
+		_actors.push_back(actor);
+		_addActorRank(_actors.size() - 1);
+		_last_inserted_idx.push_back(0);
+		_hint_windows.emplace_back();
+		return _actors.size() - 1;
+	}
+
+	// O(actors)
+	void _addActorRank(size_t actor_idx) {
+		size_t rank {0};
+		for (size_t i = 0; i < _actor_rank.size(); i++) {
+			if (_actors[i] < _actors[actor_idx]) {
+				rank++;
+			}
+		}
+
+		for (auto& it : _actor_rank) {
+			if (it >= rank) {
+				it++;
+			}
+		}
+
+		_actor_rank.push_back(rank);
+	}
+
+	// after _actors was replaced
+	void _rebuildActorRanks(void) {
+		std::vector<size_t> sorted(_actors.size());
+		for (size_t i = 0; i < sorted.size(); i++) {
+			sorted[i] = i;
+		}
+		std::sort(sorted.begin(), sorted.end(), [this](size_t lhs, size_t rhs) { return _actors[lhs] < _actors[rhs]; });
+
+		_actor_rank.resize(_actors.size());
+		for (size_t rank = 0; rank < sorted.size(); rank++) {
+			_actor_rank[sorted[rank]] = rank;
+		}
+	}
+
+	// after positions changed all over the place
+	void _resetHints(void) {
+		_last_inserted_idx.assign(_actors.size(), 0);
+		_hint_windows.assign(_actors.size(), HintWindow{});
+	}
+
+	// the Yjs part of add(), without the op order checks
+	// returns false if a parent is missing
+	bool _integrate(const ListIDInternal& id, const std::optional<ValueType>& value, const std::optional<ListIDInternal>& parent_left, const std::optional<ListIDInternal>& parent_right) {
+		green_crdt_stat(_stats.integrate++);
+
+		// actors can also be added to _actors directly
+		while (_actor_rank.size() < _actors.size()) {
+			_addActorRank(_actor_rank.size());
+		}
+		if (_last_inserted_idx.size() < _actors.size()) {
+			_last_inserted_idx.resize(_actors.size(), 0);
+			_hint_windows.resize(_actors.size());
+		}
+
 		size_t insert_idx = 0;
 		if (_list_ids.empty()) {
 			if (parent_left.has_value() || parent_right.has_value()) {
@@ -209,11 +397,15 @@ struct List {
 			// find left
 			std::optional<size_t> left_idx_opt = std::nullopt;
 			if (parent_left.has_value()) {
-				left_idx_opt = findIdx(parent_left.value(), _last_inserted_idx[actor_idx]);
+				// the actors next op is usually close to their last, how close is learned per actor
+				const size_t hint = _last_inserted_idx[id.actor_idx];
+				HintWindow& window = _hint_windows[id.actor_idx];
+				left_idx_opt = _findIdxAround(parent_left.value(), hint, window.pre, window.post);
 				if (!left_idx_opt.has_value()) {
 					// missing parent left
 					return false;
 				}
+				_adaptHintWindow(window, hint, left_idx_opt.value());
 
 				// we insert before the it, so we need to go past the left parent
 				insert_idx = left_idx_opt.value() + 1;
@@ -245,6 +437,8 @@ struct List {
 					break;
 				}
 
+				green_crdt_stat(_stats.integrate_conflict_iterations++);
+
 				const Entry_Data& at_i = _list_data[i];
 				// parents left and right
 				std::optional<size_t> i_left_idx {std::nullopt};
@@ -282,7 +476,7 @@ struct List {
 						scanning = true;
 					} else if (i_right_idx == right_idx) {
 						// actor id tie breaker
-						if (_actors[actor_idx] < _actors[_list_ids[i].actor_idx]) {
+						if (_actor_rank[id.actor_idx] < _actor_rank[_list_ids[i].actor_idx]) {
 							break;
 						} else {
 							scanning = false;
@@ -297,27 +491,23 @@ struct List {
 		}
 
 		{ // actual insert
-			_list_ids.emplace(_list_ids.begin() + insert_idx, ListIDInternal{actor_idx, list_id.seq});
-
-			Entry_Data new_entry;
-			if (parent_left.has_value()) {
-				new_entry.parent_left = ListIDInternal{findActor(parent_left.value().id).value(), parent_left.value().seq};
-			}
-
-			if (parent_right.has_value()) {
-				new_entry.parent_right = ListIDInternal{findActor(parent_right.value().id).value(), parent_right.value().seq};
+			green_crdt_stat(_stats.integrate_moved_bytes += (_list_ids.size() - insert_idx) * (sizeof(ListIDInternal) + sizeof(Entry_Data)));
+			_list_ids.emplace(_list_ids.begin() + insert_idx, id);
+			_list_data.emplace(_list_data.begin() + insert_idx, Entry_Data{parent_left, parent_right, value});
+
+			// everything at or after insert_idx moved one to the right
+			for (auto& idx : _last_inserted_idx) {
+				if (idx >= insert_idx) {
+					idx++;
+				}
 			}
-
-			new_entry.value = value;
-
-			_list_data.emplace(_list_data.begin() + insert_idx, new_entry);
-			_last_inserted_idx[actor_idx] = insert_idx;
+			_last_inserted_idx[id.actor_idx] = insert_idx;
 		}
 
-		_doc_size++;
-		_last_seen_seq[actor_idx] = list_id.seq;
+		if (value.has_value()) {
+			_doc_size++;
+		}
 
-		extra_assert(verify());
 		return true;
 	}
 
@@ -369,6 +559,601 @@ struct List {
 		return false;
 	}
 
+	// builds the list from entries that are already in document order (another replica, a snapshot)
+	// skips integration, one pass over the entries plus one over the actors
+	// returns false if the entries can not be a list state (unknown actors, gaps in an actors seqs), leaves the list empty then
+	bool bulkLoad(std::vector<ActorType>&& actors, std::vector<ListIDInternal>&& list_ids, std::vector<Entry_Data>&& list_data) {
+		*this = {};
+
+		if (list_ids.size() != list_data.size()) {
+			return false;
+		}
+
+		// per actor, number of entries and highest seq
+		std::vector<uint64_t> seq_count(actors.size(), 0u);
+		std::vector<uint64_t> seq_max(actors.size(), 0u);
+
+		const auto valid_parent = [&actors](const std::optional<ListIDInternal>& parent) {
+			return !parent.has_value() || parent.value().actor_idx < actors.size();
+		};
+
+		size_t doc_size {0};
+		for (size_t i = 0; i < list_ids.size(); i++) {
+			const auto& id = list_ids[i];
+			if (id.actor_idx >= actors.size()) {
+				return false;
+			}
+
+			seq_count[id.actor_idx]++;
+			seq_max[id.actor_idx] = std::max(seq_max[id.actor_idx], id.seq);
+
+			const auto& data = list_data[i];
+			if (!valid_parent(data.parent_left) || !valid_parent(data.parent_right)) {
+				return false;
+			}
+
+			if (data.value.has_value()) {
+				doc_size++;
+			}
+		}
+
+		for (size_t actor_idx = 0; actor_idx < actors.size(); actor_idx++) {
+			if (seq_count[actor_idx] == 0) {
+				continue; // known actor, but no ops (yet)
+			}
+
+			// seqs start at 0 and dont skip (does not catch a duplicate covering a gap)
+			if (seq_max[actor_idx] + 1 != seq_count[actor_idx]) {
+				return false;
+			}
+
+			_last_seen_seq[actor_idx] = seq_max[actor_idx];
+		}
+
+		_actors = std::move(actors);
+		_list_ids = std::move(list_ids);
+		_list_data = std::move(list_data);
+		_doc_size = doc_size;
+
+		_rebuildActorRanks();
+		_resetHints();
+
+		extra_assert(verify());
+		return true;
+	}
+
+	bool bulkLoad(const std::vector<OrderedEntry>& entries) {
+		std::vector<ActorType> actors;
+		std::vector<ListIDInternal> list_ids;
+		std::vector<Entry_Data> list_data;
+		list_ids.reserve(entries.size());
+		list_data.reserve(entries.size());
+
+		// consecutive entries are mostly by the same actor (typing), so remember the last one
+		std::optional<size_t> last_actor_idx;
+		const auto actor_idx_for = [&](const ActorType& actor) -> size_t {
+			if (last_actor_idx.has_value() && actors[last_actor_idx.value()] == actor) {
+				return last_actor_idx.value();
+			}
+
+			for (size_t i = 0; i < actors.size(); i++) {
+				if (actors[i] == actor) {
+					last_actor_idx = i;
+					return i;
+				}
+			}
+
+			last_actor_idx = actors.size();
+			actors.push_back(actor);
+			return last_actor_idx.value();
+		};
+
+		for (const auto& entry : entries) {
+			list_ids.push_back(ListIDInternal{actor_idx_for(entry.id.id), entry.id.seq});
+		}
+
+		// parents can point right, to actors we only saw after them
+		const auto to_internal = [&](const std::optional<ListID>& parent) -> std::optional<ListIDInternal> {
+			if (!parent.has_value()) {
+				return std::nullopt;
+			}
+
+			if (last_actor_idx.has_value() && actors[last_actor_idx.value()] == parent.value().id) {
+				return ListIDInternal{last_actor_idx.value(), parent.value().seq};
+			}
+
+			for (size_t i = 0; i < actors.size(); i++) {
+				if (actors[i] == parent.value().id) {
+					last_actor_idx = i;
+					return ListIDInternal{i, parent.value().seq};
+				}
+			}
+
+			// parent by an actor without entries, can not be
+			return ListIDInternal{actors.size(), parent.value().seq};
+		};
+
+		for (const auto& entry : entries) {
+			list_data.push_back(Entry_Data{
+				to_internal(entry.parent_left),
+				to_internal(entry.parent_right),
+				entry.value
+			});
+		}
+
+		return bulkLoad(std::move(actors), std::move(list_ids), std::move(list_data));
+	}
+
+	// the counterpart to bulkLoad()
+	[[nodiscard]] std::vector<OrderedEntry> getOrderedEntries(void) const {
+		const auto to_public = [this](const std::optional<ListIDInternal>& id) -> std::optional<ListID> {
+			if (!id.has_value()) {
+				return std::nullopt;
+			}
+			return ListID{_actors[id.value().actor_idx], id.value().seq};
+		};
+
+		std::vector<OrderedEntry> entries;
+		entries.reserve(_list_ids.size());
+		for (size_t i = 0; i < _list_ids.size(); i++) {
+			entries.push_back(OrderedEntry{
+				getID(i),
+				to_public(_list_data[i].parent_left),
+				to_public(_list_data[i].parent_right),
+				_list_data[i].value
+			});
+		}
+
+		return entries;
+	}
+
+	// merges the full state of another replica into this one
+	// both lists are the same total order restricted to what each has seen, so between two entries both
+	// have (anchors) a spot only one side edited is copied over as is. where both edited, the entries of
+	// other are integrated into ours of that spot only, everything outside the spot is placed by a key
+	// (its position) instead of being searched for. typed runs go in as one block.
+	// one walk over both to find the spots, one to build the new list. O(n + m) plus, per spot both
+	// edited, its size times the runs other typed there.
+	// returns false (and leaves this untouched) if the replicas disagree on the order,
+	// or other is not causally complete
+	bool merge(const List& other) {
+		extra_assert(verify());
+		extra_assert(other.verify());
+
+		struct IDHash {
+			size_t operator()(const ListIDInternal& id) const noexcept {
+				return std::hash<uint64_t>{}((id.seq << 8) ^ id.actor_idx);
+			}
+		};
+
+		// other actor_idx -> our actor_idx, new actors are only committed on success
+		std::vector<ActorType> actors = _actors;
+		std::vector<size_t> actor_remap(other._actors.size());
+		for (size_t i = 0; i < other._actors.size(); i++) {
+			size_t actor_idx = actors.size();
+			for (size_t j = 0; j < actors.size(); j++) {
+				if (actors[j] == other._actors[i]) {
+					actor_idx = j;
+					break;
+				}
+			}
+			if (actor_idx == actors.size()) {
+				actors.push_back(other._actors[i]);
+			}
+			actor_remap[i] = actor_idx;
+		}
+
+		// the tie breaker, for the actors after the merge
+		std::vector<size_t> actor_rank(actors.size());
+		{
+			std::vector<size_t> sorted(actors.size());
+			for (size_t i = 0; i < sorted.size(); i++) {
+				sorted[i] = i;
+			}
+			std::sort(sorted.begin(), sorted.end(), [&actors](size_t lhs, size_t rhs) { return actors[lhs] < actors[rhs]; });
+			for (size_t rank = 0; rank < sorted.size(); rank++) {
+				actor_rank[sorted[rank]] = rank;
+			}
+		}
+
+		const auto remap = [&actor_remap](const ListIDInternal& id) {
+			return ListIDInternal{actor_remap[id.actor_idx], id.seq};
+		};
+		const auto remap_opt = [&remap](const std::optional<ListIDInternal>& id) -> std::optional<ListIDInternal> {
+			if (!id.has_value()) {
+				return std::nullopt;
+			}
+			return remap(id.value());
+		};
+
+		// our ids -> idx
+		std::unordered_map<ListIDInternal, size_t, IDHash> our_idx;
+		our_idx.reserve(_list_ids.size());
+		for (size_t i = 0; i < _list_ids.size(); i++) {
+			our_idx.emplace(_list_ids[i], i);
+		}
+
+		// for every entry of other, the idx it has here, if any. the others by id
+		std::vector<std::optional<size_t>> other_in_ours(other._list_ids.size());
+		std::vector<bool> ours_in_other(_list_ids.size(), false);
+		std::unordered_map<ListIDInternal, size_t, IDHash> other_only_idx;
+		for (size_t j = 0; j < other._list_ids.size(); j++) {
+			const auto id = remap(other._list_ids[j]);
+			const auto it = our_idx.find(id);
+			if (it != our_idx.cend()) {
+				other_in_ours[j] = it->second;
+				ours_in_other[it->second] = true;
+			} else {
+				other_only_idx.emplace(id, j);
+			}
+		}
+
+		// where something is in the merged order, without knowing its index there.
+		// ours at i is {i+1, 0}, entries at a spot after our i-1 are {i, 1+n} (n-th in the spot).
+		// {0, 0} is before everything (no left parent), SIZE_MAX after (no right parent)
+		using Key = std::pair<size_t, size_t>;
+
+		// spots where both edited, [i_start, i_end) ours, [j_start, j_end) other's
+		struct Spot {
+			size_t i_start;
+			size_t i_end;
+			size_t j_start;
+			size_t j_end;
+		};
+		std::vector<Spot> spots;
+		std::vector<size_t> spot_of(other._list_ids.size(), SIZE_MAX); // entries of other at one of them
+		std::vector<Key> other_key(other._list_ids.size()); // entries of other at spots only other edited
+
+		// walk both, between two common entries either side can have entries the other does not know about
+		{
+			size_t i {0};
+			size_t j {0};
+			while (i < _list_ids.size() || j < other._list_ids.size()) {
+				const size_t i_start = i;
+				while (i < _list_ids.size() && !ours_in_other[i]) {
+					i++;
+				}
+
+				const size_t j_start = j;
+				while (j < other._list_ids.size() && !other_in_ours[j].has_value()) {
+					j++;
+				}
+
+				if (i != i_start && j != j_start) {
+					for (size_t k = j_start; k < j; k++) {
+						spot_of[k] = spots.size();
+					}
+					spots.push_back(Spot{i_start, i, j_start, j});
+				} else {
+					for (size_t k = j_start; k < j; k++) {
+						other_key[k] = Key{i_start, 1 + k - j_start};
+					}
+				}
+
+				if (i == _list_ids.size() || j == other._list_ids.size()) {
+					if (i != _list_ids.size() || j != other._list_ids.size()) {
+						return false; // a common entry only one side has left o.O
+					}
+					break;
+				}
+
+				// common anchor
+				if (other_in_ours[j].value() != i) {
+					return false; // different order
+				}
+				i++;
+				j++;
+			}
+		}
+
+		// keys of the entries at spots that are merged already
+		std::unordered_map<ListIDInternal, Key, IDHash> spot_keys;
+
+		const auto find_key = [&](const ListIDInternal& id) -> std::optional<Key> {
+			if (const auto it = spot_keys.find(id); it != spot_keys.cend()) {
+				return it->second;
+			}
+			if (const auto it = our_idx.find(id); it != our_idx.cend()) {
+				return Key{it->second + 1, 0};
+			}
+			if (const auto it = other_only_idx.find(id); it != other_only_idx.cend() && spot_of[it->second] == SIZE_MAX) {
+				return other_key[it->second];
+			}
+			return std::nullopt; // at a spot not merged yet, or nowhere
+		};
+
+		// the merged entries of every spot
+		std::vector<std::vector<ListIDInternal>> spot_ids(spots.size());
+		std::vector<std::vector<Entry_Data>> spot_data(spots.size());
+
+		// integrates the entries of other at the spot into ours there, like _integrate() with keys.
+		// false if a parent is at a spot not merged yet
+		const auto merge_spot = [&](size_t spot_i) -> bool {
+			const Spot& spot = spots[spot_i];
+			const size_t y_count = spot.j_end - spot.j_start;
+
+			// parents in the spot are dependencies, the others need to have a place already
+			std::unordered_map<ListIDInternal, size_t, IDHash> y_idx;
+			y_idx.reserve(y_count);
+			for (size_t k = 0; k < y_count; k++) {
+				y_idx.emplace(remap(other._list_ids[spot.j_start + k]), k);
+			}
+
+			std::vector<uint8_t> missing(y_count, 0u);
+			std::vector<size_t> dependents_start(y_count + 1, 0u); // into dependents, by parent
+			std::vector<std::pair<size_t, size_t>> edges; // parent, child
+			for (size_t k = 0; k < y_count; k++) {
+				const auto& data = other._list_data[spot.j_start + k];
+				for (const auto& parent : {data.parent_left, data.parent_right}) {
+					if (!parent.has_value()) {
+						continue;
+					}
+					const auto parent_id = remap(parent.value());
+					if (const auto it = y_idx.find(parent_id); it != y_idx.cend()) {
+						missing[k]++;
+						edges.emplace_back(it->second, k);
+					} else if (!find_key(parent_id).has_value()) {
+						return false;
+					}
+				}
+			}
+			std::vector<size_t> dependents(edges.size());
+			for (const auto& [parent, child] : edges) {
+				dependents_start[parent + 1]++;
+			}
+			for (size_t k = 0; k < y_count; k++) {
+				dependents_start[k + 1] += dependents_start[k];
+			}
+			{
+				std::vector<size_t> fill(dependents_start.cbegin(), dependents_start.cend() - 1);
+				for (const auto& [parent, child] : edges) {
+					dependents[fill[parent]++] = child;
+				}
+			}
+
+			// starts with ours
+			auto& w_ids = spot_ids[spot_i];
+			auto& w_data = spot_data[spot_i];
+			w_ids.assign(_list_ids.cbegin() + spot.i_start, _list_ids.cbegin() + spot.i_end);
+			w_data.assign(_list_data.cbegin() + spot.i_start, _list_data.cbegin() + spot.i_end);
+			w_ids.reserve(w_ids.size() + y_count);
+			w_data.reserve(w_data.size() + y_count);
+
+			std::unordered_map<ListIDInternal, size_t, IDHash> w_idx;
+			w_idx.reserve(w_ids.size() + y_count);
+			for (size_t l = 0; l < w_ids.size(); l++) {
+				w_idx.emplace(w_ids[l], l);
+			}
+
+			const auto key = [&](const ListIDInternal& id) -> Key {
+				if (const auto it = w_idx.find(id); it != w_idx.cend()) {
+					return Key{spot.i_start, 1 + it->second};
+				}
+				const auto key_opt = find_key(id);
+				assert(key_opt.has_value() && "parent outside the spot without a key");
+				return key_opt.value();
+			};
+			const auto key_left = [&key](const std::optional<ListIDInternal>& id) {
+				return id.has_value() ? key(id.value()) : Key{0, 0};
+			};
+			const auto key_right = [&key](const std::optional<ListIDInternal>& id) {
+				return id.has_value() ? key(id.value()) : Key{SIZE_MAX, 0};
+			};
+
+			// in the order of other, parents first
+			std::vector<size_t> queue;
+			queue.reserve(y_count);
+			for (size_t k = 0; k < y_count; k++) {
+				if (missing[k] == 0) {
+					queue.push_back(k);
+				}
+			}
+
+			std::vector<bool> done(y_count, false);
+			size_t done_count {0};
+			std::vector<ListIDInternal> block_ids;
+			std::vector<Entry_Data> block_data;
+			for (size_t queue_i = 0; queue_i < queue.size(); queue_i++) {
+				const size_t k = queue[queue_i];
+				if (done[k]) {
+					continue; // went in with a run
+				}
+
+				const auto id = remap(other._list_ids[spot.j_start + k]);
+				const auto& data = other._list_data[spot.j_start + k];
+				const auto parent_left = remap_opt(data.parent_left);
+				const auto parent_right = remap_opt(data.parent_right);
+
+				// the scan of _integrate(), over the spot. outside of it the order is known,
+				// so it does not leave the spot (see merge order above)
+				const Key left_key = key_left(parent_left);
+				const Key right_key = key_right(parent_right);
+
+				size_t insert_idx {0};
+				if (parent_left.has_value()) {
+					if (const auto it = w_idx.find(parent_left.value()); it != w_idx.cend()) {
+						insert_idx = it->second + 1;
+					}
+				}
+				size_t right_idx = w_ids.size();
+				if (parent_right.has_value()) {
+					if (const auto it = w_idx.find(parent_right.value()); it != w_idx.cend()) {
+						right_idx = it->second;
+					}
+				}
+
+				bool scanning {false};
+				for (size_t i = insert_idx;; i++) {
+					if (!scanning) {
+						insert_idx = i;
+					}
+					if (insert_idx == right_idx || insert_idx == w_ids.size() || i == w_ids.size()) {
+						break;
+					}
+
+					const Entry_Data& at_i = w_data[i];
+					const Key i_left_key = key_left(at_i.parent_left);
+					if (i_left_key < left_key) {
+						break;
+					} else if (i_left_key == left_key) {
+						const Key i_right_key = key_right(at_i.parent_right);
+						if (i_right_key < right_key) {
+							scanning = true;
+						} else if (i_right_key == right_key) {
+							// actor id tie breaker
+							if (actor_rank[id.actor_idx] < actor_rank[w_ids[i].actor_idx]) {
+								break;
+							} else {
+								scanning = false;
+							}
+						} else {
+							scanning = false;
+						}
+					}
+				}
+
+				// what other typed after it goes right after it. nothing here can have it as left parent yet,
+				// so the next entry has its left parent further left and the scan would stop right away
+				block_ids.clear();
+				block_data.clear();
+				block_ids.push_back(id);
+				block_data.push_back(Entry_Data{parent_left, parent_right, data.value});
+				done[k] = true;
+				size_t block_end = k + 1;
+				for (; block_end < y_count && !done[block_end]; block_end++) {
+					const auto& next_data = other._list_data[spot.j_start + block_end];
+					if (!next_data.parent_left.has_value() || !(remap(next_data.parent_left.value()) == block_ids.back())) {
+						break;
+					}
+					const auto next_parent_right = remap_opt(next_data.parent_right);
+					if (next_parent_right.has_value() && y_idx.count(next_parent_right.value()) && !w_idx.count(next_parent_right.value())) {
+						break; // not in yet
+					}
+
+					block_ids.push_back(remap(other._list_ids[spot.j_start + block_end]));
+					block_data.push_back(Entry_Data{block_ids[block_ids.size() - 2], next_parent_right, next_data.value});
+					done[block_end] = true;
+				}
+
+				w_ids.insert(w_ids.begin() + insert_idx, block_ids.cbegin(), block_ids.cend());
+				w_data.insert(w_data.begin() + insert_idx, block_data.cbegin(), block_data.cend());
+				for (size_t l = insert_idx; l < w_ids.size(); l++) {
+					w_idx[w_ids[l]] = l;
+				}
+				done_count += block_ids.size();
+
+				for (size_t member = k; member < block_end; member++) {
+					for (size_t d = dependents_start[member]; d < dependents_start[member + 1]; d++) {
+						if (--missing[dependents[d]] == 0) {
+							queue.push_back(dependents[d]);
+						}
+					}
+				}
+			}
+
+			if (done_count != y_count) {
+				return false; // parents that are nowhere
+			}
+
+			for (size_t l = 0; l < w_ids.size(); l++) {
+				spot_keys.emplace(w_ids[l], Key{spot.i_start, 1 + l});
+			}
+			return true;
+		};
+
+		// a spot can have parents at a later spot (eg. the right one), those go first
+		{
+			std::vector<size_t> pending(spots.size());
+			for (size_t s = 0; s < spots.size(); s++) {
+				pending[s] = s;
+			}
+			while (!pending.empty()) {
+				std::vector<size_t> still_pending;
+				for (const size_t s : pending) {
+					if (!merge_spot(s)) {
+						still_pending.push_back(s);
+					}
+				}
+				if (still_pending.size() == pending.size()) {
+					return false; // other is not causally complete
+				}
+				pending = std::move(still_pending);
+			}
+		}
+
+		// the single walk, building the new list
+		std::vector<ListIDInternal> new_list_ids;
+		std::vector<Entry_Data> new_list_data;
+		new_list_ids.reserve(_list_ids.size() + other._list_ids.size());
+		new_list_data.reserve(_list_ids.size() + other._list_ids.size());
+		{
+			size_t i {0};
+			size_t j {0};
+			while (i < _list_ids.size() || j < other._list_ids.size()) {
+				if (j < other._list_ids.size() && spot_of[j] != SIZE_MAX) {
+					const size_t spot_i = spot_of[j];
+					new_list_ids.insert(new_list_ids.end(), spot_ids[spot_i].cbegin(), spot_ids[spot_i].cend());
+					new_list_data.insert(new_list_data.end(), spot_data[spot_i].cbegin(), spot_data[spot_i].cend());
+					i = spots[spot_i].i_end;
+					j = spots[spot_i].j_end;
+				} else {
+					for (; i < _list_ids.size() && !ours_in_other[i]; i++) {
+						new_list_ids.push_back(_list_ids[i]);
+						new_list_data.push_back(_list_data[i]);
+					}
+
+					for (; j < other._list_ids.size() && !other_in_ours[j].has_value(); j++) {
+						const auto& data = other._list_data[j];
+						new_list_ids.push_back(remap(other._list_ids[j]));
+						new_list_data.push_back(Entry_Data{remap_opt(data.parent_left), remap_opt(data.parent_right), data.value});
+					}
+				}
+
+				if (i == _list_ids.size()) {
+					break;
+				}
+
+				// common, deletes win
+				new_list_ids.push_back(_list_ids[i]);
+				new_list_data.push_back(_list_data[i]);
+				if (!other._list_data[j].value.has_value()) {
+					new_list_data.back().value.reset();
+				}
+				i++;
+				j++;
+			}
+		}
+
+		// last seen is the max of both, both sides are causally complete
+		std::unordered_map<size_t, uint64_t> new_last_seen_seq = _last_seen_seq;
+		for (const auto& [other_actor_idx, seq] : other._last_seen_seq) {
+			const size_t actor_idx = actor_remap[other_actor_idx];
+			if (!new_last_seen_seq.count(actor_idx) || new_last_seen_seq.at(actor_idx) < seq) {
+				new_last_seen_seq[actor_idx] = seq;
+			}
+		}
+
+		// commit
+		_actors = std::move(actors);
+		_list_ids = std::move(new_list_ids);
+		_list_data = std::move(new_list_data);
+		_last_seen_seq = std::move(new_last_seen_seq);
+
+		_doc_size = 0;
+		for (const auto& data : _list_data) {
+			if (data.value.has_value()) {
+				_doc_size++;
+			}
+		}
+
+		// positions changed
+		_actor_rank = std::move(actor_rank);
+		_resetHints();
+
+		extra_assert(verify());
+		return true;
+	}
+
 	[[nodiscard]] bool empty(void) const {
 		return _list_ids.empty();
 	}
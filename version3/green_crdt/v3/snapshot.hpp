@@ -0,0 +1,502 @@
+#pragma once
+
+#include "./list.hpp"
+
+#include <array>
+#include <vector>
+#include <string>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+}
+#endif
+
+// compact columnar snapshot of a List
+//
+// layout (native byte order, every column starts 8 byte aligned):
+//   header
+//   actors       actor_count x actor (raw if trivially copyable, else u32 size + bytes)
+//   last_seen    actor_count x u64 (UINT64_MAX if we never saw an op by that actor)
+//   runs         run_count x {u32 actor_idx, u32 length, u64 first_seq}, consecutive ids of the same actor
+//   origin_flags entry_count x u8, see c_origin_*
+//   origins      explicit origins, in entry order (left before right) x {u64 actor_idx, u64 seq}
+//   tombstones   ceil(entry_count/64) x u64, bit set if deleted
+//   values       doc_size x value (raw), only alive entries
+//
+// most parents are implicit (typing), so the origins column stays small
+namespace GreenCRDT::V3 {
+
+namespace snapshot_detail {
+	static constexpr std::array<char, 8> c_magic {'G', 'C', 'R', 'D', 'T', 'S', 'N', '3'};
+	static constexpr uint32_t c_version {1};
+
+	// origin_flags bits
+	static constexpr uint8_t c_origin_left {1u << 0};
+	static constexpr uint8_t c_origin_left_is_prev {1u << 1}; // left parent is the previous entry
+	static constexpr uint8_t c_origin_right {1u << 2};
+	static constexpr uint8_t c_origin_right_is_prev {1u << 3}; // same right parent as the previous entry
+
+	enum Column : size_t {
+		ACTORS,
+		LAST_SEEN,
+		RUNS,
+		ORIGIN_FLAGS,
+		ORIGINS,
+		TOMBSTONES,
+		VALUES,
+
+		COLUMN_COUNT
+	};
+
+	struct Header {
+		std::array<char, 8> magic;
+		uint32_t version;
+		uint32_t actor_size; // 0 for variable size actors
+		uint32_t value_size;
+		uint32_t actor_count;
+		uint64_t entry_count;
+		uint64_t doc_size;
+		uint64_t run_count;
+		uint64_t origin_count;
+		std::array<uint64_t, COLUMN_COUNT> column_offsets;
+		uint64_t total_size;
+	};
+	static_assert(std::is_trivially_copyable_v<Header>);
+	static_assert(sizeof(Header) == 8 + 4*4 + 8*4 + 8*COLUMN_COUNT + 8, "no padding in the header");
+
+	struct Run {
+		uint32_t actor_idx;
+		uint32_t length;
+		uint64_t first_seq;
+	};
+	static_assert(sizeof(Run) == 16);
+
+	struct Origin {
+		uint64_t actor_idx;
+		uint64_t seq;
+	};
+	static_assert(sizeof(Origin) == 16);
+
+	static constexpr size_t align8(size_t v) {
+		return (v + 7u) & ~size_t{7u};
+	}
+
+	template<typename T>
+	static void put(std::vector<uint8_t>& out, const T& value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		const size_t pos = out.size();
+		out.resize(pos + sizeof(T));
+		std::memcpy(out.data() + pos, &value, sizeof(T));
+	}
+
+	static void pad8(std::vector<uint8_t>& out) {
+		out.resize(align8(out.size()), 0u);
+	}
+
+	template<typename ActorType>
+	static constexpr uint32_t actorSize(void) {
+		if constexpr (std::is_trivially_copyable_v<ActorType>) {
+			return sizeof(ActorType);
+		} else {
+			static_assert(std::is_same_v<ActorType, std::string>, "actors need to be trivially copyable or std::string");
+			return 0u;
+		}
+	}
+} // snapshot_detail
+
+template<typename ValueType, typename ActorType>
+[[nodiscard]] std::vector<uint8_t> saveSnapshot(const List<ValueType, ActorType>& list) {
+	using namespace snapshot_detail;
+	using ListType = List<ValueType, ActorType>;
+	static_assert(std::is_trivially_copyable_v<ValueType>, "values are stored raw");
+
+	const size_t entry_count = list._list_ids.size();
+
+	Header header {};
+	header.magic = c_magic;
+	header.version = c_version;
+	header.actor_size = actorSize<ActorType>();
+	header.value_size = sizeof(ValueType);
+	header.actor_count = static_cast<uint32_t>(list._actors.size());
+	header.entry_count = entry_count;
+	header.doc_size = list._doc_size;
+
+	std::vector<uint8_t> out;
+	out.resize(align8(sizeof(Header)));
+
+	header.column_offsets[ACTORS] = out.size();
+	for (const auto& actor : list._actors) {
+		if constexpr (std::is_trivially_copyable_v<ActorType>) {
+			put(out, actor);
+		} else {
+			put(out, static_cast<uint32_t>(actor.size()));
+			out.insert(out.end(), actor.cbegin(), actor.cend());
+		}
+	}
+	pad8(out);
+
+	header.column_offsets[LAST_SEEN] = out.size();
+	for (size_t i = 0; i < list._actors.size(); i++) {
+		const auto it = list._last_seen_seq.find(i);
+		put(out, it == list._last_seen_seq.cend() ? UINT64_MAX : uint64_t{it->second});
+	}
+
+	header.column_offsets[RUNS] = out.size();
+	for (size_t i = 0; i < entry_count;) {
+		const auto& first = list._list_ids[i];
+		uint32_t length {1};
+		while (
+			i + length < entry_count &&
+			length < UINT32_MAX &&
+			list._list_ids[i + length].actor_idx == first.actor_idx &&
+			list._list_ids[i + length].seq == first.seq + length
+		) {
+			length++;
+		}
+
+		put(out, Run{static_cast<uint32_t>(first.actor_idx), length, first.seq});
+		header.run_count++;
+		i += length;
+	}
+
+	header.column_offsets[ORIGIN_FLAGS] = out.size();
+	std::vector<Origin> origins;
+	{
+		const typename ListType::ListIDInternal* prev_id {nullptr};
+		const std::optional<typename ListType::ListIDInternal>* prev_right {nullptr};
+		for (size_t i = 0; i < entry_count; i++) {
+			const auto& data = list._list_data[i];
+			uint8_t flags {0};
+
+			if (data.parent_left.has_value()) {
+				flags |= c_origin_left;
+				if (prev_id != nullptr && *prev_id == data.parent_left.value()) {
+					flags |= c_origin_left_is_prev;
+				} else {
+					origins.push_back({data.parent_left.value().actor_idx, data.parent_left.value().seq});
+				}
+			}
+
+			if (data.parent_right.has_value()) {
+				flags |= c_origin_right;
+				if (prev_right != nullptr && *prev_right == data.parent_right) {
+					flags |= c_origin_right_is_prev;
+				} else {
+					origins.push_back({data.parent_right.value().actor_idx, data.parent_right.value().seq});
+				}
+			}
+
+			out.push_back(flags);
+
+			prev_id = &list._list_ids[i];
+			prev_right = &data.parent_right;
+		}
+	}
+	pad8(out);
+
+	header.column_offsets[ORIGINS] = out.size();
+	header.origin_count = origins.size();
+	for (const auto& origin : origins) {
+		put(out, origin);
+	}
+
+	header.column_offsets[TOMBSTONES] = out.size();
+	{
+		std::vector<uint64_t> bitmap((entry_count + 63) / 64, 0u);
+		for (size_t i = 0; i < entry_count; i++) {
+			if (!list._list_data[i].value.has_value()) {
+				bitmap[i / 64] |= uint64_t{1} << (i % 64);
+			}
+		}
+		for (const auto word : bitmap) {
+			put(out, word);
+		}
+	}
+
+	header.column_offsets[VALUES] = out.size();
+	for (const auto& data : list._list_data) {
+		if (data.value.has_value()) {
+			put(out, data.value.value());
+		}
+	}
+	pad8(out);
+
+	header.total_size = out.size();
+	std::memcpy(out.data(), &header, sizeof(Header));
+
+	return out;
+}
+
+// decodes the columns and hands them to List::bulkLoad()
+// data does not need to outlive the list, so it can be a short lived mapping
+// returns false and leaves list untouched on malformed data
+template<typename ValueType, typename ActorType>
+[[nodiscard]] bool loadSnapshot(List<ValueType, ActorType>& list, const uint8_t* data, size_t size) {
+	using namespace snapshot_detail;
+	using ListType = List<ValueType, ActorType>;
+	using ListIDInternal = typename ListType::ListIDInternal;
+
+	if (size < sizeof(Header)) {
+		return false;
+	}
+
+	Header header;
+	std::memcpy(&header, data, sizeof(Header));
+
+	if (
+		header.magic != c_magic ||
+		header.version != c_version ||
+		header.actor_size != actorSize<ActorType>() ||
+		header.value_size != sizeof(ValueType) ||
+		header.total_size > size ||
+		// every entry takes at least a byte (its origin flags), and there is no more than a run
+		// and an explicit origin pair per entry. so the column sizes below can not overflow
+		header.entry_count > header.total_size ||
+		header.doc_size > header.entry_count ||
+		header.run_count > header.entry_count ||
+		header.origin_count > header.entry_count * 2
+	) {
+		return false;
+	}
+
+	// column bounds
+	const std::array<uint64_t, COLUMN_COUNT> column_sizes {
+		0u, // actors, variable, checked while reading
+		uint64_t{header.actor_count} * sizeof(uint64_t),
+		header.run_count * sizeof(Run),
+		header.entry_count,
+		header.origin_count * sizeof(Origin),
+		(header.entry_count + 63) / 64 * sizeof(uint64_t),
+		header.doc_size * sizeof(ValueType),
+	};
+	for (size_t c = 0; c < COLUMN_COUNT; c++) {
+		if (header.column_offsets[c] > header.total_size || column_sizes[c] > header.total_size - header.column_offsets[c]) {
+			return false;
+		}
+	}
+
+	const auto column = [data, &header](Column c) {
+		return data + header.column_offsets[c];
+	};
+
+	std::vector<ActorType> actors;
+	std::vector<ListIDInternal> list_ids;
+	std::vector<typename ListType::Entry_Data> list_data;
+
+	{ // actors
+		const uint8_t* it = column(ACTORS);
+		const uint8_t* end = data + header.column_offsets[LAST_SEEN];
+		if (end < it) {
+			return false;
+		}
+
+		actors.reserve(header.actor_count);
+		for (size_t i = 0; i < header.actor_count; i++) {
+			if constexpr (std::is_trivially_copyable_v<ActorType>) {
+				if (static_cast<size_t>(end - it) < sizeof(ActorType)) {
+					return false;
+				}
+				ActorType actor;
+				std::memcpy(&actor, it, sizeof(ActorType));
+				it += sizeof(ActorType);
+				actors.push_back(actor);
+			} else {
+				uint32_t actor_size {0};
+				if (static_cast<size_t>(end - it) < sizeof(actor_size)) {
+					return false;
+				}
+				std::memcpy(&actor_size, it, sizeof(actor_size));
+				it += sizeof(actor_size);
+				if (static_cast<size_t>(end - it) < actor_size) {
+					return false;
+				}
+				actors.emplace_back(reinterpret_cast<const char*>(it), actor_size);
+				it += actor_size;
+			}
+		}
+	}
+
+	list_ids.reserve(header.entry_count);
+	for (size_t r = 0; r < header.run_count; r++) {
+		Run run;
+		std::memcpy(&run, column(RUNS) + r * sizeof(Run), sizeof(Run));
+		if (run.actor_idx >= header.actor_count || run.length == 0 || run.length > header.entry_count - list_ids.size()) {
+			return false;
+		}
+		for (uint32_t i = 0; i < run.length; i++) {
+			list_ids.push_back(ListIDInternal{run.actor_idx, run.first_seq + i});
+		}
+	}
+	if (list_ids.size() != header.entry_count) {
+		return false;
+	}
+
+	list_data.resize(header.entry_count);
+
+	{ // origins
+		const uint8_t* flags_column = column(ORIGIN_FLAGS);
+		size_t origin_i {0};
+		const auto next_origin = [&]() -> std::optional<ListIDInternal> {
+			if (origin_i >= header.origin_count) {
+				return std::nullopt;
+			}
+			Origin origin;
+			std::memcpy(&origin, column(ORIGINS) + origin_i++ * sizeof(Origin), sizeof(Origin));
+			if (origin.actor_idx >= header.actor_count) {
+				return std::nullopt;
+			}
+			return ListIDInternal{static_cast<size_t>(origin.actor_idx), origin.seq};
+		};
+
+		for (size_t i = 0; i < header.entry_count; i++) {
+			const uint8_t flags = flags_column[i];
+			auto& entry = list_data[i];
+
+			if (flags & c_origin_left) {
+				if (flags & c_origin_left_is_prev) {
+					if (i == 0) {
+						return false;
+					}
+					entry.parent_left = list_ids[i-1];
+				} else {
+					entry.parent_left = next_origin();
+					if (!entry.parent_left.has_value()) {
+						return false;
+					}
+				}
+			}
+
+			if (flags & c_origin_right) {
+				if (flags & c_origin_right_is_prev) {
+					if (i == 0 || !list_data[i-1].parent_right.has_value()) {
+						return false;
+					}
+					entry.parent_right = list_data[i-1].parent_right;
+				} else {
+					entry.parent_right = next_origin();
+					if (!entry.parent_right.has_value()) {
+						return false;
+					}
+				}
+			}
+		}
+
+		if (origin_i != header.origin_count) {
+			return false;
+		}
+	}
+
+	{ // tombstones + values
+		const uint8_t* tombstones = column(TOMBSTONES);
+		const uint8_t* values = column(VALUES);
+		size_t value_i {0};
+		for (size_t i = 0; i < header.entry_count; i++) {
+			uint64_t word {0};
+			std::memcpy(&word, tombstones + (i / 64) * sizeof(uint64_t), sizeof(word));
+			if (word & (uint64_t{1} << (i % 64))) {
+				continue; // deleted
+			}
+
+			if (value_i >= header.doc_size) {
+				return false;
+			}
+
+			ValueType value;
+			std::memcpy(&value, values + value_i++ * sizeof(ValueType), sizeof(ValueType));
+			list_data[i].value = value;
+		}
+
+		if (value_i != header.doc_size) {
+			return false;
+		}
+	}
+
+	ListType tmp;
+	if (!tmp.bulkLoad(std::move(actors), std::move(list_ids), std::move(list_data))) {
+		return false;
+	}
+
+	// redundant, but cheap to check
+	for (size_t i = 0; i < header.actor_count; i++) {
+		uint64_t last_seen {0};
+		std::memcpy(&last_seen, column(LAST_SEEN) + i * sizeof(uint64_t), sizeof(last_seen));
+
+		const auto it = tmp._last_seen_seq.find(i);
+		if (last_seen != (it == tmp._last_seen_seq.cend() ? UINT64_MAX : it->second)) {
+			return false;
+		}
+	}
+
+	list = std::move(tmp);
+
+	return true;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// writes to a temporary file first, so an existing snapshot is replaced atomically
+template<typename ValueType, typename ActorType>
+[[nodiscard]] bool saveSnapshotFile(const List<ValueType, ActorType>& list, const std::string& path) {
+	const auto data = saveSnapshot(list);
+
+	const std::string tmp_path = path + ".tmp";
+	const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+
+	size_t written {0};
+	while (written < data.size()) {
+		const ssize_t ret = ::write(fd, data.data() + written, data.size() - written);
+		if (ret < 0) {
+			::close(fd);
+			return false;
+		}
+		written += static_cast<size_t>(ret);
+	}
+
+	const bool synced = ::fsync(fd) == 0;
+	::close(fd);
+
+	return synced && ::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+// maps the file, only the columns get touched
+template<typename ValueType, typename ActorType>
+[[nodiscard]] bool loadSnapshotFile(List<ValueType, ActorType>& list, const std::string& path) {
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st {};
+	if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+		::close(fd);
+		return false;
+	}
+
+	const size_t size = static_cast<size_t>(st.st_size);
+	void* ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (ptr == MAP_FAILED) {
+		return false;
+	}
+
+	::madvise(ptr, size, MADV_SEQUENTIAL);
+
+	const bool res = loadSnapshot(list, static_cast<const uint8_t*>(ptr), size);
+
+	::munmap(ptr, size);
+
+	return res;
+}
+#endif
+
+} // GreenCRDT::V3
+
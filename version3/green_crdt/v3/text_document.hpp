@@ -1,6 +1,7 @@
 #pragma once
 
 #include "./list.hpp"
+#include "./snapshot.hpp"
 
 #include <variant>
 
@@ -50,6 +51,15 @@ struct TextDocument {
 		return text;
 	}
 
+	// see snapshot.hpp, local_actor is not part of the snapshot
+	[[nodiscard]] std::vector<uint8_t> saveSnapshot(void) const {
+		return GreenCRDT::V3::saveSnapshot(state);
+	}
+
+	[[nodiscard]] bool loadSnapshot(const uint8_t* data, size_t size) {
+		return GreenCRDT::V3::loadSnapshot(state, data, size);
+	}
+
 	bool apply(const Op& op) {
 		if(std::holds_alternative<OpAdd>(op)) {
 			const auto& add_op = std::get<OpAdd>(op);
@@ -104,10 +114,7 @@ struct TextDocument {
 		std::optional<typename ListType::ListID> parent_right,
 		std::string_view text
 	) {
-		// TODO: move actor setting to list
-		if (!state.findActor(local_actor).has_value()) {
-			state._actors.push_back(local_actor);
-		}
+		state._internActor(local_actor);
 
 		// TODO: look up typesystem and fix (move? decltype?)
 		std::vector<Op> ops = text2adds(
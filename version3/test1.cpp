@@ -1,5 +1,7 @@
 #define EXTRA_ASSERTS 1
+#define GREEN_CRDT_STATS 1
 #include <green_crdt/v3/list.hpp>
+#include <green_crdt/v3/snapshot.hpp>
 
 #include <numeric>
 #include <random>
@@ -7,6 +9,7 @@
 #include <cassert>
 #include <string_view>
 #include <vector>
+#include <cstring>
 
 // single letter actor, for testing only
 using Actor = char;
@@ -184,6 +187,355 @@ void testMain1(void) {
 	std::cout << std::string_view(tmp_array.data(), tmp_array.size()) << "\n";
 }
 
+void testSnapshot1(void) {
+	ListType list;
+
+	assert(list.add({'0', 0u}, 'a', std::nullopt, std::nullopt));
+	assert(list.add({'0', 1u}, 'b', ListType::ListID{'0', 0u}, std::nullopt));
+	assert(list.add({'0', 2u}, 'c', ListType::ListID{'0', 1u}, std::nullopt));
+	assert(list.add({'0', 3u}, 'd', ListType::ListID{'0', 1u}, ListType::ListID{'0', 2u}));
+	assert(list.add({'1', 0u}, 'z', ListType::ListID{'0', 0u}, ListType::ListID{'0', 1u}));
+	assert(list.add({'1', 1u}, 'y', ListType::ListID{'0', 1u}, std::nullopt));
+	assert(list.del({'0', 2u}));
+	assert(list.getArray() == "azbdy");
+
+	const auto data = GreenCRDT::V3::saveSnapshot(list);
+
+	ListType loaded;
+	assert(GreenCRDT::V3::loadSnapshot(loaded, data.data(), data.size()));
+	assert(loaded.verify());
+	assert(loaded.getArray() == "azbdy");
+	assert(loaded.size() == list.size());
+	assert(loaded.getDocSize() == list.getDocSize());
+	for (size_t i = 0; i < list.size(); i++) {
+		assert(loaded.getID(i) == list.getID(i));
+		assert(loaded._list_data[i].parent_left == list._list_data[i].parent_left);
+		assert(loaded._list_data[i].parent_right == list._list_data[i].parent_right);
+		assert(loaded.getValue(i) == list.getValue(i));
+	}
+
+	// still accepts the next ops, and rejects gaps
+	assert(!loaded.add({'0', 5u}, 'x', ListType::ListID{'1', 1u}, std::nullopt));
+	assert(loaded.add({'0', 4u}, 'x', ListType::ListID{'1', 1u}, std::nullopt));
+	assert(loaded.getArray() == "azbdyx");
+
+	{ // truncated or corrupt data is rejected, and leaves the list alone
+		assert(!GreenCRDT::V3::loadSnapshot(loaded, data.data(), data.size()-8));
+
+		auto bad_data = data;
+		bad_data[0] = 'X';
+		assert(!GreenCRDT::V3::loadSnapshot(loaded, bad_data.data(), bad_data.size()));
+
+		assert(loaded.getArray() == "azbdyx");
+	}
+
+	{ // empty
+		ListType empty_list;
+		const auto empty_data = GreenCRDT::V3::saveSnapshot(empty_list);
+		assert(GreenCRDT::V3::loadSnapshot(loaded, empty_data.data(), empty_data.size()));
+		assert(loaded.empty());
+		assert(loaded._actors.empty());
+	}
+
+	{ // counts in the header that dont fit the entries, would overflow the column bounds
+		using GreenCRDT::V3::snapshot_detail::Header;
+		using GreenCRDT::V3::snapshot_detail::Run;
+
+		const auto corrupt = [](std::vector<uint8_t> bad_data, auto fn) {
+			Header header;
+			std::memcpy(&header, bad_data.data(), sizeof(Header));
+			fn(header);
+			std::memcpy(bad_data.data(), &header, sizeof(Header));
+			return bad_data;
+		};
+
+		ListType empty_list;
+		const auto empty_data = GreenCRDT::V3::saveSnapshot(empty_list);
+		for (const auto& bad_data : {
+			corrupt(empty_data, [](Header& h) { h.run_count = uint64_t{1} << 60; }),
+			corrupt(empty_data, [](Header& h) { h.origin_count = uint64_t{1} << 60; }),
+			corrupt(data, [](Header& h) { h.run_count = uint64_t{1} << 60; }),
+			corrupt(data, [](Header& h) { h.origin_count = uint64_t{1} << 60; }),
+			corrupt(data, [](Header& h) { h.entry_count = UINT64_MAX; }),
+		}) {
+			assert(!GreenCRDT::V3::loadSnapshot(loaded, bad_data.data(), bad_data.size()));
+		}
+
+		// a run of 0 entries would never reach the entry count
+		Header header;
+		std::memcpy(&header, data.data(), sizeof(Header));
+		auto bad_data = data;
+		Run run;
+		std::memcpy(&run, bad_data.data() + header.column_offsets[GreenCRDT::V3::snapshot_detail::RUNS], sizeof(Run));
+		run.length = 0;
+		std::memcpy(bad_data.data() + header.column_offsets[GreenCRDT::V3::snapshot_detail::RUNS], &run, sizeof(Run));
+		assert(!GreenCRDT::V3::loadSnapshot(loaded, bad_data.data(), bad_data.size()));
+
+		assert(loaded.empty());
+	}
+}
+
+void testBulkLoad1(void) {
+	ListType list;
+
+	assert(list.add({'0', 0u}, 'a', std::nullopt, std::nullopt));
+	assert(list.add({'0', 1u}, 'b', ListType::ListID{'0', 0u}, std::nullopt));
+	assert(list.add({'0', 2u}, 'c', ListType::ListID{'0', 1u}, std::nullopt));
+	assert(list.add({'1', 0u}, 'z', ListType::ListID{'0', 0u}, ListType::ListID{'0', 1u}));
+	assert(list.add({'2', 0u}, 'q', ListType::ListID{'0', 2u}, std::nullopt));
+	assert(list.del({'0', 1u}));
+	assert(list.getArray() == "azcq");
+
+	ListType loaded;
+	assert(loaded.bulkLoad(list.getOrderedEntries()));
+	assert(loaded.verify());
+	assert(loaded.getArray() == "azcq");
+	assert(loaded.size() == list.size());
+	assert(loaded.getDocSize() == list.getDocSize());
+	for (size_t i = 0; i < list.size(); i++) {
+		assert(loaded.getID(i) == list.getID(i));
+	}
+
+	// concurrent op after the load integrates the same on both
+	assert(list.add({'1', 1u}, 'y', ListType::ListID{'0', 0u}, ListType::ListID{'1', 0u}));
+	assert(loaded.add({'1', 1u}, 'y', ListType::ListID{'0', 0u}, ListType::ListID{'1', 0u}));
+	assert(loaded.getArray() == list.getArray());
+
+	{ // gap in seqs
+		auto entries = list.getOrderedEntries();
+		entries.erase(entries.begin()); // {0, 0}
+		ListType bad;
+		assert(!bad.bulkLoad(entries));
+		assert(bad.empty());
+	}
+
+	{ // parent by an actor that is not in the list
+		auto entries = list.getOrderedEntries();
+		entries.back().parent_left = ListType::ListID{'9', 0u};
+		ListType bad;
+		assert(!bad.bulkLoad(entries));
+	}
+}
+
+void testMerge1(void) {
+	struct AddOp {
+		ListType::ListID id;
+		char value;
+		std::optional<ListType::ListID> parent_left;
+		std::optional<ListType::ListID> parent_right;
+	};
+
+	const auto apply = [](ListType& list, const std::vector<AddOp>& ops) {
+		for (const auto& op : ops) {
+			assert(list.add(op.id, op.value, op.parent_left, op.parent_right));
+		}
+	};
+
+	// common history
+	const std::vector<AddOp> ops_base {
+		{{'0', 0u}, 'a', std::nullopt, std::nullopt},
+		{{'0', 1u}, 'b', ListType::ListID{'0', 0u}, std::nullopt},
+		{{'0', 2u}, 'c', ListType::ListID{'0', 1u}, std::nullopt},
+	};
+
+	// partitioned, both insert concurrently between a and b, only 1 inserts after c
+	const std::vector<AddOp> ops_1 {
+		{{'1', 0u}, 'x', ListType::ListID{'0', 0u}, ListType::ListID{'0', 1u}},
+		{{'1', 1u}, 'y', ListType::ListID{'1', 0u}, ListType::ListID{'0', 1u}},
+		{{'1', 2u}, 'z', ListType::ListID{'0', 2u}, std::nullopt},
+	};
+	const std::vector<AddOp> ops_2 {
+		{{'2', 0u}, 'm', ListType::ListID{'0', 0u}, ListType::ListID{'0', 1u}},
+		{{'2', 1u}, 'n', ListType::ListID{'2', 0u}, ListType::ListID{'0', 1u}},
+		{{'0', 3u}, 'd', ListType::ListID{'0', 2u}, std::nullopt}, // depends on nothing deferred
+	};
+
+	ListType list_1;
+	apply(list_1, ops_base);
+	ListType list_2 = list_1;
+
+	apply(list_1, ops_1);
+	assert(list_1.del({'0', 1u}));
+	apply(list_2, ops_2);
+	assert(list_2.del({'0', 2u}));
+
+	// reference, op replay
+	ListType expected = list_1;
+	apply(expected, ops_2);
+	assert(expected.del({'0', 2u}));
+
+	ListType merged_1 = list_1;
+	assert(merged_1.merge(list_2));
+	assert(merged_1.verify());
+	assert(merged_1.getArray() == expected.getArray());
+	assert(merged_1.getDocSize() == expected.getDocSize());
+
+	ListType merged_2 = list_2;
+	assert(merged_2.merge(list_1));
+	assert(merged_2.verify());
+	assert(merged_2.getArray() == expected.getArray());
+	for (size_t i = 0; i < expected.size(); i++) {
+		assert(merged_1.getID(i) == expected.getID(i));
+		assert(merged_2.getID(i) == expected.getID(i));
+	}
+
+	// merging again is a noop
+	assert(merged_1.merge(merged_2));
+	assert(merged_1.getArray() == expected.getArray());
+	assert(merged_1.size() == expected.size());
+
+	// still usable after the merge, seqs continue
+	assert(!merged_1.add({'1', 2u}, 'w', std::nullopt, std::nullopt));
+	assert(merged_1.add({'1', 3u}, 'w', std::nullopt, std::nullopt));
+	assert(expected.add({'1', 3u}, 'w', std::nullopt, std::nullopt));
+	assert(merged_1.getArray() == expected.getArray());
+
+	{ // empty on either side
+		ListType empty;
+		assert(empty.merge(list_1));
+		assert(empty.getArray() == list_1.getArray());
+
+		ListType copy = list_1;
+		assert(copy.merge(ListType{}));
+		assert(copy.getArray() == list_1.getArray());
+	}
+}
+
+void testStats1(void) {
+	ListType list;
+	assert(list.getStats().integrate == 0);
+
+	assert(list.add({'0', 0u}, 'a', std::nullopt, std::nullopt));
+	assert(list.add({'0', 1u}, 'b', ListType::ListID{'0', 0u}, std::nullopt));
+	assert(list.add({'0', 2u}, 'c', ListType::ListID{'0', 1u}, std::nullopt));
+	assert(list.getStats().integrate == 3);
+	assert(list.getStats().integrate_moved_bytes == 0); // only appends
+	assert(list.getStats().find_with_hint_hit == list.getStats().find_with_hint);
+
+	// concurrent at the same spot, has to look at the other entry
+	assert(list.add({'1', 0u}, 'x', ListType::ListID{'0', 0u}, ListType::ListID{'0', 1u}));
+	assert(list.add({'2', 0u}, 'y', ListType::ListID{'0', 0u}, ListType::ListID{'0', 1u}));
+	assert(list.getArray() == "axybc");
+	assert(list.getStats().integrate == 5);
+	assert(list.getStats().integrate_conflict_iterations >= 1);
+	assert(list.getStats().integrate_moved_bytes > 0);
+	assert(list.getStats().find_actor > 0);
+
+	list.resetStats();
+	assert(list.getStats().integrate == 0);
+	assert(list.getStats().find_actor == 0);
+
+	// unknown ids are a full scan
+	assert(!list.findIdx(ListType::ListIDInternal{0u, 99u}).has_value());
+	assert(list.getStats().find_full == 1);
+	assert(list.getStats().find_full_scanned == list.size());
+}
+
+void testFindIdxHint1(void) {
+	ListType list;
+	for (size_t i = 0; i < 300; i++) {
+		std::optional<ListType::ListID> parent_left;
+		if (i != 0) {
+			parent_left = ListType::ListID{'0', i-1};
+		}
+		assert(list.add({'0', i}, 'a', parent_left, std::nullopt));
+	}
+
+	// found from anywhere, including hints past the end
+	for (const size_t hint : {size_t(0), size_t(1), size_t(150), size_t(299), size_t(1000)}) {
+		for (size_t i = 0; i < list.size(); i++) {
+			const auto idx_opt = list.findIdx(ListType::ListIDInternal{0u, i}, hint);
+			assert(idx_opt.has_value());
+			assert(idx_opt.value() == i);
+		}
+	}
+
+	// a miss looks at every entry once, not twice
+	list.resetStats();
+	assert(!list.findIdx(ListType::ListIDInternal{0u, 300u}, 150).has_value());
+	assert(list.getStats().find_with_hint_scanned == list.size());
+	assert(list.getStats().find_full == 0);
+
+	// close to the hint is cheap
+	list.resetStats();
+	assert(list.findIdx(ListType::ListIDInternal{0u, 140u}, 150).value() == 140);
+	assert(list.getStats().find_with_hint_scanned <= 64);
+
+	// window learns the distance of an actor
+	ListType::HintWindow window;
+	ListType::_adaptHintWindow(window, 100, 120);
+	assert(window.post == 20);
+	ListType::_adaptHintWindow(window, 100, 1000);
+	assert(window.post == ListType::c_hint_window_max);
+	ListType::_adaptHintWindow(window, 100, 99);
+	assert(window.pre == ListType::c_hint_pre);
+	ListType::_adaptHintWindow(window, 100, 100);
+	assert(window.post == ListType::c_hint_window_max - 1);
+}
+
+void testHintShift1(void) {
+	ListType list;
+
+	// 0 types at the end, 1 keeps inserting at the front
+	std::optional<ListType::ListID> last_0;
+	for (size_t i = 0; i < 20; i++) {
+		assert(list.add({'0', i}, 'a', last_0, std::nullopt));
+		last_0 = ListType::ListID{'0', i};
+
+		std::optional<ListType::ListID> first;
+		if (!list.empty()) {
+			first = list.getID(0);
+		}
+		assert(list.add({'1', i}, 'b', std::nullopt, first));
+
+		// hint of 0 still points at its last insert
+		const size_t actor_0 = list.findActor('0').value();
+		assert(list._last_inserted_idx.at(actor_0) == list.findIdx(last_0.value()).value());
+
+		const size_t actor_1 = list.findActor('1').value();
+		assert(list._last_inserted_idx.at(actor_1) == 0);
+	}
+
+	// with the hints right, 0 always hits
+	list.resetStats();
+	assert(list.add({'0', 20u}, 'a', last_0, std::nullopt));
+	assert(list.getStats().find_with_hint_hit == list.getStats().find_with_hint);
+}
+
+void testActorRank1(void) {
+	ListType list;
+
+	// actors show up in random order
+	const std::string_view actors {"m3xa0z9b"};
+	for (size_t i = 0; i < actors.size(); i++) {
+		std::optional<ListType::ListID> parent_left;
+		if (i != 0) {
+			parent_left = ListType::ListID{actors[i-1], 0u};
+		}
+		assert(list.add({actors[i], 0u}, 'a', parent_left, std::nullopt));
+	}
+
+	const auto check_ranks = [](const ListType& l) {
+		assert(l._actor_rank.size() == l._actors.size());
+		for (size_t i = 0; i < l._actors.size(); i++) {
+			for (size_t j = 0; j < l._actors.size(); j++) {
+				assert((l._actors[i] < l._actors[j]) == (l._actor_rank[i] < l._actor_rank[j]));
+			}
+		}
+	};
+	check_ranks(list);
+
+	// same after replacing the actors
+	ListType other;
+	assert(other.add({'5', 0u}, 'b', std::nullopt, std::nullopt));
+	assert(other.merge(list));
+	check_ranks(other);
+
+	ListType loaded;
+	assert(loaded.bulkLoad(other.getOrderedEntries()));
+	check_ranks(loaded);
+}
+
 int main(void) {
 	std::cout << "testSingle1:\n";
 	testSingle1();
@@ -209,6 +561,34 @@ int main(void) {
 	testMain1();
 	std::cout << std::string(40, '-') << "\n";
 
+	std::cout << "testBulkLoad1:\n";
+	testBulkLoad1();
+	std::cout << std::string(40, '-') << "\n";
+
+	std::cout << "testSnapshot1:\n";
+	testSnapshot1();
+	std::cout << std::string(40, '-') << "\n";
+
+	std::cout << "testMerge1:\n";
+	testMerge1();
+	std::cout << std::string(40, '-') << "\n";
+
+	std::cout << "testStats1:\n";
+	testStats1();
+	std::cout << std::string(40, '-') << "\n";
+
+	std::cout << "testFindIdxHint1:\n";
+	testFindIdxHint1();
+	std::cout << std::string(40, '-') << "\n";
+
+	std::cout << "testHintShift1:\n";
+	testHintShift1();
+	std::cout << std::string(40, '-') << "\n";
+
+	std::cout << "testActorRank1:\n";
+	testActorRank1();
+	std::cout << std::string(40, '-') << "\n";
+
 	return 0;
 }
 
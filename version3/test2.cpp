@@ -1,3 +1,4 @@
+#define GREEN_CRDT_STATS 1
 #include <green_crdt/v3/text_document.hpp>
 
 #include <numeric>
@@ -592,6 +593,131 @@ void testPaste2(void) {
 	}
 }
 
+void testSnapshot1(void) {
+	Doc docA;
+	docA.local_actor = "A";
+
+	Doc docB;
+	docB.local_actor = "B";
+
+	for (const std::string_view text : {"iiiiiii", "iiabciiii\n", "iiabciiii\nxyz", "iibciiii\nz"}) {
+		assert(docB.apply(docA.merge(text)));
+	}
+	assert(docB.apply(docA.merge("iibciiii\nz")));
+	assert(docA.apply(docB.merge("BBiibciiii\nz")));
+	assert(docA.getText() == docB.getText());
+
+	const auto data = docA.saveSnapshot();
+
+	Doc docC;
+	docC.local_actor = "A";
+	assert(docC.loadSnapshot(data.data(), data.size()));
+	assert(docC.getText() == docA.getText());
+	assert(docC.state.size() == docA.state.size());
+	assert(docC.state.getDocSize() == docA.state.getDocSize());
+
+	// the loaded doc continues where A left off
+	const auto ops = docC.merge("BBiibciiii\nzC");
+	assert(docA.apply(ops));
+	assert(docB.apply(ops));
+	assert(docA.getText() == docC.getText());
+	assert(docB.getText() == docC.getText());
+}
+
+void testMerge1(size_t seed) {
+	Rng rng(seed);
+
+	Doc doc;
+	doc.local_actor = "0";
+	doc.addText(std::nullopt, std::nullopt, "0123456789");
+
+	// partitioned replicas edit concurrently
+	Doc docA = doc;
+	docA.local_actor = "A";
+	Doc docB = doc;
+	docB.local_actor = "B";
+
+	const auto gen_ops = [&rng](Doc& d) {
+		std::vector<Op> ops;
+		const size_t loop_count = (rng() % 20)+1;
+		for (size_t i = 0; i < loop_count; i++) {
+			if (d.state.getDocSize() != 0 && rng() % 3 == 0) {
+				ops.push_back(genDel(rng, d));
+			} else {
+				ops.push_back(genAdd(rng, d));
+			}
+		}
+		return ops;
+	};
+
+	const auto ops_a = gen_ops(docA);
+	const auto ops_b = gen_ops(docB);
+
+	// reference, op replay
+	Doc expected = docA;
+	for (const auto& op : ops_b) {
+		// both might have deleted the same, double deletes are rejected
+		const bool r = expected.apply(op);
+		assert(r || std::holds_alternative<Doc::OpDel>(op));
+	}
+
+	Doc mergedA = docA;
+	assert(mergedA.state.merge(docB.state));
+	assert(mergedA.state.verify());
+	assert(mergedA.getText() == expected.getText());
+
+	Doc mergedB = docB;
+	assert(mergedB.state.merge(docA.state));
+	assert(mergedB.state.verify());
+	assert(mergedB.getText() == expected.getText());
+
+	assert(mergedA.state.size() == expected.state.size());
+	for (size_t i = 0; i < expected.state.size(); i++) {
+		assert(mergedA.state.getID(i) == expected.state.getID(i));
+		assert(mergedB.state.getID(i) == expected.state.getID(i));
+	}
+}
+
+// both partitioned replicas kept typing at the end, the common case after a long split.
+// each run goes in as a block, integrating them entry by entry takes minutes at this size
+void testMerge2(void) {
+	const size_t count {100'000};
+
+	Doc doc;
+	doc.local_actor = "0";
+	doc.addText(std::nullopt, std::nullopt, "0123456789");
+	const auto last_id = doc.state.getID(doc.state.size()-1);
+
+	Doc docA = doc;
+	docA.local_actor = "A";
+	docA.addText(last_id, std::nullopt, std::string(count, 'a'));
+	Doc docB = doc;
+	docB.local_actor = "B";
+	docB.addText(last_id, std::nullopt, std::string(count, 'b'));
+
+	// same left and right parent, the actor tie breaker puts A first
+	const std::string expected_text = "0123456789" + std::string(count, 'a') + std::string(count, 'b');
+
+	Doc mergedA = docA;
+	mergedA.state.resetStats();
+	assert(mergedA.state.merge(docB.state));
+	assert(mergedA.state.verify());
+	assert(mergedA.state.getStats().integrate == 0);
+	assert(mergedA.getText() == expected_text);
+
+	Doc mergedB = docB;
+	mergedB.state.resetStats();
+	assert(mergedB.state.merge(docA.state));
+	assert(mergedB.state.verify());
+	assert(mergedB.state.getStats().integrate == 0);
+	assert(mergedB.getText() == expected_text);
+
+	assert(mergedA.state.size() == mergedB.state.size());
+	for (size_t i = 0; i < mergedA.state.size(); i++) {
+		assert(mergedA.state.getID(i) == mergedB.state.getID(i));
+	}
+}
+
 int main(void) {
 	const size_t loops = 1'000;
 	{
@@ -696,6 +822,31 @@ int main(void) {
 		testPaste2();
 	}
 
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testSnapshot1:\n";
+		testSnapshot1();
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testMerge1:\n";
+		for (size_t i = 0; i < loops; i++) {
+			std::cout << "i " << i << "\n";
+			testMerge1(1337+i);
+			std::cout << std::string(40, '-') << "\n";
+		}
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testMerge2:\n";
+		testMerge2();
+	}
+
 	return 0;
 }
 
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <optional>
+#include <utility>
+#include <variant>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace apply {
+
+// applies staged remote commands in bounded slices, resuming where the last slice stopped.
+// commands are applied op by op, so a single huge command (eg. a big paste) can span multiple slices.
+template<typename DocType, typename AgentType, typename CommandType>
+struct Scheduler {
+	using CommandLists = std::unordered_map<AgentType, std::unordered_map<uint64_t, CommandType>>;
+	using Frontier = std::unordered_map<AgentType, uint64_t>;
+	using ListID = typename DocType::ListType::ListID;
+
+	struct Budget {
+		size_t max_ops {1024};
+		std::chrono::microseconds max_time {4000};
+	};
+
+	struct Result {
+		size_t ops_applied {0};
+		size_t ops_skipped {0}; // their effect was already there, the doc did not change
+		size_t agents_blocked {0}; // agents with ops we could not apply (missing parents from other agents)
+		bool changes {false}; // doc was modified
+		bool more_pending {false}; // budget ran out, caller should come back soon
+
+		// entries the applied ops added or deleted, so callers know where the doc changed
+		std::vector<ListID> applied_ids;
+	};
+
+	// number of ops of the next command (command_frontier + 1) that are already in the doc
+	std::unordered_map<AgentType, size_t> partial_ops;
+
+	// viewport is a range of list indices [first, second)
+	// agents editing closer to it get applied first
+	Result run(
+		DocType& doc,
+		const CommandLists& command_lists,
+		Frontier& command_frontier,
+		const Frontier& staging_frontier,
+		const Budget& budget,
+		const std::optional<std::pair<size_t, size_t>>& viewport = std::nullopt
+	) {
+		using clock = std::chrono::steady_clock;
+		const auto time_start = clock::now();
+
+		Result result;
+
+		// (distance to viewport, agent)
+		std::vector<std::pair<size_t, AgentType>> queue;
+		for (const auto& [agent, staging_seq] : staging_frontier) {
+			if (nextSeq(command_frontier, agent) > staging_seq) {
+				continue; // nothing new
+			}
+
+			queue.emplace_back(distanceToViewport(doc, command_lists, command_frontier, agent, viewport), agent);
+		}
+
+		// stable, so agents with equal distance keep a deterministic order within a run
+		std::stable_sort(queue.begin(), queue.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+		const auto budget_exhausted = [&]() -> bool {
+			if (result.ops_applied >= budget.max_ops) {
+				return true;
+			}
+			// dont hit the clock for every op. skipped ones still cost a lookup
+			const size_t ops_done = result.ops_applied + result.ops_skipped;
+			return (ops_done % 32) == 0 && ops_done != 0 && clock::now() - time_start >= budget.max_time;
+		};
+
+		// agents can depend on each other (parents), so keep going as long as someone makes progress
+		bool progress {true};
+		while (progress && !queue.empty()) {
+			progress = false;
+			result.agents_blocked = 0;
+
+			for (auto it = queue.begin(); it != queue.end();) {
+				const AgentType& agent = it->second;
+				const uint64_t staging_seq = staging_frontier.at(agent);
+
+				bool blocked {false};
+				for (uint64_t seq = nextSeq(command_frontier, agent); seq <= staging_seq; seq = nextSeq(command_frontier, agent)) {
+					const auto& ops = command_lists.at(agent).at(seq).ops;
+
+					size_t& op_i = partial_ops[agent];
+					for (; op_i < ops.size(); op_i++) {
+						if (budget_exhausted()) {
+							result.more_pending = true;
+							return result;
+						}
+
+						if (!doc.apply(ops[op_i])) {
+							if (!isApplied(doc, ops[op_i])) {
+								blocked = true;
+								break;
+							}
+
+							// nothing changed, nothing to publish or fetch
+							result.ops_skipped++;
+							progress = true;
+							continue;
+						}
+
+						result.ops_applied++;
+						result.changes = true;
+						result.applied_ids.push_back(std::visit([](const auto& o) { return o.id; }, ops[op_i]));
+						progress = true;
+					}
+
+					if (blocked) {
+						break;
+					}
+
+					// command fully applied
+					command_frontier[agent] = seq;
+					partial_ops.erase(agent);
+				}
+
+				if (blocked) {
+					result.agents_blocked++;
+					it++;
+				} else {
+					it = queue.erase(it);
+				}
+			}
+		}
+
+		return result;
+	}
+
+	// the op failed, but only because its effect is already there
+	// (eg. two agents deleted the same entry concurrently)
+	template<typename OpType>
+	static bool isApplied(const DocType& doc, const OpType& op) {
+		return std::visit([&doc](const auto& o) { return doc.state.findIdx(o.id).has_value(); }, op);
+	}
+
+	// adds are anchored at their parents
+	template<typename OpType>
+	static auto anchorOf(const OpType& op, int) -> decltype(op.parent_left.has_value() ? op.parent_left : op.parent_right) {
+		return op.parent_left.has_value() ? op.parent_left : op.parent_right;
+	}
+
+	// dels at the entry they delete
+	template<typename OpType>
+	static auto anchorOf(const OpType& op, long) -> std::optional<decltype(op.id)> {
+		return op.id;
+	}
+
+	static uint64_t nextSeq(const Frontier& command_frontier, const AgentType& agent) {
+		const auto it = command_frontier.find(agent);
+		if (it == command_frontier.cend()) {
+			return 0u;
+		}
+		return it->second + 1;
+	}
+
+	size_t distanceToViewport(
+		const DocType& doc,
+		const CommandLists& command_lists,
+		const Frontier& command_frontier,
+		const AgentType& agent,
+		const std::optional<std::pair<size_t, size_t>>& viewport
+	) const {
+		if (!viewport.has_value()) {
+			return 0u;
+		}
+
+		const auto& ops = command_lists.at(agent).at(nextSeq(command_frontier, agent)).ops;
+		const size_t op_i = partial_ops.count(agent) ? partial_ops.at(agent) : 0u;
+		if (op_i >= ops.size()) {
+			return 0u;
+		}
+
+		// the position an op lands at is close to its (left) parent
+		const auto anchor = std::visit([](const auto& op) { return anchorOf(op, 0); }, ops.at(op_i));
+
+		size_t idx {0};
+		if (anchor.has_value()) {
+			const auto idx_opt = doc.state.findIdx(anchor.value());
+			if (!idx_opt.has_value()) {
+				// parent not here yet, this agent is probably blocked anyway
+				return SIZE_MAX;
+			}
+			idx = idx_opt.value();
+		}
+
+		const auto& [first, second] = viewport.value();
+		if (idx < first) {
+			return first - idx;
+		} else if (idx >= second) {
+			return idx - second + 1;
+		} else {
+			return 0u;
+		}
+	}
+};
+
+} // namespace apply
+
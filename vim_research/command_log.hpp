@@ -0,0 +1,599 @@
+#pragma once
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+}
+
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <variant>
+#include <unordered_map>
+#include <filesystem>
+#include <type_traits>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+// append-only on disk log of commands, one file per agent
+//
+// file format (native byte order, we only ever read our own files):
+//   header:  "GCRDTLOG" u32 version u32 reserved
+//   records: u32 payload_size u32 crc32(payload) payload
+//
+// records are only ever appended. a torn or corrupt tail (crash mid write)
+// ends the log and is cut off the next time the file is opened for writing.
+namespace command_log {
+
+static constexpr std::array<char, 8> c_magic {'G', 'C', 'R', 'D', 'T', 'L', 'O', 'G'};
+static constexpr uint32_t c_version {1};
+static constexpr size_t c_header_size {c_magic.size() + sizeof(uint32_t) * 2};
+static constexpr size_t c_record_header_size {sizeof(uint32_t) * 2};
+
+// what every log starts with
+static std::array<uint8_t, c_header_size> header(void) {
+	std::array<uint8_t, c_header_size> bytes {};
+	std::memcpy(bytes.data(), c_magic.data(), c_magic.size());
+	std::memcpy(bytes.data() + c_magic.size(), &c_version, sizeof(c_version));
+	return bytes;
+}
+
+// crc32 (ieee, reflected), table built at compile time
+namespace detail {
+	static constexpr std::array<uint32_t, 256> crc32_table = [] {
+		std::array<uint32_t, 256> table {};
+		for (uint32_t i = 0; i < table.size(); i++) {
+			uint32_t c = i;
+			for (size_t k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[i] = c;
+		}
+		return table;
+	}();
+} // detail
+
+static uint32_t crc32(const uint8_t* data, size_t size) {
+	uint32_t c = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++) {
+		c = detail::crc32_table[(c ^ data[i]) & 0xFFu] ^ (c >> 8);
+	}
+	return c ^ 0xFFFFFFFFu;
+}
+
+// maps a whole log file read only, records are views into the mapping
+struct Reader {
+	const uint8_t* _data {nullptr};
+	size_t _size {0};
+
+	Reader(void) = default;
+	Reader(const Reader&) = delete;
+	Reader& operator=(const Reader&) = delete;
+
+	~Reader(void) {
+		close();
+	}
+
+	bool open(const std::string& path) {
+		close();
+
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+
+		struct stat st {};
+		if (::fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+
+		_size = static_cast<size_t>(st.st_size);
+		if (_size == 0) {
+			::close(fd);
+			return true; // empty, nothing to map
+		}
+
+		void* ptr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); // the mapping keeps the file alive
+		if (ptr == MAP_FAILED) {
+			_size = 0;
+			return false;
+		}
+
+		// we read it front to back exactly once
+		::madvise(ptr, _size, MADV_SEQUENTIAL);
+
+		_data = static_cast<const uint8_t*>(ptr);
+		return true;
+	}
+
+	void close(void) {
+		if (_data != nullptr) {
+			::munmap(const_cast<uint8_t*>(_data), _size);
+		}
+		_data = nullptr;
+		_size = 0;
+	}
+
+	[[nodiscard]] const uint8_t* data(void) const {
+		return _data;
+	}
+
+	[[nodiscard]] size_t size(void) const {
+		return _size;
+	}
+
+	[[nodiscard]] bool validHeader(void) const {
+		if (_size < c_header_size) {
+			return false;
+		}
+
+		if (std::memcmp(_data, c_magic.data(), c_magic.size()) != 0) {
+			return false;
+		}
+
+		uint32_t version {0};
+		std::memcpy(&version, _data + c_magic.size(), sizeof(version));
+		return version == c_version;
+	}
+
+	// a crash while the header of a new file was written, the start of ours but not all of it
+	[[nodiscard]] bool tornHeader(void) const {
+		return _size < c_header_size && std::memcmp(_data, header().data(), _size) == 0;
+	}
+
+	// calls fn(const uint8_t* payload, size_t size) for each intact record
+	// returns the offset after the last intact record (where the next append goes)
+	template<typename FN>
+	size_t forEach(FN&& fn) const {
+		if (!validHeader()) {
+			return 0;
+		}
+
+		size_t offset = c_header_size;
+		while (offset + c_record_header_size <= _size) {
+			uint32_t payload_size {0};
+			uint32_t payload_crc {0};
+			std::memcpy(&payload_size, _data + offset, sizeof(payload_size));
+			std::memcpy(&payload_crc, _data + offset + sizeof(payload_size), sizeof(payload_crc));
+
+			const size_t payload_offset = offset + c_record_header_size;
+			if (payload_size > _size - payload_offset) {
+				break; // torn
+			}
+
+			if (crc32(_data + payload_offset, payload_size) != payload_crc) {
+				break; // corrupt
+			}
+
+			fn(_data + payload_offset, size_t{payload_size});
+
+			offset = payload_offset + payload_size;
+		}
+
+		return offset;
+	}
+};
+
+// appends records, fsyncs in batches
+struct Writer {
+	int _fd {-1};
+
+	// sync after this many records, or if the last sync is this long ago
+	size_t _sync_every {256};
+	std::chrono::milliseconds _sync_interval {250};
+
+	size_t _unsynced {0};
+	std::chrono::steady_clock::time_point _last_sync {};
+
+	std::vector<uint8_t> _write_buffer; // reused
+
+	Writer(void) = default;
+	Writer(const Writer&) = delete;
+	Writer& operator=(const Writer&) = delete;
+
+	~Writer(void) {
+		close();
+	}
+
+	// opens or creates the log, drops a torn tail
+	bool open(const std::string& path) {
+		close();
+
+		size_t valid_end {0};
+		{
+			Reader reader;
+			if (reader.open(path)) {
+				valid_end = reader.forEach([](const uint8_t*, size_t) {});
+				if (valid_end == 0 && reader._size != 0 && !reader.tornHeader()) {
+					// not ours, dont touch
+					return false;
+				}
+			}
+		}
+
+		_fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+		if (_fd < 0) {
+			return false;
+		}
+
+		if (valid_end == 0) { // new file, or the header got torn
+			const auto header_bytes = header();
+			if (::ftruncate(_fd, 0) != 0 || !writeAll(header_bytes.data(), header_bytes.size())) {
+				close();
+				return false;
+			}
+			valid_end = header_bytes.size();
+		} else if (::ftruncate(_fd, static_cast<off_t>(valid_end)) != 0) {
+			close();
+			return false;
+		}
+
+		if (::lseek(_fd, static_cast<off_t>(valid_end), SEEK_SET) < 0) {
+			close();
+			return false;
+		}
+
+		_last_sync = std::chrono::steady_clock::now();
+
+		return sync();
+	}
+
+	void close(void) {
+		if (_fd >= 0) {
+			sync();
+			::close(_fd);
+		}
+		_fd = -1;
+	}
+
+	bool append(const uint8_t* data, size_t size) {
+		if (_fd < 0 || size > UINT32_MAX) {
+			return false;
+		}
+
+		// single write per record, so a crash tears at most the last one
+		const uint32_t payload_size = static_cast<uint32_t>(size);
+		const uint32_t payload_crc = crc32(data, size);
+
+		_write_buffer.resize(c_record_header_size + size);
+		std::memcpy(_write_buffer.data(), &payload_size, sizeof(payload_size));
+		std::memcpy(_write_buffer.data() + sizeof(payload_size), &payload_crc, sizeof(payload_crc));
+		std::memcpy(_write_buffer.data() + c_record_header_size, data, size);
+
+		if (!writeAll(_write_buffer.data(), _write_buffer.size())) {
+			return false;
+		}
+
+		_unsynced++;
+		return maybeSync();
+	}
+
+	// syncs if enough records piled up or enough time passed
+	// call this periodically too, so a quiet log still ends up on disk
+	bool maybeSync(void) {
+		if (_unsynced == 0) {
+			return true;
+		}
+
+		if (_unsynced >= _sync_every || std::chrono::steady_clock::now() - _last_sync >= _sync_interval) {
+			return sync();
+		}
+
+		return true;
+	}
+
+	bool sync(void) {
+		if (_fd < 0) {
+			return false;
+		}
+
+		_unsynced = 0;
+		_last_sync = std::chrono::steady_clock::now();
+		return ::fdatasync(_fd) == 0;
+	}
+
+	bool writeAll(const uint8_t* data, size_t size) {
+		while (size > 0) {
+			const ssize_t ret = ::write(_fd, data, size);
+			if (ret < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			data += ret;
+			size -= static_cast<size_t>(ret);
+		}
+		return true;
+	}
+};
+
+// binary encoding of a command
+//   agent, u64 seq, u32 op count, ops
+//   op: u8 type (0 add, 1 del)
+//     add: id, u8 parents (1 left, 2 right), [left id], [right id], value
+//     del: id
+//   id: agent, u64 seq
+// agent and value are copied raw, so they need to be trivially copyable
+namespace codec {
+
+	namespace detail {
+		template<typename T>
+		static void put(std::vector<uint8_t>& out, const T& value) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			const auto* ptr = reinterpret_cast<const uint8_t*>(&value);
+			out.insert(out.end(), ptr, ptr + sizeof(T));
+		}
+
+		template<typename T>
+		static bool get(const uint8_t*& data, const uint8_t* end, T& value) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			if (static_cast<size_t>(end - data) < sizeof(T)) {
+				return false;
+			}
+			std::memcpy(&value, data, sizeof(T));
+			data += sizeof(T);
+			return true;
+		}
+
+		template<typename ListID>
+		static void putID(std::vector<uint8_t>& out, const ListID& id) {
+			put(out, id.id);
+			put(out, id.seq);
+		}
+
+		template<typename ListID>
+		static bool getID(const uint8_t*& data, const uint8_t* end, ListID& id) {
+			return get(data, end, id.id) && get(data, end, id.seq);
+		}
+	} // detail
+
+	// the op variant has to be <add, del>
+	template<typename CommandType>
+	static void encode(std::vector<uint8_t>& out, const CommandType& command) {
+		using OpType = typename decltype(command.ops)::value_type;
+		static_assert(std::variant_size_v<OpType> == 2);
+
+		out.clear();
+		detail::put(out, command.agent);
+		detail::put(out, uint64_t{command.seq});
+		detail::put(out, static_cast<uint32_t>(command.ops.size()));
+
+		for (const auto& op : command.ops) {
+			detail::put(out, static_cast<uint8_t>(op.index()));
+			if (op.index() == 0) {
+				const auto& add_op = std::get<0>(op);
+				detail::putID(out, add_op.id);
+				detail::put(out, static_cast<uint8_t>(
+					(add_op.parent_left.has_value() ? 1u : 0u) |
+					(add_op.parent_right.has_value() ? 2u : 0u)
+				));
+				if (add_op.parent_left.has_value()) {
+					detail::putID(out, add_op.parent_left.value());
+				}
+				if (add_op.parent_right.has_value()) {
+					detail::putID(out, add_op.parent_right.value());
+				}
+				detail::put(out, add_op.value);
+			} else {
+				detail::putID(out, std::get<1>(op).id);
+			}
+		}
+	}
+
+	template<typename CommandType>
+	static std::optional<CommandType> decode(const uint8_t* data, size_t size) {
+		using OpType = typename decltype(CommandType::ops)::value_type;
+		using OpAdd = std::variant_alternative_t<0, OpType>;
+		using OpDel = std::variant_alternative_t<1, OpType>;
+
+		const uint8_t* end = data + size;
+
+		CommandType command {};
+		uint32_t op_count {0};
+		if (!detail::get(data, end, command.agent) || !detail::get(data, end, command.seq) || !detail::get(data, end, op_count)) {
+			return std::nullopt;
+		}
+
+		command.ops.reserve(op_count);
+		for (uint32_t i = 0; i < op_count; i++) {
+			uint8_t type {0};
+			if (!detail::get(data, end, type)) {
+				return std::nullopt;
+			}
+
+			if (type == 0) {
+				OpAdd add_op {};
+				uint8_t parents {0};
+				if (!detail::getID(data, end, add_op.id) || !detail::get(data, end, parents)) {
+					return std::nullopt;
+				}
+				if (parents & 1u) {
+					add_op.parent_left.emplace();
+					if (!detail::getID(data, end, add_op.parent_left.value())) {
+						return std::nullopt;
+					}
+				}
+				if (parents & 2u) {
+					add_op.parent_right.emplace();
+					if (!detail::getID(data, end, add_op.parent_right.value())) {
+						return std::nullopt;
+					}
+				}
+				if (!detail::get(data, end, add_op.value)) {
+					return std::nullopt;
+				}
+				command.ops.emplace_back(std::move(add_op));
+			} else if (type == 1) {
+				OpDel del_op {};
+				if (!detail::getID(data, end, del_op.id)) {
+					return std::nullopt;
+				}
+				command.ops.emplace_back(std::move(del_op));
+			} else {
+				return std::nullopt;
+			}
+		}
+
+		if (data != end) {
+			return std::nullopt;
+		}
+
+		return command;
+	}
+
+} // codec
+
+// lowercase hex of the raw bytes, for file names
+template<typename T>
+static std::string toHex(const T& value) {
+	static_assert(std::is_trivially_copyable_v<T>);
+	static constexpr std::string_view hex_chars {"0123456789abcdef"};
+
+	const auto* ptr = reinterpret_cast<const uint8_t*>(&value);
+	std::string str;
+	for (size_t i = 0; i < sizeof(T); i++) {
+		str += hex_chars[ptr[i] >> 4];
+		str += hex_chars[ptr[i] & 0x0f];
+	}
+
+	return str;
+}
+
+template<typename T>
+static std::optional<T> fromHex(std::string_view str) {
+	static_assert(std::is_trivially_copyable_v<T>);
+	if (str.size() != sizeof(T) * 2) {
+		return std::nullopt;
+	}
+
+	const auto nib = [](char c) -> int {
+		if (c >= '0' && c <= '9') {
+			return c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			return c - 'a' + 10;
+		} else {
+			return -1;
+		}
+	};
+
+	T value {};
+	auto* ptr = reinterpret_cast<uint8_t*>(&value);
+	for (size_t i = 0; i < sizeof(T); i++) {
+		const int hi = nib(str[i*2]);
+		const int lo = nib(str[i*2+1]);
+		if (hi < 0 || lo < 0) {
+			return std::nullopt;
+		}
+		ptr[i] = static_cast<uint8_t>(hi << 4 | lo);
+	}
+
+	return value;
+}
+
+// a directory with one log per agent (<hex agent>.log)
+template<typename AgentType, typename CommandType>
+struct Store {
+	std::filesystem::path _dir;
+	std::unordered_map<AgentType, Writer> _writers;
+	std::vector<uint8_t> _encode_buffer; // reused
+
+	bool open(const std::filesystem::path& dir) {
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		if (ec) {
+			return false;
+		}
+		_dir = dir;
+		return true;
+	}
+
+	// appends to the agents log, commands need to be appended in seq order
+	bool append(const CommandType& command) {
+		auto it = _writers.find(command.agent);
+		if (it == _writers.end()) {
+			it = _writers.try_emplace(command.agent).first;
+			if (!it->second.open(pathFor(command.agent))) {
+				_writers.erase(it);
+				return false;
+			}
+		}
+
+		codec::encode(_encode_buffer, command);
+		return it->second.append(_encode_buffer.data(), _encode_buffer.size());
+	}
+
+	// flushes logs that have been quiet for a while, call periodically
+	void maybeSync(void) {
+		for (auto& [agent, writer] : _writers) {
+			writer.maybeSync();
+		}
+	}
+
+	void sync(void) {
+		for (auto& [agent, writer] : _writers) {
+			writer.sync();
+		}
+	}
+
+	// calls fn(CommandType&&) for every intact command of every agent, in seq order per agent
+	// returns number of commands read
+	template<typename FN>
+	size_t replay(FN&& fn) const {
+		size_t count {0};
+
+		std::error_code ec;
+		for (const auto& dir_entry : std::filesystem::directory_iterator(_dir, ec)) {
+			if (!dir_entry.is_regular_file() || dir_entry.path().extension() != ".log") {
+				continue;
+			}
+
+			const auto agent_opt = agentFromHex(dir_entry.path().stem().string());
+			if (!agent_opt.has_value()) {
+				continue;
+			}
+
+			Reader reader;
+			if (!reader.open(dir_entry.path().string())) {
+				continue;
+			}
+
+			bool bad {false};
+			reader.forEach([&](const uint8_t* data, size_t size) {
+				if (bad) {
+					return;
+				}
+
+				auto command_opt = codec::decode<CommandType>(data, size);
+				if (!command_opt.has_value() || command_opt.value().agent != agent_opt.value()) {
+					bad = true; // stop at the first record we cant make sense of
+					return;
+				}
+
+				fn(std::move(command_opt.value()));
+				count++;
+			});
+		}
+
+		return count;
+	}
+
+	std::filesystem::path pathFor(const AgentType& agent) const {
+		return _dir / (toHex(agent) + ".log");
+	}
+
+	static std::optional<AgentType> agentFromHex(std::string_view str) {
+		return fromHex<AgentType>(str);
+	}
+};
+
+} // namespace command_log
+
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <vector>
+#include <string>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// what an editor of a document has not seen yet, tracked on the main thread of the daemon (test2).
+//
+// the editor has the doc as of some view. every change published after it moves the dirty ranges to
+// the new view, and the ones the editor did not make get added. once it fetches, it gets the lines
+// around them, bottom up in its own line numbers, and is up to date again.
+namespace dirty_lines {
+
+// a part of the doc the editor has not seen yet, list idxs [first, end) in the view of the last change it got.
+// newlines is how many more '\n' the doc has in there than the editor, so its line numbers can be worked out
+struct DirtyRange {
+	size_t first {0};
+	size_t end {0};
+	int64_t newlines {0};
+};
+
+// sorted, and only ranges that touch get merged. edits far apart stay small
+using DirtyRanges = std::vector<DirtyRange>;
+
+// moves the ranges to the view published with the change located and adds the entries it changed, unless
+// the editor has them already. false if no one knows where the change went, the editor needs everything then
+template<typename Located>
+bool markDirty(DirtyRanges& dirty, const std::optional<std::vector<Located>>& change_located, bool editors_own) {
+	if (!change_located.has_value()) {
+		return false;
+	}
+	const auto& located = change_located.value();
+
+	// the added entries move everything after them. the ranges are sorted, so one pass for all
+	size_t added {0};
+	size_t located_i {0};
+	const auto move = [&](size_t idx) {
+		while (located_i < located.size() && located[located_i].idx < idx + added) {
+			added += located[located_i].added;
+			located_i++;
+		}
+		return idx + added;
+	};
+	for (auto& range : dirty) {
+		range.first = move(range.first);
+		range.end = move(range.end);
+	}
+
+	if (editors_own || located.empty()) {
+		return true;
+	}
+
+	DirtyRanges merged;
+	merged.reserve(dirty.size() + located.size());
+	const auto push = [&merged](const DirtyRange& range) {
+		if (!merged.empty() && range.first <= merged.back().end) {
+			merged.back().end = std::max(merged.back().end, range.end);
+			merged.back().newlines += range.newlines;
+		} else {
+			merged.push_back(range);
+		}
+	};
+
+	auto dirty_it = dirty.cbegin();
+	for (const auto& l : located) {
+		while (dirty_it != dirty.cend() && dirty_it->first <= l.idx) {
+			push(*dirty_it++);
+		}
+		push({l.idx, l.idx + 1, l.newlines});
+	}
+	while (dirty_it != dirty.cend()) {
+		push(*dirty_it++);
+	}
+
+	dirty = std::move(merged);
+	return true;
+}
+
+// dirty grown to whole lines of the doc, [first_line, end_line) and the entries [first, end) with them
+struct Span {
+	int64_t first_line {0};
+	int64_t end_line {0};
+	size_t first {0};
+	size_t end {0};
+	int64_t newlines {0};
+};
+
+// the lines of the doc the dirty ranges are in, sorted. nullopt if they are not in view
+template<typename View>
+std::optional<std::vector<Span>> dirtySpans(const View& view, const DirtyRanges& dirty) {
+	std::vector<Span> spans;
+
+	const int64_t doc_lines = static_cast<int64_t>(view.newlinesBefore(view.size())) + 1;
+	for (const auto& range : dirty) {
+		if (range.end > view.size()) {
+			return std::nullopt;
+		}
+
+		// grow to whole lines. the bounding '\n' did not change, so the editor has them too
+		Span span {static_cast<int64_t>(view.newlinesBefore(range.first)) + 1, doc_lines + 1, 0, view.size(), range.newlines};
+		span.first = view.lineStart(static_cast<size_t>(span.first_line));
+		for (size_t i = range.end; i < view.size(); i++) {
+			if (view[i].value == '\n') {
+				span.end = i + 1;
+				span.end_line = static_cast<int64_t>(view.newlinesBefore(i)) + 2;
+				break;
+			}
+		}
+
+		// a range ending in a '\n' takes the line after it, which can be the first of the next
+		if (!spans.empty() && span.first_line < spans.back().end_line) {
+			spans.back().end_line = std::max(spans.back().end_line, span.end_line);
+			spans.back().end = std::max(spans.back().end, span.end);
+			spans.back().newlines += span.newlines;
+		} else {
+			spans.push_back(span);
+		}
+	}
+
+	return spans;
+}
+
+// the lines an editor with line_count lines has to replace to catch up on dirty, as a list of
+// [first line, end line, [new lines]] like line_changes. nullopt if it does not add up
+template<typename View>
+std::optional<nlohmann::json> dirtyLines(const View& view, const DirtyRanges& dirty, int64_t line_count) {
+	if (dirty.empty()) {
+		return std::nullopt;
+	}
+
+	const auto spans = dirtySpans(view, dirty);
+	if (!spans.has_value()) {
+		return std::nullopt;
+	}
+
+	const int64_t doc_lines = static_cast<int64_t>(view.newlinesBefore(view.size())) + 1;
+	int64_t newlines {0};
+	for (const auto& span : spans.value()) {
+		newlines += span.newlines;
+	}
+	if (line_count != doc_lines - newlines) {
+		return std::nullopt; // the editor has something else
+	}
+
+	// bottom up, so the ones above are still at their old line numbers in the editor
+	auto j_changes = nlohmann::json::array();
+	int64_t newlines_above = newlines;
+	for (auto span_it = spans->crbegin(); span_it != spans->crend(); span_it++) {
+		newlines_above -= span_it->newlines;
+
+		const int64_t first_line = span_it->first_line - newlines_above;
+		const int64_t end_line = span_it->end_line - newlines_above - span_it->newlines;
+		if (end_line < first_line) {
+			return std::nullopt;
+		}
+
+		auto j_lines = nlohmann::json::array();
+		std::string line;
+		view.forEach(span_it->first, span_it->end, [&](size_t, const auto& entry) {
+			if (!entry.value.has_value()) {
+				return;
+			}
+			if (entry.value == '\n') {
+				j_lines.push_back(line);
+				line.clear();
+			} else {
+				line += entry.value.value();
+			}
+		});
+		if (span_it->end_line == doc_lines + 1) {
+			j_lines.push_back(line); // the last line, it has no '\n'
+		}
+
+		j_changes.push_back(nlohmann::json::array({first_line, end_line, j_lines}));
+	}
+
+	return j_changes;
+}
+
+// replaces the lines [first_line, end_line) (1 based) with replacement, every line followed by a '\n'.
+// what an editor sends, applied in order with mergeLines()
+struct LineChange {
+	uint64_t first_line {0};
+	uint64_t end_line {0};
+	std::string replacement;
+};
+
+// moves the line changes of an editor that did not get dirty yet to the lines of the view, so they
+// go on top of what it has not seen. false if one of them touches lines in dirty, those are not the
+// lines the editor saw
+template<typename View>
+bool rebaseLineChanges(const View& view, const DirtyRanges& dirty, std::vector<LineChange>& changes) {
+	const auto spans = dirtySpans(view, dirty);
+	if (!spans.has_value()) {
+		return false;
+	}
+
+	// the spans in the lines of the editor, they move with its changes
+	struct Moved {
+		int64_t first_line;
+		int64_t end_line;
+		int64_t newlines;
+	};
+	std::vector<Moved> moved;
+	moved.reserve(spans->size());
+	int64_t newlines_above {0};
+	for (const auto& span : spans.value()) {
+		const int64_t first_line = span.first_line - newlines_above;
+		const int64_t end_line = span.end_line - newlines_above - span.newlines;
+		if (end_line < first_line) {
+			return false;
+		}
+		moved.push_back({first_line, end_line, span.newlines});
+		newlines_above += span.newlines;
+	}
+
+	for (auto& change : changes) {
+		const int64_t first_line = static_cast<int64_t>(change.first_line);
+		const int64_t end_line = static_cast<int64_t>(change.end_line);
+		const int64_t added = static_cast<int64_t>(std::count(change.replacement.cbegin(), change.replacement.cend(), '\n')) - (end_line - first_line);
+
+		int64_t offset {0}; // doc lines - editor lines above the change
+		for (auto& m : moved) {
+			if (m.end_line <= first_line) {
+				offset += m.newlines;
+			} else if (m.first_line >= end_line) {
+				// below, it moves the same in the editor and the doc
+				m.first_line += added;
+				m.end_line += added;
+			} else {
+				return false;
+			}
+		}
+
+		change.first_line = static_cast<uint64_t>(first_line + offset);
+		change.end_line = static_cast<uint64_t>(end_line + offset);
+	}
+
+	return true;
+}
+
+} // namespace dirty_lines
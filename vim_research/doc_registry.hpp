@@ -0,0 +1,531 @@
+#pragma once
+
+#include "./gossip.hpp"
+#include "./apply_scheduler.hpp"
+#include "./command_log.hpp"
+#include "./doc_snapshot.hpp"
+#include "./work_pool.hpp"
+#include "./doc_view.hpp"
+#include "./epoch.hpp"
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+#include <iostream>
+
+// the documents a daemon hosts, all of them over the same transport (the doc id is in every packet)
+//
+// every document has a directory <dir>/<hex doc id>/ with the command logs of its agents and a snapshot.
+// documents without editors get unloaded to their snapshot, least recently used first, when too many
+// are loaded or they were idle for too long. they come back when an editor opens them or a packet for
+// them arrives. documents that were never opened here are not hosted, their packets get dropped.
+//
+// the crdt of a document is only touched on its worker of the pool (its shard), that includes reading
+// the snapshot and logs when it gets loaded and the last apply and snapshot when it gets unloaded.
+// remote commands of documents without editors get integrated there when they are staged. documents with editors only
+// change when the editors ask (their edits, and a slice of remote commands when they fetch), so what
+// an editor sees does not move under it. after each of those the worker publishes a view of the
+// document, that is what the main thread reads, while the workers go on.
+// every now and then the worker copies the crdt and any worker writes the snapshot from the copy.
+namespace doc_registry {
+
+static constexpr std::string_view c_snapshot_name {"doc.snapshot"};
+
+using View = doc_view::View<ListType>;
+
+// what a write on the worker did, published with the view after it
+struct Change {
+	uint64_t ticket {0}; // the write, see Registry::write()
+	uint64_t writer {0}; // who asked for it (an editor), 0 is no one
+	std::vector<ListType::ListID> ids; // entries that got added or deleted
+
+	// where the ids ended up in the view published with the change, sorted by idx.
+	// nullopt if that view was built from scratch, then no one knows what moved
+	using Located = View::Located;
+	std::optional<std::vector<Located>> located;
+
+	bool writers_own {false}; // the ids are edits of the writer, it has them already
+	bool failed {false}; // did not fit the doc, eg. lines the editor has but the doc does not
+	bool more_pending {false}; // a slice of remote commands that ran out of budget
+};
+
+// one hosted document, its gossip state, crdt and logs
+struct Document : gossip::State {
+	Doc doc;
+	apply::Scheduler<Doc, Agent, Command> apply_scheduler;
+	command_log::Store<Agent, Command> command_log_store;
+
+	// remote commands got staged (sync thread -> main), its editors should fetch
+	std::atomic_bool should_fetch {false};
+
+	// there are staged commands that are not applied yet
+	std::atomic_bool staged {false};
+
+	// just loaded, ask the peers what we missed (sync thread only)
+	bool should_announce {true};
+
+	// written with the registry mutex. workers leave documents with editors alone
+	std::atomic_size_t editors {0}; // never unloaded while it has some
+	std::chrono::steady_clock::time_point last_used {}; // guarded by the registry mutex
+
+	// guarded by the registry mutex. the sync thread leaves the document alone while its worker
+	// reads the snapshot and logs, or writes the last snapshot. wanted again calls off the unload
+	bool loading {true};
+	bool unloading {false};
+
+	std::atomic_bool integrate_queued {false};
+
+	// guarded by staging_mutex + command_lists_mutex
+	size_t ops_since_snapshot {0};
+	uint64_t snapshots_taken {0};
+
+	// guarded by snapshot_mutex, the file is only written with it
+	std::mutex snapshot_mutex;
+	uint64_t snapshot_written {0}; // a slow older copy does not replace a newer one
+	// the final snapshot is written, copies still in flight are older.
+	// written with all three locks, so any of them is enough to read it
+	bool unloaded {false};
+
+	// the last published view, readers pin an epoch of the registry before they load it
+	std::atomic<const View*> view {nullptr};
+	// guards changes, and that view and changes are published and taken together
+	std::mutex view_mutex;
+	std::vector<Change> changes; // since the main thread last took them
+
+	bool view_stale {true}; // the crdt changed without publishing (no editors), worker only
+	uint64_t tickets {0}; // writes posted, main thread only
+
+	Document(void) = default;
+	Document(const Document&) = delete;
+	Document& operator=(const Document&) = delete;
+
+	~Document(void) {
+		// no one reads the view of a document nobody holds anymore
+		delete view.load();
+	}
+};
+
+struct Registry {
+	std::filesystem::path _dir;
+	Agent agent {}; // the local agent, the same in every document
+
+	size_t max_loaded {64};
+	std::chrono::steady_clock::duration max_idle {std::chrono::minutes(10)};
+
+	// a slice on a worker, then the other documents of its shard get a turn
+	apply::Scheduler<Doc, Agent, Command>::Budget integrate_budget {
+		4096, // ops
+		std::chrono::milliseconds(8)
+	};
+	// keeps editors responsive, the rest gets applied on their next fetch
+	apply::Scheduler<Doc, Agent, Command>::Budget editor_budget {
+		1024, // ops
+		std::chrono::milliseconds(4)
+	};
+	size_t snapshot_every_ops {16*1024};
+
+	// the published views of every document, retired ones get freed once no reader has them
+	epoch::Domain views;
+
+	// a view got published for a document with editors, from its worker
+	std::function<void(void)> on_changes;
+
+	// guards loaded and known. the sync thread holds it while it touches documents,
+	// the main thread only to look them up, documents with editors stay put without it.
+	// the (un)loading itself runs on the workers, without it. taken before the locks of a document
+	std::mutex mutex;
+	// shared with the tasks of the workers, an unloaded one lives until they are done with it
+	std::unordered_map<DocID, std::shared_ptr<Document>> loaded;
+	std::unordered_set<DocID> known; // have a directory
+
+	// last, so it stops before the rest goes. start it before the first get(), the (un)loading
+	// posted to it takes mutex when it is done
+	work_pool::Pool workers;
+
+	bool open(const std::filesystem::path& dir) {
+		std::error_code ec;
+		std::filesystem::create_directories(dir, ec);
+		if (ec) {
+			return false;
+		}
+		_dir = dir;
+
+		for (const auto& dir_entry : std::filesystem::directory_iterator(_dir, ec)) {
+			if (!dir_entry.is_directory()) {
+				continue;
+			}
+
+			if (const auto doc_id = command_log::fromHex<DocID>(dir_entry.path().filename().string()); doc_id.has_value()) {
+				known.emplace(doc_id.value());
+			}
+		}
+
+		return !ec;
+	}
+
+	std::filesystem::path pathFor(const DocID& doc_id) const {
+		return _dir / command_log::toHex(doc_id);
+	}
+
+	// the document, loaded if needed. unknown ones only get created if create is set
+	// nullptr if there is none (or it failed to load). needs mutex
+	Document* get(const DocID& doc_id, bool create, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+		if (const auto it = loaded.find(doc_id); it != loaded.cend()) {
+			it->second->last_used = now;
+			it->second->unloading = false; // the worker keeps it
+			return it->second.get();
+		}
+
+		if (!create && !known.count(doc_id)) {
+			return nullptr;
+		}
+
+		// make room first, the new one has no editors yet and must not get picked
+		evict(now, 1);
+
+		auto document = _create(doc_id);
+		if (!document) {
+			return nullptr;
+		}
+		known.emplace(doc_id);
+
+		document->last_used = now;
+		Document* ptr = document.get();
+		loaded.emplace(doc_id, document);
+
+		// everything posted for it later runs after this
+		workers.post(std::hash<DocID>{}(doc_id), [this, document = std::move(document)]() {
+			_load(document);
+		});
+
+		return ptr;
+	}
+
+	// hands a packet to the gossip state of its document, called by the transport on the sync thread
+	void handlePkg(const uint8_t* data, size_t length, gossip::PeerID peer_id) {
+		const auto doc_id = gossip::pkg::peekDocID(data, length);
+		if (!doc_id.has_value()) {
+			std::cerr << "got too short pkg " << length << "\n";
+			return;
+		}
+
+		std::lock_guard lg{mutex};
+		Document* document = get(doc_id.value(), false);
+		if (document == nullptr) {
+			return; // not hosted here
+		}
+		if (document->loading) {
+			return; // it asks the peers for what it missed once it is loaded
+		}
+
+		gossip::handlePkg(*document, data, length, peer_id);
+	}
+
+	// unloads documents without editors, least recently used first, until at most max_loaded are left.
+	// also the ones idle for longer than max_idle. the unloading is posted to their workers, they stay
+	// in loaded until it is done. adding are about to be loaded and count towards max_loaded. needs mutex
+	void evict(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now(), size_t adding = 0) {
+		size_t staying = loaded.size() + adding;
+		std::vector<std::pair<std::chrono::steady_clock::time_point, DocID>> idle;
+		for (const auto& [doc_id, document] : loaded) {
+			if (document->unloading) {
+				staying--;
+			} else if (document->editors == 0) {
+				idle.emplace_back(document->last_used, doc_id);
+			}
+		}
+		std::sort(idle.begin(), idle.end());
+
+		for (const auto& [last_used, doc_id] : idle) {
+			if (staying <= max_loaded && now - last_used < max_idle) {
+				break; // the rest was used even more recently
+			}
+
+			const auto& document = loaded.at(doc_id);
+			document->unloading = true;
+			staying--;
+			workers.post(std::hash<DocID>{}(doc_id), [this, document]() {
+				_unloadTask(document);
+			});
+		}
+	}
+
+	// applies the staged remote commands of a document without editors on its worker
+	// call after staging, any thread
+	void integrate(const std::shared_ptr<Document>& document) {
+		if (document->integrate_queued.exchange(true)) {
+			return; // the queued one gets it too
+		}
+
+		workers.post(std::hash<DocID>{}(document->doc_id), [this, document]() {
+			_integrate(document);
+		});
+	}
+
+	// runs fn(document) on the worker of the document, after everything posted for it before, and
+	// publishes a view after it with the Change fn returned. returns the ticket of the write, the
+	// view has it once the write is in. for documents with editors, from the main thread
+	template<typename FN>
+	uint64_t write(const std::shared_ptr<Document>& document, uint64_t writer, FN&& fn) {
+		const uint64_t ticket = ++document->tickets;
+
+		workers.post(std::hash<DocID>{}(document->doc_id), [this, document, writer, ticket, fn = std::forward<FN>(fn)]() mutable {
+			Change change = fn(document);
+			change.ticket = ticket;
+			change.writer = writer;
+			_publish(*document, std::move(change));
+		});
+
+		return ticket;
+	}
+
+	// a slice of the staged commands of a document with editors, for the writer that fetches
+	uint64_t integrateFor(const std::shared_ptr<Document>& document, uint64_t writer, const std::optional<std::pair<size_t, size_t>>& viewport) {
+		return write(document, writer, [this, viewport](const std::shared_ptr<Document>& document) {
+			Change change;
+
+			std::scoped_lock sl {document->staging_mutex, document->command_lists_mutex};
+			document->staged = false;
+
+			auto apply_res = document->apply_scheduler.run(document->doc, document->command_lists, document->command_frontier, document->staging_frontier, editor_budget, viewport);
+			if (apply_res.agents_blocked != 0 && !apply_res.more_pending) {
+				// TODO: actually this can fail with missing parents of an agent we never heard about before
+				std::cout << "failed to apply ops of " << apply_res.agents_blocked << " agents, waiting for more\n";
+			}
+			if (apply_res.more_pending) {
+				document->staged = true;
+			}
+
+			_maybeSnapshot(document, apply_res.ops_applied);
+
+			change.ids = std::move(apply_res.applied_ids);
+			change.more_pending = apply_res.more_pending;
+			return change;
+		});
+	}
+
+	// an editor is gone, once its writes are in. the main thread does not touch document after this
+	void release(const std::shared_ptr<Document>& document) {
+		workers.post(std::hash<DocID>{}(document->doc_id), [this, document]() {
+			std::lock_guard lg{mutex};
+			document->last_used = std::chrono::steady_clock::now();
+			if (--document->editors == 0) {
+				// what the editors did not fetch yet
+				integrate(document);
+			}
+		});
+	}
+
+	// snapshots every document, editors or not. for shutting down, after the sync thread is gone
+	void unloadAll(void) {
+		workers.stop(); // whatever they still write is older
+
+		std::lock_guard lg{mutex};
+		for (const auto& [doc_id, document] : loaded) {
+			_unload(*document);
+		}
+		loaded.clear();
+	}
+
+	// an empty document with its log dir, _load() fills it. needs mutex
+	std::shared_ptr<Document> _create(const DocID& doc_id) {
+		auto document = std::make_shared<Document>();
+		document->doc_id = doc_id;
+		document->doc.local_agent = agent;
+
+		const auto doc_dir = pathFor(doc_id);
+		if (!document->command_log_store.open(doc_dir)) {
+			std::cerr << "failed to open command log dir " << doc_dir << "\n";
+			return nullptr;
+		}
+		document->command_log = &document->command_log_store;
+
+		return document;
+	}
+
+	// snapshot + logs, whatever is missing from the snapshot gets applied from the logs.
+	// on the worker of the document, no one else touches it until loading is cleared
+	void _load(const std::shared_ptr<Document>& document) {
+		const auto time_start = std::chrono::steady_clock::now();
+		const auto& doc_id = document->doc_id;
+
+		const bool from_snapshot = doc_snapshot::loadFile(document->doc, document->command_frontier, (pathFor(doc_id) / c_snapshot_name).string());
+
+		auto& ctx = *document;
+		const size_t command_count = ctx.command_log_store.replay([&ctx](Command&& command) {
+			// logs are in seq order, a gap means we lost the rest
+			const uint64_t expected_seq = ctx.staging_frontier.count(command.agent) ? ctx.staging_frontier.at(command.agent) + 1 : 0u;
+			if (command.seq != expected_seq) {
+				return;
+			}
+
+			ctx.staging_frontier[command.agent] = command.seq;
+			ctx.command_lists[command.agent].emplace(command.seq, std::move(command));
+		});
+
+		// no real budget, new local commands need the frontier of the local agent to be current
+		const auto apply_res = ctx.apply_scheduler.run(ctx.doc, ctx.command_lists, ctx.command_frontier, ctx.staging_frontier, {SIZE_MAX, std::chrono::hours(24)});
+		// the snapshot was that far behind, dont wait for another full round
+		ctx.ops_since_snapshot = apply_res.ops_applied;
+
+		std::cout
+			<< "loaded doc " << command_log::toHex(doc_id).substr(0, 8)
+			<< (from_snapshot ? " from snapshot" : "")
+			<< ", " << command_count << " commands (" << apply_res.ops_applied << " ops applied) in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - time_start).count() << "ms\n"
+		;
+
+		std::lock_guard lg{mutex};
+		document->loading = false;
+	}
+
+	// a slice of the staged commands, on the worker of the document
+	void _integrate(const std::shared_ptr<Document>& document) {
+		document->integrate_queued = false; // staged from now on needs another round
+
+		bool more_pending {false};
+		{
+			std::scoped_lock sl {document->staging_mutex, document->command_lists_mutex};
+			if (document->unloaded || document->editors != 0) {
+				return; // the editors fetch it themselves
+			}
+			document->staged = false;
+
+			const auto apply_res = document->apply_scheduler.run(document->doc, document->command_lists, document->command_frontier, document->staging_frontier, integrate_budget);
+			more_pending = apply_res.more_pending;
+			if (apply_res.changes) {
+				document->view_stale = true; // no one to publish for, the next editor gets a new one
+			}
+
+			_maybeSnapshot(document, apply_res.ops_applied);
+		}
+
+		if (more_pending) {
+			integrate(document); // to the back of the shard
+		}
+	}
+
+	// needs staging_mutex + command_lists_mutex, on the worker of the document
+	void _maybeSnapshot(const std::shared_ptr<Document>& document, size_t ops_applied) {
+		document->ops_since_snapshot += ops_applied;
+		if (document->ops_since_snapshot < snapshot_every_ops) {
+			return;
+		}
+		document->ops_since_snapshot = 0;
+
+		// copying is a lot cheaper than encoding and writing, anyone can do the rest
+		workers.spawn([this, document, number = ++document->snapshots_taken, doc = document->doc, command_frontier = document->command_frontier]() {
+			_saveSnapshot(*document, number, doc, command_frontier);
+		});
+	}
+
+	// after a write, on the worker of the document. the old view goes once no reader has it
+	void _publish(Document& document, Change&& change) {
+		const View* prev = document.view.load();
+		std::unique_ptr<View> next;
+		if (prev == nullptr || document.view_stale) {
+			next = View::build(document.doc.state);
+		} else {
+			const auto changed = View::findIdxs(document.doc.state, change.ids);
+			next = View::update(*prev, document.doc.state, changed);
+			change.located = View::locate(*prev, *next, changed);
+		}
+		next->ticket = change.ticket;
+		document.view_stale = false;
+
+		{
+			std::lock_guard lg{document.view_mutex};
+			document.view.store(next.release());
+			document.changes.push_back(std::move(change));
+		}
+
+		if (prev != nullptr) {
+			views.retire(prev);
+		}
+		views.collect();
+
+		if (on_changes) {
+			on_changes();
+		}
+	}
+
+	// from a copy, on any worker
+	void _saveSnapshot(Document& document, uint64_t number, const Doc& doc, const decltype(Document::command_frontier)& command_frontier) {
+		{ // the snapshot can not be ahead of the logs
+			std::lock_guard lg{document.command_lists_mutex};
+			document.command_log_store.sync();
+		}
+
+		std::lock_guard lg{document.snapshot_mutex};
+		if (document.unloaded || document.snapshot_written > number) {
+			return; // already has a newer one
+		}
+
+		if (!doc_snapshot::saveFile(doc, command_frontier, (pathFor(document.doc_id) / c_snapshot_name).string())) {
+			std::cerr << "failed to write snapshot of doc " << command_log::toHex(document.doc_id).substr(0, 8) << "\n";
+			return;
+		}
+		document.snapshot_written = number;
+	}
+
+	// posted by evict(), after everything posted for the document before
+	void _unloadTask(const std::shared_ptr<Document>& document) {
+		{
+			std::lock_guard lg{mutex};
+			if (!document->unloading || document->editors != 0) {
+				document->unloading = false;
+				return; // wanted again before its turn
+			}
+		}
+
+		const bool unloaded = _unload(*document);
+
+		std::lock_guard lg{mutex};
+		if (unloaded && document->unloading && document->editors == 0) {
+			loaded.erase(document->doc_id);
+		} else if (unloaded) {
+			// wanted again while the snapshot got written, it is all still there
+			std::scoped_lock sl {document->staging_mutex, document->command_lists_mutex, document->snapshot_mutex};
+			document->unloaded = false;
+		}
+		document->unloading = false;
+	}
+
+	// applies everything staged and writes the snapshot. no editors, on the worker of the document
+	// (or with the workers stopped)
+	bool _unload(Document& document) {
+		std::scoped_lock sl {document.staging_mutex, document.command_lists_mutex, document.snapshot_mutex};
+
+		if (document.apply_scheduler.run(document.doc, document.command_lists, document.command_frontier, document.staging_frontier, {SIZE_MAX, std::chrono::hours(24)}).changes) {
+			document.view_stale = true; // in case it is wanted again
+		}
+
+		// the snapshot can not be ahead of the logs
+		document.command_log_store.sync();
+
+		if (!doc_snapshot::saveFile(document.doc, document.command_frontier, (pathFor(document.doc_id) / c_snapshot_name).string())) {
+			std::cerr << "failed to write snapshot of doc " << command_log::toHex(document.doc_id).substr(0, 8) << ", keeping it loaded\n";
+			return false;
+		}
+
+		document.unloaded = true;
+
+		std::cout << "unloaded doc " << command_log::toHex(document.doc_id).substr(0, 8) << "\n";
+		return true;
+	}
+};
+
+} // namespace doc_registry
+
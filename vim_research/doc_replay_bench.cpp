@@ -0,0 +1,420 @@
+#include "./gossip.hpp"
+#include "./apply_scheduler.hpp"
+#include "./doc_snapshot.hpp"
+#include "./work_pool.hpp"
+#include "./doc_view.hpp"
+#include "./epoch.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include <iostream>
+
+// many documents catching up on their staged remote commands at once, like a daemon
+// hosting lots of them after coming back online. integrated the way doc_registry does it:
+// budgeted slices on the worker of the document, snapshot copies encoded by any worker.
+// run with different thread counts, the work is the same every time.
+// reader threads meanwhile read a screen of some document from the views published after every
+// slice, like the main thread answering fetches, to see how long reads take while writes happen.
+
+namespace bench {
+
+struct Config {
+	size_t docs {64};
+	size_t agents {4}; // per doc
+	size_t ops {4000}; // per doc
+	size_t command_ops {8}; // ops per command
+	double del {0.2}; // chance an edit is a delete
+	size_t budget {4096}; // ops per slice
+	size_t snapshot_every {16*1024}; // ops, 0 is never
+	size_t readers {1}; // threads reading views, 0 is no views
+	uint64_t seed {1337};
+};
+
+static bool parseConfig(std::string_view str, Config& config) {
+	while (!str.empty()) {
+		const auto kv = str.substr(0, str.find(','));
+		str.remove_prefix(std::min(str.size(), kv.size() + 1));
+
+		const auto eq_pos = kv.find('=');
+		if (eq_pos == kv.npos) {
+			return false;
+		}
+
+		const std::string key {kv.substr(0, eq_pos)};
+		const std::string value {kv.substr(eq_pos + 1)};
+
+		try {
+			size_t parsed {0};
+			if (key == "docs") {
+				config.docs = std::stoull(value, &parsed);
+			} else if (key == "agents") {
+				config.agents = std::stoull(value, &parsed);
+			} else if (key == "ops") {
+				config.ops = std::stoull(value, &parsed);
+			} else if (key == "command_ops") {
+				config.command_ops = std::stoull(value, &parsed);
+			} else if (key == "del") {
+				config.del = std::stod(value, &parsed);
+			} else if (key == "budget") {
+				config.budget = std::stoull(value, &parsed);
+			} else if (key == "snapshot_every") {
+				config.snapshot_every = std::stoull(value, &parsed);
+			} else if (key == "readers") {
+				config.readers = std::stoull(value, &parsed);
+			} else if (key == "seed") {
+				config.seed = std::stoull(value, &parsed);
+			} else {
+				return false;
+			}
+
+			if (parsed != value.size()) {
+				return false;
+			}
+		} catch (...) {
+			return false;
+		}
+	}
+
+	return config.docs != 0 && config.agents != 0 && config.command_ops != 0 && config.budget != 0;
+}
+
+using Scheduler = apply::Scheduler<Doc, Agent, Command>;
+using View = doc_view::View<ListType>;
+
+// what a document got from the network
+struct Trace {
+	Scheduler::CommandLists command_lists;
+	Scheduler::Frontier staging_frontier;
+	size_t op_count {0};
+	std::string text; // what it has to end up as
+};
+
+// agents taking turns editing one doc, in bursts like people do
+static Trace genTrace(const Config& config, size_t doc_i) {
+	std::minstd_rand rng(static_cast<uint32_t>(config.seed + doc_i));
+
+	Trace trace;
+	Doc doc;
+
+	std::vector<Agent> agents(config.agents);
+	std::vector<std::vector<Doc::Op>> pending(config.agents);
+	for (size_t i = 0; i < agents.size(); i++) {
+		agents[i][0] = static_cast<uint8_t>(i);
+		agents[i][1] = static_cast<uint8_t>(i >> 8);
+		agents[i][2] = static_cast<uint8_t>(doc_i);
+		agents[i][3] = static_cast<uint8_t>(doc_i >> 8);
+	}
+
+	const auto flush = [&](size_t agent_i) {
+		if (pending[agent_i].empty()) {
+			return;
+		}
+		const Agent& agent = agents[agent_i];
+		const uint64_t seq = trace.staging_frontier.count(agent) ? trace.staging_frontier.at(agent) + 1 : 0u;
+		trace.staging_frontier[agent] = seq;
+		trace.command_lists[agent].emplace(seq, Command{agent, seq, std::move(pending[agent_i])});
+		pending[agent_i].clear();
+	};
+
+	size_t agent_i {0};
+	size_t pos {0}; // list idx, edits stay close to the last one
+	while (trace.op_count < config.ops) {
+		if (rng() % 16 == 0) {
+			flush(agent_i);
+			agent_i = rng() % agents.size();
+			pos = doc.state.list.empty() ? 0u : rng() % doc.state.list.size();
+		}
+		doc.local_agent = agents[agent_i];
+
+		const auto& list = doc.state.list;
+		pos = std::min(pos, list.size());
+
+		std::vector<Doc::Op> ops;
+		if (!list.empty() && std::uniform_real_distribution<double>{}(rng) < config.del) {
+			const size_t first = std::min(pos, list.size() - 1);
+			const size_t end = std::min(first + 1 + rng() % 8, list.size());
+			ops = doc.delRange(list[first].id, end < list.size() ? std::make_optional(list[end].id) : std::nullopt);
+		} else {
+			static constexpr std::string_view c_words {"the quick brown fox jumps over the lazy dog\n"};
+			const size_t word_start = rng() % (c_words.size() - 8);
+			const auto text = c_words.substr(word_start, 1 + rng() % 8);
+			ops = doc.addText(
+				pos == 0 ? std::nullopt : std::make_optional(list[pos-1].id),
+				pos == list.size() ? std::nullopt : std::make_optional(list[pos].id),
+				text
+			);
+			pos += text.size();
+		}
+
+		trace.op_count += ops.size();
+		pending[agent_i].insert(pending[agent_i].end(), ops.begin(), ops.end());
+		if (pending[agent_i].size() >= config.command_ops) {
+			flush(agent_i);
+		}
+	}
+	for (size_t i = 0; i < agents.size(); i++) {
+		flush(i);
+	}
+
+	trace.text = doc.getText();
+	return trace;
+}
+
+struct Replica {
+	Doc doc;
+	Scheduler apply_scheduler;
+	Scheduler::CommandLists command_lists;
+	Scheduler::Frontier command_frontier;
+	Scheduler::Frontier staging_frontier;
+	size_t ops_since_snapshot {0};
+
+	std::atomic<const View*> view {nullptr};
+
+	~Replica(void) {
+		delete view.load();
+	}
+};
+
+struct Run {
+	const Config& config;
+	epoch::Domain views;
+	work_pool::Pool pool;
+	std::vector<std::unique_ptr<Replica>> replicas;
+
+	std::atomic_size_t ops_applied {0};
+	std::atomic_size_t slices {0};
+	std::atomic_size_t snapshots {0};
+	std::atomic_size_t snapshot_bytes {0};
+	std::atomic_size_t publishes {0};
+	std::atomic_uint64_t publish_ns {0};
+
+	Run(const Config& config_, size_t threads) : config(config_), pool(threads) {}
+
+	// like doc_registry::Registry::_integrate()
+	void integrate(size_t doc_i) {
+		auto& replica = *replicas[doc_i];
+
+		const auto apply_res = replica.apply_scheduler.run(replica.doc, replica.command_lists, replica.command_frontier, replica.staging_frontier, {config.budget, std::chrono::hours(1)});
+		ops_applied += apply_res.ops_applied;
+		slices++;
+
+		if (config.readers != 0 && apply_res.changes) {
+			publish(replica, apply_res.applied_ids);
+		}
+
+		replica.ops_since_snapshot += apply_res.ops_applied;
+		if (config.snapshot_every != 0 && replica.ops_since_snapshot >= config.snapshot_every) {
+			replica.ops_since_snapshot = 0;
+			pool.spawn([this, doc = replica.doc, command_frontier = replica.command_frontier]() {
+				snapshot_bytes += doc_snapshot::encode(doc, command_frontier).size();
+				snapshots++;
+			});
+		}
+
+		if (apply_res.more_pending) {
+			pool.post(doc_i, [this, doc_i]() { integrate(doc_i); });
+		}
+	}
+
+	// like doc_registry::Registry::_publish()
+	void publish(Replica& replica, const std::vector<ListType::ListID>& changed_ids) {
+		const auto time_start = std::chrono::steady_clock::now();
+
+		const View* prev = replica.view.load();
+		auto next = prev == nullptr ? View::build(replica.doc.state) : View::update(*prev, replica.doc.state, changed_ids);
+		replica.view.store(next.release());
+		if (prev != nullptr) {
+			views.retire(prev);
+		}
+		views.collect();
+
+		publish_ns += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - time_start).count());
+		publishes++;
+	}
+
+	// a screen of a random document, until done. read latencies in ns go into latencies
+	void read(size_t reader_i, const std::atomic_bool& done, std::vector<uint64_t>& latencies) {
+		auto& reader = views.reader();
+		std::minstd_rand rng(static_cast<uint32_t>(config.seed + reader_i));
+
+		size_t visible {0};
+		while (!done) {
+			const size_t doc_i = rng() % replicas.size();
+			const size_t first_line = 1 + rng() % 64;
+
+			const auto time_start = std::chrono::steady_clock::now();
+			{
+				epoch::Guard guard {views, reader};
+				if (const View* view = replicas[doc_i]->view.load(); view != nullptr) {
+					const size_t first = view->lineStart(first_line);
+					view->forEach(first, first + 40*80, [&visible](size_t, const auto& entry) {
+						visible += entry.value.has_value();
+					});
+				}
+			}
+			latencies.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - time_start).count()));
+
+			// editors poll, they dont spin
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		(void)visible;
+	}
+};
+
+// the value below which fraction of the sorted latencies are, in us
+static double percentileUS(const std::vector<uint64_t>& sorted, double fraction) {
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	const size_t idx = std::min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<double>(sorted.size())));
+	return static_cast<double>(sorted[idx]) / 1000.0;
+}
+
+static nlohmann::json run(const Config& config, const std::vector<Trace>& traces, size_t threads) {
+	Run r {config, threads};
+
+	size_t total_ops {0};
+	for (const auto& trace : traces) {
+		auto replica = std::make_unique<Replica>();
+		replica->command_lists = trace.command_lists;
+		replica->staging_frontier = trace.staging_frontier;
+		r.replicas.push_back(std::move(replica));
+		total_ops += trace.op_count;
+	}
+
+	std::atomic_bool readers_done {false};
+	std::vector<std::vector<uint64_t>> reader_latencies(config.readers);
+	std::vector<std::thread> readers;
+	for (size_t reader_i = 0; reader_i < config.readers; reader_i++) {
+		readers.emplace_back(&Run::read, &r, reader_i, std::cref(readers_done), std::ref(reader_latencies[reader_i]));
+	}
+
+	const auto time_start = std::chrono::steady_clock::now();
+
+	for (size_t doc_i = 0; doc_i < r.replicas.size(); doc_i++) {
+		r.pool.post(doc_i, [&r, doc_i]() { r.integrate(doc_i); });
+	}
+	r.pool.wait();
+
+	const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+
+	readers_done = true;
+	for (auto& reader : readers) {
+		reader.join();
+	}
+
+	std::vector<uint64_t> latencies;
+	for (const auto& reader_latency : reader_latencies) {
+		latencies.insert(latencies.end(), reader_latency.cbegin(), reader_latency.cend());
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	size_t converged {0};
+	for (size_t doc_i = 0; doc_i < traces.size(); doc_i++) {
+		const auto& replica = *r.replicas[doc_i];
+		// the last view has to be the doc too
+		if (replica.doc.getText() == traces[doc_i].text && (config.readers == 0 || replica.view.load()->getText() == traces[doc_i].text)) {
+			converged++;
+		}
+	}
+
+	return {
+		{"threads", r.pool.size()},
+		{"docs", traces.size()},
+		{"ops", total_ops},
+		{"ops_applied", r.ops_applied.load()},
+		{"converged", converged == traces.size()},
+		{"wall_ms", wall_s * 1000.0},
+		{"ops_per_s", static_cast<double>(r.ops_applied.load()) / wall_s},
+		{"slices", r.slices.load()},
+		{"snapshots", r.snapshots.load()},
+		{"snapshot_bytes", r.snapshot_bytes.load()},
+		{"stolen", r.pool.stolen.load()},
+		{"publishes", r.publishes.load()},
+		{"publish_ms", static_cast<double>(r.publish_ns.load()) / 1e6},
+		{"reads", latencies.size()},
+		{"read_us_p50", percentileUS(latencies, 0.5)},
+		{"read_us_p99", percentileUS(latencies, 0.99)},
+		{"read_us_max", latencies.empty() ? 0.0 : static_cast<double>(latencies.back()) / 1000.0},
+	};
+}
+
+} // namespace bench
+
+int main(int argc, char** argv) {
+	bench::Config config;
+	std::vector<size_t> thread_counts;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg {argv[i]};
+		if (arg == "--threads" && i + 1 < argc) {
+			std::string_view list {argv[++i]};
+			while (!list.empty()) {
+				const auto item = list.substr(0, list.find(','));
+				list.remove_prefix(std::min(list.size(), item.size() + 1));
+				thread_counts.push_back(std::stoull(std::string{item}));
+			}
+		} else if (!bench::parseConfig(arg, config)) {
+			std::cerr << "usage: " << argv[0] << " [--threads 1,2,4,8] [key=value,...]\n";
+			std::cerr << "  keys: docs agents ops command_ops del budget snapshot_every readers seed\n";
+			std::cerr << "  ops per doc, snapshot_every in ops (0 is never)\n";
+			std::cerr << "  results are printed as json to stdout\n";
+			return 1;
+		}
+	}
+	if (thread_counts.empty()) {
+		// doubling up to every core
+		const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t threads = 1; threads < cores; threads *= 2) {
+			thread_counts.push_back(threads);
+		}
+		thread_counts.push_back(cores);
+	}
+
+	std::cerr << "generating " << config.docs << " docs\n";
+	std::vector<bench::Trace> traces;
+	for (size_t doc_i = 0; doc_i < config.docs; doc_i++) {
+		traces.push_back(bench::genTrace(config, doc_i));
+	}
+
+	nlohmann::json j_results = nlohmann::json::array();
+	for (const size_t threads : thread_counts) {
+		if (threads == 0) {
+			continue;
+		}
+
+		auto j_res = bench::run(config, traces, threads);
+
+		// against the first run, which is 1 thread by default
+		const double base_ops_per_s = j_results.empty() ? j_res.at("ops_per_s").get<double>() : j_results.front().at("ops_per_s").get<double>();
+		j_res["speedup"] = j_res.at("ops_per_s").get<double>() / base_ops_per_s;
+
+		std::cerr
+			<< "threads:" << threads
+			<< " converged:" << j_res.at("converged")
+			<< " wall:" << j_res.at("wall_ms").get<double>() << "ms"
+			<< " ops/s:" << static_cast<uint64_t>(j_res.at("ops_per_s").get<double>())
+			<< " speedup:" << j_res.at("speedup").get<double>()
+			<< " stolen:" << j_res.at("stolen")
+			<< " read p99:" << j_res.at("read_us_p99").get<double>() << "us"
+			<< "\n"
+		;
+		j_results.push_back(j_res);
+	}
+
+	std::cout << j_results.dump(1, '\t') << "\n";
+
+	return 0;
+}
+
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "./command_log.hpp"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+#include <array>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+// the state of a (V0) document and the command frontier that got it there,
+// so an unloaded document comes back without applying every command again.
+// commands after the frontier are still in the command logs.
+//
+// file format (native byte order, like the logs):
+//   header:  "GCRDTSN0" u32 version u32 crc32(body)
+//   body:    u32 frontier count, frontier: agent, u64 seq
+//            u64 entry count, entries in list order
+//   entry:   id, u8 flags (1 left, 2 right, 4 value), [left id], [right id], [value]
+//   id:      agent, u64 seq
+namespace doc_snapshot {
+
+static constexpr std::array<char, 8> c_magic {'G', 'C', 'R', 'D', 'T', 'S', 'N', '0'};
+static constexpr uint32_t c_version {1};
+static constexpr size_t c_header_size {c_magic.size() + sizeof(uint32_t) * 2};
+
+static constexpr uint8_t c_flag_left {1u << 0};
+static constexpr uint8_t c_flag_right {1u << 1};
+static constexpr uint8_t c_flag_value {1u << 2};
+
+template<typename DocType, typename AgentType>
+[[nodiscard]] std::vector<uint8_t> encode(const DocType& doc, const std::unordered_map<AgentType, uint64_t>& command_frontier) {
+	using namespace command_log::codec::detail;
+
+	std::vector<uint8_t> out(c_header_size);
+
+	put(out, static_cast<uint32_t>(command_frontier.size()));
+	for (const auto& [agent, seq] : command_frontier) {
+		put(out, agent);
+		put(out, uint64_t{seq});
+	}
+
+	put(out, uint64_t{doc.state.list.size()});
+	for (const auto& entry : doc.state.list) {
+		putID(out, entry.id);
+		put(out, static_cast<uint8_t>(
+			(entry.parent_left.has_value() ? c_flag_left : 0u) |
+			(entry.parent_right.has_value() ? c_flag_right : 0u) |
+			(entry.value.has_value() ? c_flag_value : 0u)
+		));
+		if (entry.parent_left.has_value()) {
+			putID(out, entry.parent_left.value());
+		}
+		if (entry.parent_right.has_value()) {
+			putID(out, entry.parent_right.value());
+		}
+		if (entry.value.has_value()) {
+			put(out, entry.value.value());
+		}
+	}
+
+	const uint32_t body_crc = command_log::crc32(out.data() + c_header_size, out.size() - c_header_size);
+	std::memcpy(out.data(), c_magic.data(), c_magic.size());
+	std::memcpy(out.data() + c_magic.size(), &c_version, sizeof(c_version));
+	std::memcpy(out.data() + c_magic.size() + sizeof(c_version), &body_crc, sizeof(body_crc));
+
+	return out;
+}
+
+// replaces the state of doc, leaves doc alone if the snapshot is bad
+template<typename DocType, typename AgentType>
+[[nodiscard]] bool decode(const uint8_t* data, size_t size, DocType& doc, std::unordered_map<AgentType, uint64_t>& command_frontier) {
+	using namespace command_log::codec::detail;
+	using ListType = typename DocType::ListType;
+
+	if (size < c_header_size || std::memcmp(data, c_magic.data(), c_magic.size()) != 0) {
+		return false;
+	}
+
+	uint32_t version {0};
+	uint32_t body_crc {0};
+	std::memcpy(&version, data + c_magic.size(), sizeof(version));
+	std::memcpy(&body_crc, data + c_magic.size() + sizeof(version), sizeof(body_crc));
+	if (version != c_version || command_log::crc32(data + c_header_size, size - c_header_size) != body_crc) {
+		return false;
+	}
+
+	const uint8_t* end = data + size;
+	data += c_header_size;
+
+	std::unordered_map<AgentType, uint64_t> tmp_frontier;
+	uint32_t frontier_count {0};
+	if (!get(data, end, frontier_count)) {
+		return false;
+	}
+	for (uint32_t i = 0; i < frontier_count; i++) {
+		AgentType agent {};
+		uint64_t seq {0};
+		if (!get(data, end, agent) || !get(data, end, seq)) {
+			return false;
+		}
+		tmp_frontier[agent] = seq;
+	}
+
+	ListType tmp;
+	uint64_t entry_count {0};
+	if (!get(data, end, entry_count)) {
+		return false;
+	}
+	for (uint64_t i = 0; i < entry_count; i++) {
+		typename ListType::Entry entry {};
+		uint8_t flags {0};
+		if (!getID(data, end, entry.id) || !get(data, end, flags)) {
+			return false;
+		}
+		if (flags & c_flag_left) {
+			entry.parent_left.emplace();
+			if (!getID(data, end, entry.parent_left.value())) {
+				return false;
+			}
+		}
+		if (flags & c_flag_right) {
+			entry.parent_right.emplace();
+			if (!getID(data, end, entry.parent_right.value())) {
+				return false;
+			}
+		}
+		if (flags & c_flag_value) {
+			entry.value.emplace();
+			if (!get(data, end, entry.value.value())) {
+				return false;
+			}
+			tmp.doc_size++;
+		}
+
+		// only adds have seqs, so the newest entry of an agent is its last seen op
+		const auto seen_it = tmp.last_seen_seq.find(entry.id.id);
+		if (seen_it == tmp.last_seen_seq.end() || seen_it->second < entry.id.seq) {
+			tmp.last_seen_seq[entry.id.id] = entry.id.seq;
+		}
+
+		tmp.list.push_back(std::move(entry));
+	}
+
+	if (data != end) {
+		return false;
+	}
+
+	doc.state = std::move(tmp);
+	command_frontier = std::move(tmp_frontier);
+
+	return true;
+}
+
+// writes to a temporary file first, so an existing snapshot is replaced atomically
+template<typename DocType, typename AgentType>
+[[nodiscard]] bool saveFile(const DocType& doc, const std::unordered_map<AgentType, uint64_t>& command_frontier, const std::string& path) {
+	const auto data = encode(doc, command_frontier);
+
+	const std::string tmp_path = path + ".tmp";
+	const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+
+	size_t written {0};
+	while (written < data.size()) {
+		const ssize_t ret = ::write(fd, data.data() + written, data.size() - written);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			::close(fd);
+			return false;
+		}
+		written += static_cast<size_t>(ret);
+	}
+
+	const bool synced = ::fsync(fd) == 0;
+	::close(fd);
+
+	return synced && ::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+// false if there is none or it is bad, doc is only touched on success
+template<typename DocType, typename AgentType>
+[[nodiscard]] bool loadFile(DocType& doc, std::unordered_map<AgentType, uint64_t>& command_frontier, const std::string& path) {
+	command_log::Reader reader;
+	if (!reader.open(path) || reader.size() == 0) {
+		return false;
+	}
+
+	return decode(reader.data(), reader.size(), doc, command_frontier);
+}
+
+} // namespace doc_snapshot
+
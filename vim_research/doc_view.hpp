@@ -0,0 +1,278 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+// immutable copy of a (V0) list, for readers on other threads than the one integrating.
+//
+// the entries are split into chunks, a new view shares every chunk the changes did not touch
+// with the one before, so publishing after a few ops copies a few chunks and not the document.
+// entries never move relative to each other and are never removed (deletes leave tombstones),
+// so the old chunks are found again in the new list by walking it in order.
+namespace doc_view {
+
+// entries per chunk when (re)building
+static constexpr size_t c_chunk_size {512};
+
+template<typename ListType>
+struct View {
+	using Entry = typename ListType::Entry;
+	using ListID = typename ListType::ListID;
+
+	struct Chunk {
+		std::vector<Entry> entries;
+		size_t newlines {0};
+		size_t visible {0}; // not tombstones
+	};
+
+	std::vector<std::shared_ptr<const Chunk>> chunks;
+	std::vector<size_t> starts; // list idx of the first entry of every chunk, and the size at the end
+
+	// the last write that went into this view (see doc_registry)
+	uint64_t ticket {0};
+
+	// a changed entry of update(), where it is in the new view
+	struct Located {
+		size_t idx {0};
+		bool added {false}; // a new entry, the ones after it moved by one
+		int8_t newlines {0}; // +1 a '\n' came in, -1 one got deleted
+	};
+
+	[[nodiscard]] size_t size(void) const {
+		return starts.empty() ? 0u : starts.back();
+	}
+
+	[[nodiscard]] bool empty(void) const {
+		return size() == 0;
+	}
+
+	[[nodiscard]] size_t _chunkOf(size_t idx) const {
+		return static_cast<size_t>(std::upper_bound(starts.cbegin(), starts.cend(), idx) - starts.cbegin()) - 1;
+	}
+
+	[[nodiscard]] const Entry& operator[](size_t idx) const {
+		const size_t chunk_i = _chunkOf(idx);
+		return chunks[chunk_i]->entries[idx - starts[chunk_i]];
+	}
+
+	// calls fn(idx, entry) for the entries [first, end)
+	template<typename FN>
+	void forEach(size_t first, size_t end, FN&& fn) const {
+		end = std::min(end, size());
+		if (first >= end) {
+			return;
+		}
+
+		for (size_t chunk_i = _chunkOf(first); chunk_i < chunks.size() && starts[chunk_i] < end; chunk_i++) {
+			const auto& entries = chunks[chunk_i]->entries;
+			const size_t start = starts[chunk_i];
+			for (size_t i = std::max(first, start); i < end && i - start < entries.size(); i++) {
+				fn(i, entries[i - start]);
+			}
+		}
+	}
+
+	[[nodiscard]] std::optional<size_t> findIdx(const ListID& id) const {
+		for (size_t chunk_i = 0; chunk_i < chunks.size(); chunk_i++) {
+			const auto& entries = chunks[chunk_i]->entries;
+			for (size_t i = 0; i < entries.size(); i++) {
+				if (entries[i].id == id) {
+					return starts[chunk_i] + i;
+				}
+			}
+		}
+		return std::nullopt;
+	}
+
+	// '\n's in [0, idx), whole chunks are not looked at
+	[[nodiscard]] size_t newlinesBefore(size_t idx) const {
+		size_t count {0};
+		size_t chunk_i {0};
+		for (; chunk_i < chunks.size() && starts[chunk_i + 1] <= idx; chunk_i++) {
+			count += chunks[chunk_i]->newlines;
+		}
+		forEach(chunk_i < chunks.size() ? starts[chunk_i] : size(), idx, [&count](size_t, const Entry& entry) {
+			count += entry.value == '\n';
+		});
+		return count;
+	}
+
+	// list idx of the first entry of line (1 based), after the '\n' ending the line before.
+	// size() if the text has fewer lines
+	[[nodiscard]] size_t lineStart(size_t line) const {
+		if (line <= 1) {
+			return 0u;
+		}
+
+		size_t newlines_left = line - 1;
+		for (size_t chunk_i = 0; chunk_i < chunks.size(); chunk_i++) {
+			const auto& chunk = *chunks[chunk_i];
+			if (chunk.newlines < newlines_left) {
+				newlines_left -= chunk.newlines;
+				continue;
+			}
+
+			for (size_t i = 0; i < chunk.entries.size(); i++) {
+				if (chunk.entries[i].value == '\n' && --newlines_left == 0) {
+					return starts[chunk_i] + i + 1;
+				}
+			}
+		}
+		return size();
+	}
+
+	[[nodiscard]] std::string getText(void) const {
+		size_t visible {0};
+		for (const auto& chunk : chunks) {
+			visible += chunk->visible;
+		}
+
+		std::string text;
+		text.reserve(visible);
+		for (const auto& chunk : chunks) {
+			for (const auto& entry : chunk->entries) {
+				if (entry.value.has_value()) {
+					text += entry.value.value();
+				}
+			}
+		}
+		return text;
+	}
+
+	void _push(typename std::vector<Entry>::const_iterator begin, typename std::vector<Entry>::const_iterator end) {
+		while (begin != end) {
+			const auto chunk_end = end - begin > static_cast<std::ptrdiff_t>(c_chunk_size) ? begin + c_chunk_size : end;
+
+			auto chunk = std::make_shared<Chunk>();
+			chunk->entries.assign(begin, chunk_end);
+			for (const auto& entry : chunk->entries) {
+				chunk->newlines += entry.value == '\n';
+				chunk->visible += entry.value.has_value();
+			}
+
+			_pushShared(std::move(chunk));
+			begin = chunk_end;
+		}
+	}
+
+	void _pushShared(std::shared_ptr<const Chunk> chunk) {
+		if (starts.empty()) {
+			starts.push_back(0);
+		}
+		starts.push_back(starts.back() + chunk->entries.size());
+		chunks.push_back(std::move(chunk));
+	}
+
+	// everything copied
+	[[nodiscard]] static std::unique_ptr<View> build(const ListType& list) {
+		auto view = std::make_unique<View>();
+		view->_push(list.list.cbegin(), list.list.cend());
+		return view;
+	}
+
+	// list idxs of the entries with these ids, sorted. one pass over list
+	[[nodiscard]] static std::vector<size_t> findIdxs(const ListType& list, std::vector<ListID> ids) {
+		std::vector<size_t> idxs;
+		if (ids.empty()) {
+			return idxs;
+		}
+
+		std::sort(ids.begin(), ids.end());
+		for (size_t i = 0; i < list.list.size(); i++) {
+			if (std::binary_search(ids.cbegin(), ids.cend(), list.list[i].id)) {
+				idxs.push_back(i);
+			}
+		}
+		return idxs;
+	}
+
+	// list is prev plus the ops that added or deleted the entries with changed_ids (more ids are fine,
+	// missing ones are not). one pass over list to find them, the chunks without any are shared
+	[[nodiscard]] static std::unique_ptr<View> update(const View& prev, const ListType& list, std::vector<ListID> changed_ids) {
+		return update(prev, list, findIdxs(list, std::move(changed_ids)));
+	}
+
+	// same, with the list idxs of the changed entries (sorted) already at hand
+	[[nodiscard]] static std::unique_ptr<View> update(const View& prev, const ListType& list, const std::vector<size_t>& changed) {
+		auto view = std::make_unique<View>();
+		view->ticket = prev.ticket;
+
+		auto changed_it = changed.cbegin();
+
+		size_t i {0}; // in list
+		for (size_t chunk_i = 0; chunk_i < prev.chunks.size(); chunk_i++) {
+			const auto& chunk = prev.chunks[chunk_i];
+			while (changed_it != changed.cend() && *changed_it < i) {
+				changed_it++;
+			}
+
+			if (i + chunk->entries.size() <= list.list.size() && (changed_it == changed.cend() || *changed_it >= i + chunk->entries.size())) {
+				// nothing new in between and nothing deleted, the same entries
+				assert(chunk->entries.empty() || list.list[i].id == chunk->entries.front().id);
+				view->_pushShared(chunk);
+				i += chunk->entries.size();
+				continue;
+			}
+
+			// where the entries of the chunk ended up, new ones in between are skipped.
+			// small chunks take the next one with them, so they dont pile up
+			const size_t span_start = i;
+			for (size_t entries_left = chunk->entries.size(), k = 0;;) {
+				while (entries_left > 0) {
+					assert(i < list.list.size());
+					if (list.list[i].id == prev.chunks[chunk_i]->entries[k].id) {
+						entries_left--;
+						k++;
+					}
+					i++;
+				}
+
+				if (i - span_start >= c_chunk_size / 4 || chunk_i + 1 >= prev.chunks.size()) {
+					break;
+				}
+				chunk_i++;
+				entries_left = prev.chunks[chunk_i]->entries.size();
+				k = 0;
+			}
+
+			view->_push(list.list.cbegin() + span_start, list.list.cbegin() + i);
+		}
+
+		// appended after the last old entry
+		view->_push(list.list.cbegin() + i, list.list.cend());
+
+		assert(view->size() == list.list.size());
+		return view;
+	}
+
+	// what the changed entries of update() were in prev and are in next. next is prev plus the added ones,
+	// and they are all in changed, so everything between two of them is at a fixed offset in prev
+	[[nodiscard]] static std::vector<Located> locate(const View& prev, const View& next, const std::vector<size_t>& changed) {
+		std::vector<Located> located;
+		located.reserve(changed.size());
+
+		size_t added {0}; // before idx
+		for (const size_t idx : changed) {
+			const auto& entry = next[idx];
+			const size_t prev_idx = idx - added;
+			if (prev_idx < prev.size() && prev[prev_idx].id == entry.id) {
+				// deleted, or more ids than changes
+				const bool deleted_nl = prev[prev_idx].value == '\n' && entry.value != '\n';
+				located.push_back({idx, false, static_cast<int8_t>(deleted_nl ? -1 : 0)});
+			} else {
+				added++;
+				located.push_back({idx, true, static_cast<int8_t>(entry.value == '\n' ? 1 : 0)});
+			}
+		}
+
+		return located;
+	}
+};
+
+} // namespace doc_view
+
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+
+// epoch based reclamation, for data readers use without locks or reference counts.
+// a reader pins the current epoch while it looks at the data, a writer replaces it and
+// retires the old one. retired data gets freed once every reader that could still see it unpinned.
+namespace epoch {
+
+struct Domain {
+	// one per reading thread, lives as long as the domain
+	struct Reader {
+		std::atomic_uint64_t pinned {0}; // 0 is not reading
+	};
+
+	std::atomic_uint64_t _global {1};
+
+	// guards readers and retired
+	std::mutex _mutex;
+	std::deque<Reader> _readers; // stable addresses
+	std::vector<std::pair<uint64_t, std::function<void(void)>>> _retired; // epoch it was retired in, free
+
+	Domain(void) = default;
+	Domain(const Domain&) = delete;
+	Domain& operator=(const Domain&) = delete;
+
+	// no readers left, everything goes
+	~Domain(void) {
+		for (auto& [retired_epoch, free_fn] : _retired) {
+			free_fn();
+		}
+	}
+
+	Reader& reader(void) {
+		std::lock_guard lg{_mutex};
+		return _readers.emplace_back();
+	}
+
+	// ptr was replaced for new readers, frees it once the old ones are done. any thread
+	template<typename T>
+	void retire(const T* ptr) {
+		std::lock_guard lg{_mutex};
+		// readers that pinned this epoch or earlier can have it
+		_retired.emplace_back(_global.fetch_add(1), [ptr]() { delete ptr; });
+	}
+
+	// frees what no reader can see anymore, returns how many
+	size_t collect(void) {
+		std::vector<std::function<void(void)>> to_free;
+		{
+			std::lock_guard lg{_mutex};
+
+			uint64_t oldest_pinned {UINT64_MAX};
+			for (const auto& reader : _readers) {
+				const uint64_t pinned = reader.pinned.load();
+				if (pinned != 0 && pinned < oldest_pinned) {
+					oldest_pinned = pinned;
+				}
+			}
+
+			for (auto it = _retired.begin(); it != _retired.end();) {
+				if (it->first < oldest_pinned) {
+					to_free.push_back(std::move(it->second));
+					it = _retired.erase(it);
+				} else {
+					it++;
+				}
+			}
+		}
+
+		// not under the lock, freeing big views takes a moment
+		for (auto& free_fn : to_free) {
+			free_fn();
+		}
+		return to_free.size();
+	}
+};
+
+// pins the current epoch for as long as it lives, every pointer loaded meanwhile stays valid
+struct Guard {
+	Domain::Reader& _reader;
+
+	Guard(Domain& domain, Domain::Reader& reader) : _reader(reader) {
+		_reader.pinned.store(domain._global.load());
+	}
+	Guard(const Guard&) = delete;
+	Guard& operator=(const Guard&) = delete;
+
+	~Guard(void) {
+		_reader.pinned.store(0);
+	}
+};
+
+} // namespace epoch
+
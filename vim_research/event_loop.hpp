@@ -0,0 +1,115 @@
+#pragma once
+
+extern "C" {
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+}
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cerrno>
+
+// epoll based event loop (linux only), so nothing has to poll with fixed sleeps
+namespace event_loop {
+
+// wakes up a loop waiting on fd, from any thread. notifications coalesce
+struct Notifier {
+	int fd {-1};
+
+	Notifier(void) : fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+	Notifier(const Notifier&) = delete;
+	Notifier& operator=(const Notifier&) = delete;
+
+	~Notifier(void) {
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+
+	[[nodiscard]] bool valid(void) const {
+		return fd >= 0;
+	}
+
+	void notify(void) {
+		const uint64_t one {1};
+		// only fails if the counter is full, then a wakeup is pending anyway
+		[[maybe_unused]] const auto ret = ::write(fd, &one, sizeof(one));
+	}
+
+	// resets, true if there was a notification
+	bool drain(void) {
+		uint64_t count {0};
+		return ::read(fd, &count, sizeof(count)) == sizeof(count);
+	}
+};
+
+struct Loop {
+	// gets the epoll events of the fd
+	using Callback = std::function<void(uint32_t)>;
+
+	int epoll_fd {-1};
+	// shared, so a callback can remove itself
+	std::unordered_map<int, std::shared_ptr<Callback>> callbacks;
+
+	std::vector<epoll_event> _events = std::vector<epoll_event>(64);
+
+	Loop(void) : epoll_fd(::epoll_create1(EPOLL_CLOEXEC)) {}
+	Loop(const Loop&) = delete;
+	Loop& operator=(const Loop&) = delete;
+
+	~Loop(void) {
+		if (epoll_fd >= 0) {
+			::close(epoll_fd);
+		}
+	}
+
+	[[nodiscard]] bool valid(void) const {
+		return epoll_fd >= 0;
+	}
+
+	// level triggered
+	bool add(int fd, uint32_t events, Callback&& callback) {
+		epoll_event event {};
+		event.events = events;
+		event.data.fd = fd;
+		if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+			return false;
+		}
+
+		callbacks[fd] = std::make_shared<Callback>(std::move(callback));
+		return true;
+	}
+
+	// call before closing the fd
+	void remove(int fd) {
+		::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+		callbacks.erase(fd);
+	}
+
+	// waits up to timeout_ms (-1 is forever) and calls the callbacks of the ready fds
+	// returns the number of ready fds, -1 on error
+	int wait(int timeout_ms) {
+		int count = ::epoll_wait(epoll_fd, _events.data(), static_cast<int>(_events.size()), timeout_ms);
+		if (count < 0) {
+			return errno == EINTR ? 0 : -1;
+		}
+
+		for (int i = 0; i < count; i++) {
+			const auto it = callbacks.find(_events[i].data.fd);
+			if (it == callbacks.end()) {
+				continue; // removed by an earlier callback
+			}
+			const auto callback = it->second;
+			(*callback)(_events[i].events);
+		}
+
+		return count;
+	}
+};
+
+} // namespace event_loop
+
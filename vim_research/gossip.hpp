@@ -0,0 +1,722 @@
+#pragma once
+
+#include <green_crdt/v0/text_document.hpp>
+#include <nlohmann/json.hpp>
+
+#include "./command_log.hpp"
+
+#include <array>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <iterator>
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+#include <iostream>
+#include <cassert>
+
+// the gossip/request sync of commands between peers, independent of how the packets get there
+//
+// a peer owns its agents commands (command_lists), gossips the latest one to everyone
+// and asks random peers for commands it is missing.
+
+// tox group public key
+using Agent = std::array<uint8_t, 32>;
+
+// which document a packet is about, sha256 of its name
+using DocID = std::array<uint8_t, 32>;
+
+template<>
+struct std::hash<Agent> {
+	std::size_t operator()(Agent const& s) const noexcept {
+		static_assert(sizeof(size_t) == 8);
+		// TODO: maybe shuffle the indices a bit
+		return
+			(static_cast<size_t>(s[0]) << 8*0) |
+			(static_cast<size_t>(s[1]) << 8*1) |
+			(static_cast<size_t>(s[2]) << 8*2) |
+			(static_cast<size_t>(s[3]) << 8*3) |
+			(static_cast<size_t>(s[4]) << 8*4) |
+			(static_cast<size_t>(s[5]) << 8*5) |
+			(static_cast<size_t>(s[6]) << 8*6) |
+			(static_cast<size_t>(s[7]) << 8*7)
+		;
+	}
+};
+
+using Doc = GreenCRDT::V0::TextDocument<Agent>;
+using ListType = Doc::ListType;
+
+struct Command {
+	Agent agent;
+	uint64_t seq {0}; // independed of the ops inside, theoretically
+	//...
+	std::vector<Doc::Op> ops;
+};
+
+namespace std {
+	template<typename T>
+	static void to_json(nlohmann::json& nlohmann_json_j, const std::optional<T>& nlohmann_json_t) {
+		if (nlohmann_json_t.has_value()) {
+			nlohmann_json_j = nlohmann_json_t.value();
+		} else {
+			nlohmann_json_j = nullptr;
+		}
+	}
+
+	template<typename T>
+	static void from_json(const nlohmann::json& nlohmann_json_j, std::optional<T>& nlohmann_json_t) {
+		if (!nlohmann_json_j.is_null()) {
+			nlohmann_json_t = static_cast<T>(nlohmann_json_j);
+		} else {
+			nlohmann_json_t = std::nullopt;
+		}
+	}
+} // namespace std
+
+namespace GreenCRDT::V0 {
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ListType::ListID,
+	id,
+	seq
+)
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ListType::OpAdd,
+	id,
+	parent_left,
+	parent_right,
+	value
+)
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ListType::OpDel,
+	id
+)
+
+} // namespace GreenCRDT::V0
+
+// bc variant <.<
+namespace std {
+	static void to_json(nlohmann::json& nlohmann_json_j, const Doc::Op& nlohmann_json_t) {
+		if (std::holds_alternative<Doc::ListType::OpAdd>(nlohmann_json_t)) {
+			nlohmann_json_j["t"] = "add";
+			nlohmann_json_j["d"] = std::get<Doc::ListType::OpAdd>(nlohmann_json_t);
+		} else if (std::holds_alternative<Doc::ListType::OpDel>(nlohmann_json_t)) {
+			nlohmann_json_j["t"] = "del";
+			nlohmann_json_j["d"] = std::get<Doc::ListType::OpDel>(nlohmann_json_t);
+		} else {
+			assert(false && "missing op type");
+		}
+	}
+
+	static void from_json(const nlohmann::json& nlohmann_json_j, Doc::Op& nlohmann_json_t) {
+		if (nlohmann_json_j.is_null()) {
+			std::cerr << "got null j\n";
+			return;
+		}
+
+		if (nlohmann_json_j.at("t") == "add") {
+			nlohmann_json_t = static_cast<Doc::ListType::OpAdd>(nlohmann_json_j.at("d"));
+		} else if (nlohmann_json_j.at("t") == "del") {
+			nlohmann_json_t = static_cast<Doc::ListType::OpDel>(nlohmann_json_j.at("d"));
+		} else {
+			assert(false && "missing op type");
+		}
+	}
+} // namespace std
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Command,
+	agent,
+	seq,
+	ops
+)
+
+// visibility hack
+struct RequestCommand {
+	Agent agent;
+	uint64_t seq{0};
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(RequestCommand,
+	agent,
+	seq
+)
+
+// hash for unordered_set
+template<>
+struct std::hash<std::pair<uint32_t, Agent>> {
+	std::size_t operator()(std::pair<uint32_t, Agent> const& s) const noexcept {
+		return std::hash<uint32_t>{}(s.first) << 3 ^ std::hash<Agent>{}(s.second);
+	}
+};
+
+inline std::ostream& operator<<(std::ostream& out, const Agent& id) {
+	out << std::hex << static_cast<int>(id.front());
+
+	return out;
+}
+
+namespace gossip {
+
+namespace pkg {
+
+	enum PKGID : uint8_t {
+		FRONTIER = 32,
+		REQUEST_FRONTIER,
+		REQUEST_FRONTIERS,
+
+		COMMAND,
+		REQUEST_COMMAND,
+	};
+
+	// send the currently last known seq you have (excluding buffer)
+	struct Frontier {
+		Agent agent;
+		uint64_t seq{0};
+	};
+
+	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Frontier,
+		agent,
+		seq
+	)
+
+	// request the last known seq another peer has for agent
+	struct RequestFrontier {
+		Agent agent;
+	};
+
+	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(RequestFrontier,
+		agent
+	)
+
+	using Command = ::Command;
+
+	// request every command for agent after_seq - until_seq (inclusive)
+	//struct RequestCommands {
+		//Agent agent;
+		//uint64_t after_seq{0};
+		//uint64_t until_seq{0};
+	//};
+	using RequestCommand = ::RequestCommand;
+
+	// pkgid, the doc id and then the msgpack of p
+	template<typename T>
+	static std::vector<uint8_t> encode(PKGID pkg_id, const DocID& doc_id, const T& p) {
+		std::vector<uint8_t> data = nlohmann::json::to_msgpack(p);
+		// prepend pkgid and doc id
+		data.insert(data.begin(), doc_id.cbegin(), doc_id.cend());
+		data.emplace(data.begin(), static_cast<uint8_t>(pkg_id));
+		return data;
+	}
+
+	static constexpr size_t c_header_size {1 + std::tuple_size_v<DocID>};
+
+	// so a packet can be handed to the state of its document
+	static std::optional<DocID> peekDocID(const uint8_t* data, size_t length) {
+		if (length < c_header_size) {
+			return std::nullopt;
+		}
+
+		DocID doc_id;
+		std::copy(data + 1, data + c_header_size, doc_id.begin());
+		return doc_id;
+	}
+
+} // namespace pkg
+
+// transport specific id of a peer, only needs to be stable while the peer is connected
+using PeerID = uint32_t;
+
+// how packets get to the other peers (tox group, simulated network, ...)
+// incoming packets are handed to handlePkg() by the transport
+struct Transport {
+	virtual ~Transport(void) = default;
+
+	// to every peer (tox group custom packet)
+	virtual bool broadcast(const std::vector<uint8_t>& data) = 0;
+
+	// to a single peer (tox group custom private packet)
+	virtual bool sendTo(PeerID peer_id, const std::vector<uint8_t>& data) = 0;
+
+	[[nodiscard]] virtual bool connected(PeerID peer_id) = 0;
+};
+
+struct State {
+	// every packet carries it, packets for other documents get dropped
+	DocID doc_id {};
+
+	std::mutex command_lists_mutex; // for list and frontier!!
+	std::unordered_map<Agent, std::unordered_map<uint64_t, Command>> command_lists;
+	std::unordered_map<Agent, uint64_t> command_frontier; // last applied seq
+	// everything that ends up in command_lists (also guarded by command_lists_mutex)
+	// optional, without one nothing is persisted
+	command_log::Store<Agent, Command>* command_log {nullptr};
+
+	// contains remote changes we can apply in the main thread
+	std::mutex staging_mutex;
+	std::unordered_map<Agent, uint64_t> staging_frontier; // last seq we have in command_lists, via tox
+	// (can be lower then command_frontier for local agent
+
+	// TODO
+	std::mutex unknown_agents_mutex;
+	std::unordered_set<Agent> unknown_agents; // list of agents we read about but dont have in command/saging frontier
+
+	// contains remote changes with missing parent seq
+	// could merge into comamnd_lists
+	std::unordered_map<Agent, std::unordered_map<uint64_t, Command>> buffer;
+
+	std::atomic_bool should_gossip_local{false}; // local changes (set by main thread, reset by sync thread)
+	std::unordered_set<Agent> should_gossip_remote; // list of ids we have new seq for (only modified by sync thread)
+	std::unordered_map<Agent, uint64_t> heard_gossip; // seq frontiers we have heard about
+
+	// peer ids that requested the last known seq for agent
+	std::unordered_set<std::pair<PeerID, Agent>> requested_frontier;
+
+	// peer ids that requested every frontier we know (eg. they just joined)
+	std::unordered_set<PeerID> requested_frontiers;
+
+	// peer ids that requested a command
+	std::unordered_map<PeerID, RequestCommand> requested_commands;
+
+	std::unordered_set<PeerID> seen_peers;
+
+	// missing commands are (re)requested at most this often, ticks can be a lot more frequent
+	std::chrono::milliseconds request_interval {20};
+	std::chrono::steady_clock::time_point last_request {};
+
+	std::minstd_rand rng{1337};
+
+	bool verbose {true}; // log every packet
+};
+
+// turns local ops into commands and queues the newest for gossip, called by the main thread
+// returns the number of commands created
+inline size_t addLocalOps(State& ctx, const Agent& agent_local, const std::vector<Doc::Op>& ops) {
+	if (ops.empty()) {
+		return 0;
+	}
+
+	size_t command_count {0};
+	{
+		// TODO: make something less locky
+		std::lock_guard mg{ctx.command_lists_mutex};
+		//assert(ctx.command_lists.size() == ctx.command_frontier.size());
+
+		auto& local_command_list = ctx.command_lists[agent_local];
+
+		uint64_t seq {0};
+		if (ctx.command_frontier.count(agent_local)) { // get last own seq
+			seq = ctx.command_frontier[agent_local] + 1;
+		}
+
+		// 5 can be too much
+		// 3 seems save, but is slow
+		const size_t max_ops {4}; // limit ops per command so we can fit them into packets
+		size_t check_op_count {0};
+		for (size_t i = 0; i < ops.size(); seq++) {
+			// TODO: check
+			//size_t chunk_size = std::min(max_ops, ops.size()-i);
+			//std::vector<Doc::Op> tmp_ops {ops.cbegin()+i, ops.cbegin()+i+chunk_size};
+			std::vector<Doc::Op> tmp_ops;
+			for (auto it = ops.cbegin()+i; it != ops.cend() && tmp_ops.size() <= max_ops; it++) {
+				tmp_ops.push_back(*it);
+			}
+
+			assert(!tmp_ops.empty());
+
+			const auto& new_command = local_command_list.emplace(seq, Command{
+				agent_local,
+				seq,
+				tmp_ops
+			}).first->second;
+			ctx.command_frontier[agent_local] = seq;
+
+			if (ctx.command_log != nullptr && !ctx.command_log->append(new_command)) {
+				std::cerr << "failed to append local command to log\n";
+			}
+
+			i += tmp_ops.size();
+			check_op_count += tmp_ops.size();
+			command_count++;
+		}
+		assert(check_op_count == ops.size());
+	}
+	ctx.should_gossip_local.store(true);
+
+	return command_count;
+}
+
+// a packet from peer_id, called by the transport on the sync thread
+inline void handlePkg(State& ctx, const uint8_t* data, size_t length, PeerID peer_id) {
+	if (length < pkg::c_header_size + 1) {
+		std::cerr << "got too short pkg " << length << "\n";
+		return;
+	}
+
+	if (pkg::peekDocID(data, length) != ctx.doc_id) {
+		std::cerr << "got pkg for another doc\n";
+		return;
+	}
+
+	pkg::PKGID pkg_id = static_cast<pkg::PKGID>(data[0]);
+	const auto p_j = nlohmann::json::from_msgpack(data + pkg::c_header_size, data + length, true, false);
+	if (p_j.is_discarded()) {
+		std::cerr << "got invalid msgpack for " << pkg_id << "\n";
+		return;
+	}
+
+	// TODO: keep track of time/connected disconnected
+	ctx.seen_peers.emplace(peer_id);
+
+	if (ctx.verbose) {
+		std::cout << "pkg " << pkg_id << " j:" << p_j.dump() << "\n";
+	}
+
+	switch (pkg_id) {
+		case pkg::PKGID::FRONTIER: {
+			pkg::Frontier pkg = p_j;
+
+			if (!ctx.heard_gossip.count(pkg.agent) || ctx.heard_gossip[pkg.agent] < pkg.seq) {
+				ctx.heard_gossip[pkg.agent] = pkg.seq;
+				if (ctx.verbose) {
+					std::cout << "new seq " << pkg.seq << " from " << pkg.agent << "\n";
+				}
+			}
+			break;
+		}
+		case pkg::PKGID::REQUEST_FRONTIER: {
+			pkg::RequestFrontier pkg = p_j;
+			ctx.requested_frontier.emplace(peer_id, pkg.agent);
+			break;
+		}
+		case pkg::PKGID::REQUEST_FRONTIERS: {
+			ctx.requested_frontiers.emplace(peer_id);
+			break;
+		}
+		case pkg::PKGID::COMMAND: {
+			pkg::Command pkg = p_j;
+
+			// push to buffer, if not in buffer
+			if (!ctx.buffer[pkg.agent].count(pkg.seq)) {
+				{ // also check staging frontier, if its not a dup
+					std::lock_guard lg {ctx.staging_mutex};
+					if (ctx.staging_frontier.count(pkg.agent) && pkg.seq <= ctx.staging_frontier.at(pkg.agent)) {
+						break; // allready in staging or master
+					}
+				}
+				ctx.buffer[pkg.agent].emplace(pkg.seq, pkg);
+				if (ctx.verbose) {
+					std::cout << "pushed to buffer " << pkg.seq << " from " << pkg.agent << "\n";
+				}
+			}
+			// TODO: notify something?
+			break;
+		}
+		case pkg::PKGID::REQUEST_COMMAND: {
+			pkg::RequestCommand pkg = p_j;
+			// TODO: this can lead to double requests
+			// TODO: maybe settle for single seq requests for now?, since they are indivitual packets anyway
+			ctx.requested_commands[peer_id] = pkg;
+			break;
+		}
+		default:
+			std::cerr << "unknown pkg id " << pkg_id << "\n";
+			break;
+	}
+}
+
+// asks every peer for all frontiers they know, to catch up after joining
+inline bool requestFrontiers(State& ctx, Transport& transport) {
+	return transport.broadcast(pkg::encode(pkg::PKGID::REQUEST_FRONTIERS, ctx.doc_id, nlohmann::json::object()));
+}
+
+// one round of pumping, requesting, answering and gossiping. called by the sync thread
+// after packets arrived, on local changes and when timeUntilTick() runs out
+// returns true if new remote commands got staged
+inline bool tick(State& ctx, Transport& transport, const Agent& agent_local, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+	bool staged {false};
+	std::vector<std::pair<Agent, uint64_t>> missing_in_buffer;
+	{ // pump from buffer to staging
+		const size_t max_commands = 2;
+		size_t number_of_commands_done = 0;
+		std::vector<Agent> empty_buffers;
+		{
+			std::lock_guard lg_staging{ctx.staging_mutex};
+			for (auto& [agent, buffer] : ctx.buffer) {
+				if (buffer.empty()) {
+					empty_buffers.push_back(agent);
+					continue;
+				}
+				if (agent == agent_local) {
+					// skip ? self
+					continue;
+				}
+				if (number_of_commands_done >= max_commands) {
+					break;
+				}
+
+				// determain the seq we are looking for in buffer
+				uint64_t seq {0};
+				if (ctx.staging_frontier.count(agent)) {
+					seq = ctx.staging_frontier.at(agent) + 1;
+				}
+
+				if (!buffer.count(seq)) { // not in buffer, skip
+					// check if old in buffer
+					for (const auto& it : buffer) {
+						if (it.first < seq) {
+							assert(false && "buffer not clean !!");
+						}
+					}
+
+					//std::cout << "!!! buffer not empty but not next seq\n";
+					missing_in_buffer.push_back(std::make_pair(agent, seq));
+					continue;
+				}
+
+				std::vector<uint64_t> seq_to_remove;
+				{ // this can lead to dead locks, if other code does this wrong
+					std::lock_guard lg{ctx.command_lists_mutex};
+					for (; buffer.count(seq); seq++) {
+						ctx.command_lists[agent][seq] = buffer.at(seq);
+						if (ctx.command_log != nullptr && !ctx.command_log->append(buffer.at(seq))) {
+							std::cerr << "failed to append remote command to log\n";
+						}
+						ctx.staging_frontier[agent] = seq;
+						seq_to_remove.push_back(seq);
+
+						number_of_commands_done++;
+						if (number_of_commands_done >= max_commands) {
+							break;
+						}
+					}
+
+					//ctx.staging_frontier[agent] = seq;
+				}
+				ctx.should_gossip_remote.emplace(agent);
+				staged = true;
+
+				for (const auto key : seq_to_remove) {
+					buffer.erase(key);
+				}
+				if (buffer.empty()) {
+					empty_buffers.push_back(agent);
+				}
+			}
+
+			// we heard of newer seqs, but nothing is in flight for the agent (eg. the gossiped command got lost)
+			for (const auto& [agent, heard_seq] : ctx.heard_gossip) {
+				if (agent == agent_local) {
+					continue;
+				}
+
+				const auto buffer_it = ctx.buffer.find(agent);
+				if (buffer_it != ctx.buffer.cend() && !buffer_it->second.empty()) {
+					continue; // handled above
+				}
+
+				const uint64_t seq = ctx.staging_frontier.count(agent) ? ctx.staging_frontier.at(agent) + 1 : 0u;
+				if (seq <= heard_seq) {
+					missing_in_buffer.push_back(std::make_pair(agent, seq));
+				}
+			}
+		} // scope for staging lock
+		for (const auto& agent : empty_buffers) {
+			ctx.buffer.erase(agent);
+		}
+	}
+
+	if (!missing_in_buffer.empty() && now - ctx.last_request >= ctx.request_interval) { // request missing in buffer
+		ctx.last_request = now;
+		for (const auto& [agent, seq] : missing_in_buffer) {
+			if (ctx.seen_peers.empty()) {
+				break;
+			}
+
+			// ask random peer_id we have seen before
+			const PeerID peer_id = *std::next(ctx.seen_peers.cbegin(), ctx.rng() % ctx.seen_peers.size());
+			if (!transport.connected(peer_id)) {
+				// bad luck, skip
+				// TODO: do seen peers cleanup
+				continue;
+			}
+
+			// send request for command
+			if (!transport.sendTo(peer_id, pkg::encode(pkg::PKGID::REQUEST_COMMAND, ctx.doc_id, pkg::RequestCommand{agent, seq}))) {
+				std::cerr << "failed to send command request packet for " << std::dec << seq << " from " << agent << "\n";
+			} else if (ctx.verbose) {
+				std::cout << "sent command request packet for " << std::dec << seq << " from " << agent << " to " << std::dec << peer_id << "\n";
+			}
+		}
+	}
+
+	// request frontier (implicit list of agents)
+	// only every couple of second, can get large
+	// OR get back random agent and do it often
+
+	{ // handle requests
+		// TODO: this lock is trash
+		if (!ctx.requested_commands.empty()) {
+			std::lock_guard lg{ctx.command_lists_mutex};
+			for (const auto& [peer_id, request] : ctx.requested_commands) {
+				if (ctx.command_lists.count(request.agent) && ctx.command_lists.at(request.agent).count(request.seq)) {
+					const auto& command = ctx.command_lists.at(request.agent).at(request.seq);
+
+					// send command
+					if (!transport.sendTo(peer_id, pkg::encode(pkg::PKGID::COMMAND, ctx.doc_id, command))) {
+						std::cerr << "failed to send command packet\n";
+					} else if (ctx.verbose) {
+						std::cout << "sent requested command to " << peer_id << "\n";
+					}
+				}
+				// else, we dont care. maybe check staging too
+			}
+
+			// HACK: clear each tick
+			ctx.requested_commands.clear();
+			if (ctx.verbose) {
+				std::cout << "cleared requested commands\n";
+			}
+		}
+	}
+
+	if (!ctx.requested_frontiers.empty()) { // answer with everything we know, they request the commands themselves
+		std::vector<pkg::Frontier> frontiers;
+		{
+			std::scoped_lock sl {ctx.staging_mutex, ctx.command_lists_mutex};
+			if (ctx.command_frontier.count(agent_local)) {
+				frontiers.push_back({agent_local, ctx.command_frontier.at(agent_local)});
+			}
+			for (const auto& [agent, seq] : ctx.staging_frontier) {
+				if (agent != agent_local) {
+					frontiers.push_back({agent, seq});
+				}
+			}
+		}
+
+		for (const auto peer_id : ctx.requested_frontiers) {
+			for (const auto& f_pkg : frontiers) {
+				if (!transport.sendTo(peer_id, pkg::encode(pkg::PKGID::FRONTIER, ctx.doc_id, f_pkg))) {
+					std::cerr << "failed to send frontier packet\n";
+					break;
+				}
+			}
+		}
+		ctx.requested_frontiers.clear();
+	}
+
+	{ // gossip frontier
+		// for mutex locking simplicity this is an either-or
+		if (ctx.should_gossip_local.exchange(false)) {
+			pkg::Frontier f_pkg{
+				agent_local,
+				0u
+			};
+
+			pkg::Command c_pkg{
+				agent_local,
+				0u,
+				{}
+			};
+
+			{ // lock
+				std::lock_guard lg{ctx.command_lists_mutex};
+				assert(ctx.command_frontier.count(agent_local));
+
+				f_pkg.seq = ctx.command_frontier.at(agent_local);
+
+				c_pkg = ctx.command_lists[agent_local][f_pkg.seq];
+				assert(!c_pkg.ops.empty());
+			}
+
+			// gossip
+			if (!transport.broadcast(pkg::encode(pkg::PKGID::FRONTIER, ctx.doc_id, f_pkg))) {
+				std::cerr << "failed to send gossip packet of local agent\n";
+				// TODO: set should_gossip_local back to true?
+			} else if (ctx.verbose) {
+				std::cout << "sent gossip of local agent\n";
+			}
+
+			// command
+			if (!transport.broadcast(pkg::encode(pkg::PKGID::COMMAND, ctx.doc_id, c_pkg))) {
+				std::cerr << "failed to send command packet of local agent\n";
+			} else if (ctx.verbose) {
+				std::cout << "sent command of local agent\n";
+			}
+		} else if (!ctx.should_gossip_remote.empty()) {
+			// we got new remote staged, lets amp the traffic
+
+			// only do first
+			auto it = ctx.should_gossip_remote.cbegin();
+
+			pkg::Frontier f_pkg{
+				*it,
+				0u
+			};
+
+			{ // lock
+				std::lock_guard lg{ctx.staging_mutex};
+				assert(ctx.staging_frontier.count(*it));
+
+				f_pkg.seq = ctx.staging_frontier.at(*it);
+			}
+
+			if (!transport.broadcast(pkg::encode(pkg::PKGID::FRONTIER, ctx.doc_id, f_pkg))) {
+				std::cerr << "failed to send gossip packet\n";
+			} else if (ctx.verbose) {
+				std::cout << "sent gossip of remote agent\n";
+			}
+
+			ctx.should_gossip_remote.erase(it);
+		}
+	}
+
+	return staged;
+}
+
+// how long the sync thread can wait before tick() has something to do, nullopt if only packets or local changes can give it work
+inline std::optional<std::chrono::steady_clock::duration> timeUntilTick(State& ctx, const Agent& agent_local, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+	if (ctx.should_gossip_local || !ctx.should_gossip_remote.empty() || !ctx.requested_commands.empty() || !ctx.requested_frontiers.empty()) {
+		return std::chrono::steady_clock::duration::zero();
+	}
+
+	bool missing {false};
+	{
+		std::lock_guard lg{ctx.staging_mutex};
+		const auto next_seq = [&ctx](const Agent& agent) -> uint64_t {
+			const auto it = ctx.staging_frontier.find(agent);
+			return it == ctx.staging_frontier.cend() ? 0u : it->second + 1;
+		};
+
+		for (const auto& [agent, buffer] : ctx.buffer) {
+			if (agent == agent_local || buffer.empty()) {
+				continue;
+			}
+			if (buffer.count(next_seq(agent))) {
+				return std::chrono::steady_clock::duration::zero(); // can be pumped right away
+			}
+			missing = true;
+		}
+
+		for (const auto& [agent, heard_seq] : ctx.heard_gossip) {
+			if (agent != agent_local && next_seq(agent) <= heard_seq) {
+				missing = true;
+			}
+		}
+	}
+
+	if (!missing) {
+		return std::nullopt;
+	}
+
+	const auto next_request = ctx.last_request + ctx.request_interval;
+	return next_request > now ? next_request - now : std::chrono::steady_clock::duration::zero();
+}
+
+} // namespace gossip
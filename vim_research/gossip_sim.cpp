@@ -0,0 +1,416 @@
+#include "./gossip.hpp"
+#include "./apply_scheduler.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <memory>
+#include <vector>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include <iostream>
+#include <cassert>
+
+// runs the gossip sync of N peers over a simulated network in one process, in simulated time.
+// writers edit their doc at a fixed rate, after the last edit we wait until every peer applied everything.
+
+namespace sim {
+
+struct Config {
+	size_t peers {10};
+	size_t writers {4}; // the first n peers edit
+	size_t edits {100}; // per writer
+	uint64_t edit_interval {50}; // ms between edits of a writer
+	uint64_t tick {20}; // ms between gossip ticks (the tox thread sleeps 20ms)
+	uint64_t latency {50}; // ms one way
+	uint64_t jitter {10}; // ms, uniformly added to latency
+	double loss {0.0}; // chance a packet is dropped
+	double reorder {0.0}; // chance a packet is held back for another latency
+	uint64_t bandwidth {0}; // bytes/s upload per peer, 0 is unlimited
+	uint64_t timeout {600}; // s of simulated time we wait for convergence
+	uint64_t seed {1337};
+};
+
+static bool parseConfig(std::string_view str, Config& config) {
+	while (!str.empty()) {
+		const auto kv = str.substr(0, str.find(','));
+		str.remove_prefix(std::min(str.size(), kv.size() + 1));
+
+		const auto eq_pos = kv.find('=');
+		if (eq_pos == kv.npos) {
+			return false;
+		}
+
+		const std::string key {kv.substr(0, eq_pos)};
+		const std::string value {kv.substr(eq_pos + 1)};
+
+		try {
+			size_t parsed {0};
+			if (key == "peers") {
+				config.peers = std::stoull(value, &parsed);
+			} else if (key == "writers") {
+				config.writers = std::stoull(value, &parsed);
+			} else if (key == "edits") {
+				config.edits = std::stoull(value, &parsed);
+			} else if (key == "edit_interval") {
+				config.edit_interval = std::stoull(value, &parsed);
+			} else if (key == "tick") {
+				config.tick = std::stoull(value, &parsed);
+			} else if (key == "latency") {
+				config.latency = std::stoull(value, &parsed);
+			} else if (key == "jitter") {
+				config.jitter = std::stoull(value, &parsed);
+			} else if (key == "loss") {
+				config.loss = std::stod(value, &parsed);
+			} else if (key == "reorder") {
+				config.reorder = std::stod(value, &parsed);
+			} else if (key == "bandwidth") {
+				config.bandwidth = std::stoull(value, &parsed);
+			} else if (key == "timeout") {
+				config.timeout = std::stoull(value, &parsed);
+			} else if (key == "seed") {
+				config.seed = std::stoull(value, &parsed);
+			} else {
+				return false;
+			}
+
+			if (parsed != value.size()) {
+				return false;
+			}
+		} catch (...) {
+			return false;
+		}
+	}
+
+	return config.peers >= 2 && config.tick != 0 && config.loss < 1.0;
+}
+
+struct Network;
+
+// what a peer sees of the network, peer ids are indices into Network::peers
+struct PeerTransport : gossip::Transport {
+	Network* net {nullptr};
+	gossip::PeerID self {0};
+
+	bool broadcast(const std::vector<uint8_t>& data) override;
+	bool sendTo(gossip::PeerID peer_id, const std::vector<uint8_t>& data) override;
+	bool connected(gossip::PeerID) override { return true; }
+};
+
+struct Peer {
+	Agent agent {};
+	Doc doc;
+	gossip::State state;
+	apply::Scheduler<Doc, Agent, Command> apply_scheduler;
+	PeerTransport transport;
+
+	uint64_t link_free {0}; // us, upload is busy until
+	size_t edits_done {0};
+};
+
+struct Packet {
+	uint64_t arrival {0}; // us
+	uint64_t order {0}; // equal arrival keeps send order
+	gossip::PeerID from {0};
+	gossip::PeerID to {0};
+	std::vector<uint8_t> data;
+
+	bool operator>(const Packet& other) const {
+		return arrival != other.arrival ? arrival > other.arrival : order > other.order;
+	}
+};
+
+struct TypeStats {
+	uint64_t packets {0};
+	uint64_t bytes {0};
+};
+
+struct Network {
+	Config config;
+	std::mt19937_64 rng;
+
+	std::vector<std::unique_ptr<Peer>> peers;
+	std::priority_queue<Packet, std::vector<Packet>, std::greater<Packet>> in_flight;
+
+	uint64_t now {0}; // us
+	uint64_t order {0};
+
+	uint64_t packets_sent {0};
+	uint64_t packets_dropped {0};
+	uint64_t bytes_sent {0};
+	std::unordered_map<uint8_t, TypeStats> by_type;
+
+	void send(gossip::PeerID from, gossip::PeerID to, const std::vector<uint8_t>& data) {
+		assert(!data.empty());
+
+		packets_sent++;
+		bytes_sent += data.size();
+		auto& type_stats = by_type[data.front()];
+		type_stats.packets++;
+		type_stats.bytes += data.size();
+
+		// the packet occupies the senders upload, even if it gets lost later
+		uint64_t departure = now;
+		if (config.bandwidth != 0) {
+			auto& link_free = peers.at(from)->link_free;
+			departure = std::max(now, link_free) + data.size() * 1'000'000 / config.bandwidth;
+			link_free = departure;
+		}
+
+		std::uniform_real_distribution<double> chance {0.0, 1.0};
+		if (config.loss > 0.0 && chance(rng) < config.loss) {
+			packets_dropped++;
+			return;
+		}
+
+		uint64_t arrival = departure + config.latency * 1000 + rng() % (config.jitter * 1000 + 1);
+		if (config.reorder > 0.0 && chance(rng) < config.reorder) {
+			arrival += config.latency * 1000;
+		}
+
+		in_flight.push(Packet{arrival, order++, from, to, data});
+	}
+
+	void deliver(void) {
+		while (!in_flight.empty() && in_flight.top().arrival <= now) {
+			const Packet& packet = in_flight.top();
+			gossip::handlePkg(peers.at(packet.to)->state, packet.data.data(), packet.data.size(), packet.from);
+			in_flight.pop();
+		}
+	}
+};
+
+bool PeerTransport::broadcast(const std::vector<uint8_t>& data) {
+	for (gossip::PeerID i = 0; i < net->peers.size(); i++) {
+		if (i != self) {
+			net->send(self, i, data);
+		}
+	}
+	return true;
+}
+
+bool PeerTransport::sendTo(gossip::PeerID peer_id, const std::vector<uint8_t>& data) {
+	if (peer_id >= net->peers.size()) {
+		return false;
+	}
+	net->send(self, peer_id, data);
+	return true;
+}
+
+static Agent makeAgent(size_t n) {
+	Agent agent {};
+	// big endian, so the order of the agents is the order of n
+	agent[0] = n >> 24;
+	agent[1] = n >> 16;
+	agent[2] = n >> 8;
+	agent[3] = n;
+	return agent;
+}
+
+// a single char typed or deleted at a random position
+static void randomEdit(Peer& peer, std::mt19937_64& rng) {
+	std::string text = peer.doc.getText();
+	if (text.empty() || rng() % 4 != 0) {
+		text.insert(text.begin() + rng() % (text.size() + 1), static_cast<char>('a' + rng() % 26));
+	} else {
+		text.erase(text.begin() + rng() % text.size());
+	}
+
+	const auto ops = peer.doc.merge(text);
+	gossip::addLocalOps(peer.state, peer.agent, ops);
+}
+
+static nlohmann::json run(const Config& config) {
+	Network net;
+	net.config = config;
+	net.rng.seed(config.seed);
+
+	const size_t writers = std::min(config.writers, config.peers);
+
+	for (size_t i = 0; i < config.peers; i++) {
+		auto& peer = *net.peers.emplace_back(std::make_unique<Peer>());
+		peer.agent = makeAgent(i + 1);
+		peer.doc.local_agent = peer.agent;
+		peer.state.verbose = false;
+		peer.transport.net = &net;
+		peer.transport.self = i;
+	}
+
+	const uint64_t tick_us = config.tick * 1000;
+	const uint64_t edit_interval_us = config.edit_interval * 1000;
+	const uint64_t timeout_us = config.timeout * 1'000'000;
+
+	// writers are staggered over one interval
+	const auto next_edit = [&](size_t w) {
+		return w * edit_interval_us / std::max<size_t>(writers, 1) + net.peers[w]->edits_done * edit_interval_us;
+	};
+
+	// everything applied everywhere
+	const auto converged = [&]() {
+		for (size_t w = 0; w < writers; w++) {
+			const auto& writer = *net.peers[w];
+			if (!writer.state.command_frontier.count(writer.agent)) {
+				continue; // all edits were noops
+			}
+			const uint64_t last_seq = writer.state.command_frontier.at(writer.agent);
+
+			for (const auto& peer : net.peers) {
+				const auto it = peer->state.command_frontier.find(writer.agent);
+				if (it == peer->state.command_frontier.cend() || it->second != last_seq) {
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+
+	const auto wall_start = std::chrono::steady_clock::now();
+
+	uint64_t last_edit {0};
+	bool edits_done {writers == 0 || config.edits == 0};
+	bool is_converged {false};
+	for (net.now = 0; net.now <= last_edit + timeout_us; net.now += tick_us) {
+		net.deliver();
+
+		if (!edits_done) {
+			edits_done = true;
+			for (size_t w = 0; w < writers; w++) {
+				auto& writer = *net.peers[w];
+				while (writer.edits_done < config.edits && next_edit(w) <= net.now) {
+					randomEdit(writer, net.rng);
+					writer.edits_done++;
+					last_edit = net.now;
+				}
+				edits_done = edits_done && writer.edits_done == config.edits;
+			}
+		}
+
+		// sync thread
+		const std::chrono::steady_clock::time_point sim_now {std::chrono::microseconds(net.now)};
+		for (auto& peer : net.peers) {
+			gossip::tick(peer->state, peer->transport, peer->agent, sim_now);
+		}
+
+		// main thread, like a fetch_changes
+		for (auto& peer : net.peers) {
+			peer->apply_scheduler.run(peer->doc, peer->state.command_lists, peer->state.command_frontier, peer->state.staging_frontier, {1024, std::chrono::hours(1)});
+		}
+
+		if (edits_done && converged()) {
+			is_converged = true;
+			break;
+		}
+	}
+
+	const auto wall_time = std::chrono::steady_clock::now() - wall_start;
+
+	const std::string text = net.peers.front()->doc.getText();
+	bool text_equal {true};
+	for (const auto& peer : net.peers) {
+		text_equal = text_equal && peer->doc.getText() == text;
+	}
+
+	uint64_t commands {0};
+	for (size_t w = 0; w < writers; w++) {
+		commands += net.peers[w]->state.command_lists[net.peers[w]->agent].size();
+	}
+
+	nlohmann::json j_by_type = nlohmann::json::object();
+	for (const auto& [pkg_id, type_stats] : net.by_type) {
+		std::string name {"unknown"};
+		switch (pkg_id) {
+			case gossip::pkg::PKGID::FRONTIER: name = "frontier"; break;
+			case gossip::pkg::PKGID::REQUEST_FRONTIER: name = "request_frontier"; break;
+			case gossip::pkg::PKGID::REQUEST_FRONTIERS: name = "request_frontiers"; break;
+			case gossip::pkg::PKGID::COMMAND: name = "command"; break;
+			case gossip::pkg::PKGID::REQUEST_COMMAND: name = "request_command"; break;
+		}
+		j_by_type[name] = {
+			{"packets", type_stats.packets},
+			{"bytes", type_stats.bytes},
+		};
+	}
+
+	return {
+		{"config", {
+			{"peers", config.peers},
+			{"writers", writers},
+			{"edits", config.edits},
+			{"edit_interval_ms", config.edit_interval},
+			{"tick_ms", config.tick},
+			{"latency_ms", config.latency},
+			{"jitter_ms", config.jitter},
+			{"loss", config.loss},
+			{"reorder", config.reorder},
+			{"bandwidth", config.bandwidth},
+			{"seed", config.seed},
+		}},
+		{"converged", is_converged},
+		{"text_equal", text_equal},
+		{"text_size", text.size()},
+		{"commands", commands},
+		{"convergence_ms", is_converged ? (net.now - last_edit) / 1000 : 0},
+		{"sim_ms", net.now / 1000},
+		{"wall_ms", std::chrono::duration_cast<std::chrono::milliseconds>(wall_time).count()},
+		{"packets_sent", net.packets_sent},
+		{"packets_dropped", net.packets_dropped},
+		{"bytes_sent", net.bytes_sent},
+		{"bytes_per_peer", net.bytes_sent / config.peers},
+		{"by_type", j_by_type},
+	};
+}
+
+} // namespace sim
+
+int main(int argc, char** argv) {
+	sim::Config config;
+	std::vector<size_t> peer_counts;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg {argv[i]};
+		if (arg == "--peers" && i + 1 < argc) {
+			std::string_view list {argv[++i]};
+			while (!list.empty()) {
+				const auto item = list.substr(0, list.find(','));
+				list.remove_prefix(std::min(list.size(), item.size() + 1));
+				peer_counts.push_back(std::stoull(std::string{item}));
+			}
+		} else if (!sim::parseConfig(arg, config)) {
+			std::cerr << "usage: " << argv[0] << " [--peers 10,50,100] [key=value,...]\n";
+			std::cerr << "  keys: peers writers edits edit_interval tick latency jitter loss reorder bandwidth timeout seed\n";
+			std::cerr << "  times in ms (timeout in s), bandwidth in bytes/s per peer\n";
+			std::cerr << "  results are printed as json to stdout\n";
+			return 1;
+		}
+	}
+	if (peer_counts.empty()) {
+		peer_counts.push_back(config.peers);
+	}
+
+	nlohmann::json j_results = nlohmann::json::array();
+	for (const size_t peers : peer_counts) {
+		if (peers < 2) {
+			continue;
+		}
+
+		config.peers = peers;
+		const auto j_res = sim::run(config);
+		std::cerr
+			<< "peers:" << peers
+			<< " converged:" << j_res.at("converged")
+			<< " convergence:" << j_res.at("convergence_ms") << "ms"
+			<< " bytes:" << j_res.at("bytes_sent")
+			<< " (" << j_res.at("wall_ms") << "ms wall)\n"
+		;
+		j_results.push_back(j_res);
+	}
+
+	std::cout << j_results.dump(1, '\t') << "\n";
+
+	return 0;
+}
+
@@ -0,0 +1,186 @@
+#include "./gossip.hpp"
+#include "./lan_transport.hpp"
+#include "./apply_scheduler.hpp"
+#include "./event_loop.hpp"
+
+extern "C" {
+#include <zed_net.h>
+}
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include <iostream>
+
+// headless peer for the lan transport, makes random edits and syncs until everything is quiet.
+// start a couple on one box pointing at each other and compare the printed hashes, eg:
+//   vim_research_lan_peer 3001 localhost:3002 &
+//   vim_research_lan_peer 3002 localhost:3001 &
+
+static uint64_t fnv1a(std::string_view str) {
+	uint64_t hash {0xcbf29ce484222325};
+	for (const char c : str) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+int main(int argc, char** argv) {
+	uint16_t port {0};
+	size_t edits {100};
+	std::chrono::milliseconds edit_interval {10};
+	std::chrono::milliseconds linger {2000}; // quiet time before we call it done
+
+	lan::Transport transport;
+	std::vector<zed_net_address_t> initial_peers;
+
+	const auto usage = [&]() {
+		std::cerr << "usage: " << argv[0] << " <port> [--edits n] [--interval ms] [--linger ms] [host:port ...]\n";
+		return 1;
+	};
+
+	if (argc < 2) {
+		return usage();
+	}
+
+	try {
+		port = static_cast<uint16_t>(std::stoul(argv[1]));
+		for (int i = 2; i < argc; i++) {
+			const std::string_view arg {argv[i]};
+			if (arg == "--edits" && i + 1 < argc) {
+				edits = std::stoull(argv[++i]);
+			} else if (arg == "--interval" && i + 1 < argc) {
+				edit_interval = std::chrono::milliseconds(std::stoull(argv[++i]));
+			} else if (arg == "--linger" && i + 1 < argc) {
+				linger = std::chrono::milliseconds(std::stoull(argv[++i]));
+			} else {
+				zed_net_address_t address {};
+				if (!lan::parseAddress(arg, address)) {
+					return usage();
+				}
+				initial_peers.push_back(address);
+			}
+		}
+	} catch (...) {
+		return usage();
+	}
+
+	if (zed_net_init() != 0) {
+		std::cerr << "zed_net_init failed: " << zed_net_get_error() << "\n";
+		return 1;
+	}
+
+	if (!transport.open(port)) {
+		zed_net_shutdown();
+		return 1;
+	}
+	for (const auto& address : initial_peers) {
+		transport.addPeer(address);
+	}
+
+	std::random_device rd;
+	std::mt19937_64 rng {rd()};
+
+	Agent agent;
+	for (auto& byte : agent) {
+		byte = static_cast<uint8_t>(rng());
+	}
+
+	gossip::State state;
+	state.verbose = false;
+
+	Doc doc;
+	doc.local_agent = agent;
+
+	apply::Scheduler<Doc, Agent, Command> apply_scheduler;
+
+	using clock = std::chrono::steady_clock;
+	const auto time_start = clock::now();
+	auto last_announce = time_start - std::chrono::hours(1);
+	auto last_change = time_start;
+	auto next_edit = time_start;
+	size_t edits_done {0};
+	size_t packets {0};
+
+	event_loop::Loop loop;
+	if (!loop.valid()) {
+		std::cerr << "epoll_create1 failed\n";
+		transport.close();
+		zed_net_shutdown();
+		return 1;
+	}
+	loop.add(transport.socket.handle, EPOLLIN, [&](uint32_t) { packets += transport.poll(state); });
+
+	while (true) {
+		const auto now = clock::now();
+
+		// until everyone knows us, and to pick up peers that (re)joined
+		if (now - last_announce >= std::chrono::seconds(1)) {
+			gossip::requestFrontiers(state, transport);
+			last_announce = now;
+		}
+
+		if (edits_done < edits && now >= next_edit) {
+			std::string text = doc.getText();
+			if (text.empty() || rng() % 4 != 0) {
+				text.insert(text.begin() + rng() % (text.size() + 1), static_cast<char>('a' + rng() % 26));
+			} else {
+				text.erase(text.begin() + rng() % text.size());
+			}
+			gossip::addLocalOps(state, agent, doc.merge(text));
+
+			edits_done++;
+			next_edit += edit_interval;
+			last_change = now;
+		}
+
+		const bool staged = gossip::tick(state, transport, agent, now);
+
+		const auto apply_res = apply_scheduler.run(doc, state.command_lists, state.command_frontier, state.staging_frontier, {1024, std::chrono::milliseconds(4)});
+		if (staged || apply_res.ops_applied != 0 || !state.buffer.empty()) {
+			last_change = now;
+		}
+
+		if (edits_done == edits && now - last_change >= linger) {
+			break;
+		}
+
+		// sleep until the next thing we have to do, or a packet
+		clock::duration timeout = last_announce + std::chrono::seconds(1) - now;
+		if (edits_done < edits) {
+			timeout = std::min<clock::duration>(timeout, next_edit - now);
+		} else {
+			timeout = std::min<clock::duration>(timeout, last_change + linger - now);
+		}
+		if (const auto tick_in = gossip::timeUntilTick(state, agent, now); tick_in.has_value()) {
+			timeout = std::min<clock::duration>(timeout, tick_in.value());
+		}
+		if (apply_res.ops_applied != 0 || !state.buffer.empty()) {
+			timeout = clock::duration::zero(); // budget ran out, keep going
+		}
+		loop.wait(static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(std::max<clock::duration>(timeout, clock::duration::zero())).count()));
+	}
+
+	loop.remove(transport.socket.handle);
+
+	const std::string text = doc.getText();
+	std::cout
+		<< "done port:" << port
+		<< " agents:" << state.command_frontier.size()
+		<< " packets:" << packets
+		<< " size:" << text.size()
+		<< " hash:" << std::hex << fnv1a(text) << std::dec
+		<< " (" << std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - time_start - linger).count() << "ms)\n"
+	;
+
+	transport.close();
+	zed_net_shutdown();
+
+	return 0;
+}
+
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "./gossip.hpp"
+
+extern "C" {
+#include <zed_net.h>
+}
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include <iostream>
+
+// gossip directly between peers over udp, for a lan or localhost. no dht, no bootstrap.
+//
+// every packet is a single datagram. peers are the addresses we were told about
+// plus everyone who sent us something, the index is the peer id.
+namespace lan {
+
+// biggest udp payload, commands are limited to a few ops so they stay far below
+static constexpr size_t c_max_packet_size {65507};
+
+// "host:port"
+inline bool parseAddress(std::string_view str, zed_net_address_t& address) {
+	const auto colon_pos = str.rfind(':');
+	if (colon_pos == str.npos || colon_pos + 1 == str.size()) {
+		return false;
+	}
+
+	const std::string host {str.substr(0, colon_pos)};
+	const std::string port_str {str.substr(colon_pos + 1)};
+
+	try {
+		size_t parsed {0};
+		const unsigned long port = std::stoul(port_str, &parsed);
+		if (parsed != port_str.size() || port == 0 || port > UINT16_MAX) {
+			return false;
+		}
+
+		return zed_net_get_address(&address, host.c_str(), static_cast<unsigned short>(port)) == 0;
+	} catch (...) {
+		return false;
+	}
+}
+
+struct Transport : gossip::Transport {
+	zed_net_socket_t socket {};
+	bool is_open {false};
+
+	std::vector<zed_net_address_t> peers; // peer id is the index
+
+	std::vector<uint8_t> recv_buffer = std::vector<uint8_t>(c_max_packet_size);
+
+	Transport(void) = default;
+	Transport(const Transport&) = delete;
+	Transport& operator=(const Transport&) = delete;
+
+	~Transport(void) {
+		close();
+	}
+
+	// non blocking, port 0 picks a free one
+	bool open(uint16_t port) {
+		close();
+
+		if (zed_net_udp_socket_open(&socket, port, 1) != 0) {
+			std::cerr << "zed_net_udp_socket_open failed: " << zed_net_get_error() << "\n";
+			return false;
+		}
+
+		is_open = true;
+		return true;
+	}
+
+	void close(void) {
+		if (is_open) {
+			zed_net_socket_close(&socket);
+		}
+		is_open = false;
+	}
+
+	// returns the id of the peer, known or new
+	gossip::PeerID addPeer(const zed_net_address_t& address) {
+		for (size_t i = 0; i < peers.size(); i++) {
+			if (peers[i].host == address.host && peers[i].port == address.port) {
+				return static_cast<gossip::PeerID>(i);
+			}
+		}
+
+		peers.push_back(address);
+		return static_cast<gossip::PeerID>(peers.size() - 1);
+	}
+
+	bool broadcast(const std::vector<uint8_t>& data) override {
+		bool r {true};
+		for (gossip::PeerID i = 0; i < peers.size(); i++) {
+			r = sendTo(i, data) && r;
+		}
+		return r;
+	}
+
+	bool sendTo(gossip::PeerID peer_id, const std::vector<uint8_t>& data) override {
+		if (!is_open || peer_id >= peers.size() || data.size() > c_max_packet_size) {
+			return false;
+		}
+
+		return zed_net_udp_socket_send(&socket, peers[peer_id], data.data(), static_cast<int>(data.size())) == 0;
+	}
+
+	bool connected(gossip::PeerID peer_id) override {
+		return peer_id < peers.size();
+	}
+
+	// hands every pending packet to fn(data, length, peer_id), returns the number of packets
+	template<typename FN>
+	size_t poll(FN&& fn) {
+		if (!is_open) {
+			return 0;
+		}
+
+		size_t count {0};
+		while (true) {
+			zed_net_address_t sender {};
+			const int bytes_received = zed_net_udp_socket_receive(&socket, &sender, recv_buffer.data(), static_cast<int>(recv_buffer.size()));
+			if (bytes_received <= 0) {
+				break; // nothing left (or error, zed_net does not tell us)
+			}
+
+			fn(recv_buffer.data(), static_cast<size_t>(bytes_received), addPeer(sender));
+			count++;
+		}
+
+		return count;
+	}
+
+	// a single document, hands every pending packet to handlePkg
+	size_t poll(gossip::State& state) {
+		return poll([&state](const uint8_t* data, size_t length, gossip::PeerID peer_id) {
+			gossip::handlePkg(state, data, length, peer_id);
+		});
+	}
+};
+
+} // namespace lan
+
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <string_view>
+#include <optional>
+#include <algorithm>
+#include <cstddef>
+#include <cassert>
+
+// growable ring buffer for a stream of newline terminated messages, like the vim json channel
+// (vim adds a newline after every json message, and json itself never contains a raw one).
+// a read can stop in the middle of a message or contain several, so:
+//   reserve() -> receive into writeData()/writeSize() -> commit() -> nextMessage() until nullopt
+struct LineBuffer {
+	// power of 2, positions are monotonic and get masked on access
+	std::vector<char> _data;
+	size_t _read {0};
+	size_t _write {0};
+	size_t _scanned {0}; // everything before this was already searched for '\n'
+
+	size_t max_capacity;
+
+	explicit LineBuffer(size_t initial_capacity = 64*1024, size_t max_capacity_ = 256*1024*1024) : max_capacity(max_capacity_) {
+		size_t capacity {1};
+		while (capacity < initial_capacity) {
+			capacity *= 2;
+		}
+		_data.resize(capacity);
+	}
+
+	[[nodiscard]] size_t size(void) const {
+		return _write - _read;
+	}
+
+	[[nodiscard]] size_t capacity(void) const {
+		return _data.size();
+	}
+
+	[[nodiscard]] size_t _mask(size_t pos) const {
+		return pos & (_data.size() - 1);
+	}
+
+	// makes sure at least min_free bytes can be written in one go
+	// false if that would grow past max_capacity (a message that big is garbage)
+	bool reserve(size_t min_free) {
+		if (writeSize() >= min_free) {
+			return true;
+		}
+
+		size_t new_capacity = _data.size();
+		while (new_capacity - size() < min_free) {
+			new_capacity *= 2;
+		}
+
+		if (new_capacity == _data.size()) {
+			// enough room, just not in one piece. move the pending bytes to the front
+			_linearize();
+			return writeSize() >= min_free;
+		}
+
+		if (new_capacity > max_capacity) {
+			return false;
+		}
+
+		_linearize();
+		_data.resize(new_capacity);
+		return true;
+	}
+
+	// contiguous free space after the pending bytes
+	[[nodiscard]] char* writeData(void) {
+		return _data.data() + _mask(_write);
+	}
+
+	[[nodiscard]] size_t writeSize(void) const {
+		return std::min(_data.size() - _mask(_write), _data.size() - size());
+	}
+
+	// count bytes were written to writeData()
+	void commit(size_t count) {
+		assert(count <= writeSize());
+		_write += count;
+	}
+
+	// the next complete message, without the newline
+	// the view stays valid until the next call to reserve() or nextMessage()
+	std::optional<std::string_view> nextMessage(void) {
+		for (; _scanned < _write; _scanned++) {
+			if (_data[_mask(_scanned)] != '\n') {
+				continue;
+			}
+
+			const size_t length = _scanned - _read;
+			if (_mask(_read) + length > _data.size()) {
+				// wraps around, rare enough to just move it
+				_linearize();
+			}
+
+			const std::string_view message {_data.data() + _mask(_read), length};
+
+			_scanned++;
+			_read = _scanned;
+			if (_read == _write) {
+				// empty, start over so the next read gets the whole buffer in one piece
+				// (the bytes stay in place, so the view is still fine)
+				_read = _write = _scanned = 0;
+			}
+
+			return message;
+		}
+
+		return std::nullopt;
+	}
+
+	// moves the pending bytes to the start of the buffer
+	void _linearize(void) {
+		const size_t pending = size();
+		std::rotate(_data.begin(), _data.begin() + _mask(_read), _data.end());
+		_scanned -= _read;
+		_read = 0;
+		_write = pending;
+	}
+};
+
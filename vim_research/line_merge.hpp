@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstddef>
+
+// replaces the lines [first_line, end_line) (1 based, like vim) of doc with the lines in replacement,
+// each of them followed by a '\n'. only looks at the doc up to end_line and diffs just those lines,
+// instead of the whole text like merge() does.
+// returns the generated ops, nullopt if the range does not exist in the doc (editor and doc disagree)
+//
+// the text is treated as if it ended in a (virtual) '\n', so every line, including the last one,
+// has one. [first_line, end_line) is then just a range of chars, and so is replacement.
+template<typename Doc>
+std::optional<std::vector<typename Doc::Op>> mergeLines(Doc& doc, size_t first_line, size_t end_line, std::string_view replacement) {
+	if (first_line < 1 || end_line < first_line || (!replacement.empty() && replacement.back() != '\n')) {
+		return std::nullopt;
+	}
+
+	const auto& list = doc.state.list;
+
+	// to the start of first_line
+	size_t i {0};
+	size_t line {1};
+	std::optional<size_t> prev_nl_idx; // the '\n' ending the line before
+	for (; i < list.size() && line < first_line; i++) {
+		if (list[i].value == '\n') {
+			line++;
+			prev_nl_idx = i;
+		}
+	}
+
+	const auto add_at = [&](size_t idx, std::string_view text) {
+		return doc.addText(
+			idx == 0 ? std::nullopt : std::make_optional(list[idx-1].id),
+			idx == list.size() ? std::nullopt : std::make_optional(list[idx].id),
+			text
+		);
+	};
+
+	if (line < first_line) {
+		// the only range past the end is an append after the last line
+		if (line + 1 != first_line || end_line != first_line) {
+			return std::nullopt;
+		}
+		if (replacement.empty()) {
+			return std::vector<typename Doc::Op>{};
+		}
+
+		// the virtual '\n' becomes real, the last new one becomes virtual
+		std::string text {"\n"};
+		text += replacement.substr(0, replacement.size() - 1);
+		return add_at(list.size(), text);
+	}
+
+	// the chars of the old lines, with their list idx
+	std::string old_text;
+	std::vector<size_t> old_idxs;
+	for (; i < list.size() && line < end_line; i++) {
+		if (!list[i].value.has_value()) {
+			continue; // tombstone
+		}
+
+		old_text += list[i].value.value();
+		old_idxs.push_back(i);
+		if (list[i].value == '\n') {
+			line++;
+		}
+	}
+	const size_t end_idx = i;
+
+	if (line < end_line) {
+		// ran into the end of the text, only the last line can end there
+		if (line + 1 != end_line) {
+			return std::nullopt;
+		}
+
+		if (replacement.empty()) {
+			// deleting the last lines, the '\n' before them goes instead of the virtual one
+			if (prev_nl_idx.has_value()) {
+				return doc.delRange(list[prev_nl_idx.value()].id, std::nullopt);
+			} else if (!old_idxs.empty()) {
+				return doc.delRange(list[old_idxs.front()].id, std::nullopt);
+			}
+			return std::vector<typename Doc::Op>{}; // already empty
+		}
+
+		old_text += '\n'; // virtual
+		old_idxs.push_back(list.size());
+	}
+
+	// common suffix first, both end in '\n', so the virtual one never gets touched
+	size_t suffix {0};
+	while (
+		suffix < old_text.size() && suffix < replacement.size() &&
+		old_text[old_text.size() - 1 - suffix] == replacement[replacement.size() - 1 - suffix]
+	) {
+		suffix++;
+	}
+
+	size_t prefix {0};
+	while (
+		prefix < old_text.size() - suffix && prefix < replacement.size() - suffix &&
+		old_text[prefix] == replacement[prefix]
+	) {
+		prefix++;
+	}
+
+	std::vector<typename Doc::Op> ops;
+
+	if (prefix < old_text.size() - suffix) {
+		const size_t last_del_idx = old_idxs[old_text.size() - suffix - 1];
+		ops = doc.delRange(
+			list[old_idxs[prefix]].id,
+			last_del_idx + 1 < list.size() ? std::make_optional(list[last_del_idx + 1].id) : std::nullopt
+		);
+	}
+
+	if (prefix < replacement.size() - suffix) {
+		// deleted entries stay as tombstones, so the idxs are still good
+		const auto add_ops = add_at(
+			prefix < old_idxs.size() ? old_idxs[prefix] : end_idx,
+			replacement.substr(prefix, replacement.size() - suffix - prefix)
+		);
+		ops.insert(ops.end(), add_ops.begin(), add_ops.end());
+	}
+
+	return ops;
+}
+
@@ -1,5 +1,14 @@
-#include <green_crdt/v0/text_document.hpp>
-#include <nlohmann/json.hpp>
+#include "./gossip.hpp"
+#include "./lan_transport.hpp"
+#include "./event_loop.hpp"
+#include "./apply_scheduler.hpp"
+#include "./command_log.hpp"
+#include "./doc_registry.hpp"
+#include "./epoch.hpp"
+#include "./line_buffer.hpp"
+#include "./vim_message.hpp"
+#include "./line_merge.hpp"
+#include "./dirty_lines.hpp"
 
 extern "C" {
 #include <zed_net.h>
@@ -20,130 +29,12 @@ extern "C" {
 #include <chrono>
 #include <random>
 #include <utility>
+#include <algorithm>
 
 #include <iostream>
 #include <cassert>
 
-//struct ToxPubKey {
-	//std::array<uint8_t, 32> data;
-
-	//bool operator==(const ToxPubKey& other) const {
-		//return data == other.data;
-	//}
-
-	//bool operator<(const ToxPubKey& other) const {
-		//return data < other.data;
-	//}
-//};
-using ToxPubKey = std::array<uint8_t, 32>;
-
-template<>
-struct std::hash<ToxPubKey> {
-	std::size_t operator()(ToxPubKey const& s) const noexcept {
-		static_assert(sizeof(size_t) == 8);
-		// TODO: maybe shuffle the indices a bit
-		return
-			(static_cast<size_t>(s[0]) << 8*0) |
-			(static_cast<size_t>(s[1]) << 8*1) |
-			(static_cast<size_t>(s[2]) << 8*2) |
-			(static_cast<size_t>(s[3]) << 8*3) |
-			(static_cast<size_t>(s[4]) << 8*4) |
-			(static_cast<size_t>(s[5]) << 8*5) |
-			(static_cast<size_t>(s[6]) << 8*6) |
-			(static_cast<size_t>(s[7]) << 8*7)
-		;
-	}
-};
-
-// single letter agent, for testing only
-//using Agent = char;
-//using Agent = uint16_t; // tmp local port
-using Agent = ToxPubKey;
-using Doc = GreenCRDT::V0::TextDocument<Agent>;
-using ListType = Doc::ListType;
-
-struct Command {
-	Agent agent;
-	uint64_t seq {0}; // independed of the ops inside, theoretically
-	//...
-	std::vector<Doc::Op> ops;
-};
-
-namespace std {
-	template<typename T>
-	static void to_json(nlohmann::json& nlohmann_json_j, const std::optional<T>& nlohmann_json_t) {
-		if (nlohmann_json_t.has_value()) {
-			nlohmann_json_j = nlohmann_json_t.value();
-		} else {
-			nlohmann_json_j = nullptr;
-		}
-	}
-
-	template<typename T>
-	static void from_json(const nlohmann::json& nlohmann_json_j, std::optional<T>& nlohmann_json_t) {
-		if (!nlohmann_json_j.is_null()) {
-			nlohmann_json_t = static_cast<T>(nlohmann_json_j);
-		} else {
-			nlohmann_json_t = std::nullopt;
-		}
-	}
-} // namespace std
-
-namespace GreenCRDT::V0 {
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ListType::ListID,
-	id,
-	seq
-)
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ListType::OpAdd,
-	id,
-	parent_left,
-	parent_right,
-	value
-)
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ListType::OpDel,
-	id
-)
-
-} // namespace GreenCRDT::V0
-
-// bc variant <.<
-namespace std {
-	static void to_json(nlohmann::json& nlohmann_json_j, const Doc::Op& nlohmann_json_t) {
-		if (std::holds_alternative<Doc::ListType::OpAdd>(nlohmann_json_t)) {
-			nlohmann_json_j["t"] = "add";
-			nlohmann_json_j["d"] = std::get<Doc::ListType::OpAdd>(nlohmann_json_t);
-		} else if (std::holds_alternative<Doc::ListType::OpDel>(nlohmann_json_t)) {
-			nlohmann_json_j["t"] = "del";
-			nlohmann_json_j["d"] = std::get<Doc::ListType::OpDel>(nlohmann_json_t);
-		} else {
-			assert(false && "missing op type");
-		}
-	}
-
-	static void from_json(const nlohmann::json& nlohmann_json_j, Doc::Op& nlohmann_json_t) {
-		if (nlohmann_json_j.is_null()) {
-			std::cerr << "got null j\n";
-			return;
-		}
-
-		if (nlohmann_json_j.at("t") == "add") {
-			nlohmann_json_t = static_cast<Doc::ListType::OpAdd>(nlohmann_json_j.at("d"));
-		} else if (nlohmann_json_j.at("t") == "del") {
-			nlohmann_json_t = static_cast<Doc::ListType::OpDel>(nlohmann_json_j.at("d"));
-		} else {
-			assert(false && "missing op type");
-		}
-	}
-} // namespace std
-
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Command,
-	agent,
-	seq,
-	ops
-)
+using ToxPubKey = Agent;
 
 namespace vim {
 
@@ -173,6 +64,16 @@ static bool sendCommand(zed_net_socket_t* remote_socket, const std::string_view
 	return ret == 0;
 }
 
+// fetch right away (if the fetch timer allows it), instead of waiting for the next poll
+static bool sendFetchNow(zed_net_socket_t* remote_socket) {
+	return sendCommand(remote_socket, "ex", "if exists('b:channel') && exists('*GreenCRDTCheckTimeAndFetch') | call GreenCRDTCheckTimeAndFetch() | endif");
+}
+
+// line changes only make sense on top of what we already have
+static bool sendRequestFullBuffer(zed_net_socket_t* remote_socket) {
+	return sendCommand(remote_socket, "ex", "if exists('b:channel') && exists('*GreenCRDTSendFullBuffer') | call GreenCRDTSendFullBuffer() | endif");
+}
+
 static bool sendSetup(zed_net_socket_t* remote_socket) {
 	return sendCommand(remote_socket, "ex",
 
@@ -181,6 +82,76 @@ R"(
 let b:green_crdt_timer_can_send = v:true
 let b:green_crdt_timer_can_fetch = v:true
 let b:green_crdt_dirty = v:true
+let b:green_crdt_changes = []
+let b:green_crdt_checksum_time = reltime()
+)"
+
+// line changes, if the vim has listeners. otherwise the whole buffer is sent on every change
+// every entry is [first line, end line, new lines], the new lines replace [first, end) and
+// the entries get applied one after the other.
+// start, end and added are not in the old line numbers if a later change is below an earlier one,
+// so the changes are tracked as ranges [first, end) in the current line numbers and how many old
+// lines they replace. only touching ones get merged, so edits far apart stay small.
+// the ranges go out bottom up, so the ones above still have their old line numbers
+R"(
+function! GreenCRDTListener(bufnr, start, end, added, changes) abort
+	let l:ranges = []
+	for l:change in a:changes
+		let l:merged = [l:change.lnum, l:change.end, 0]
+		let l:covered = 0
+		let l:new_ranges = []
+		for l:range in l:ranges
+			if l:range[1] < l:change.lnum
+				call add(l:new_ranges, l:range)
+			elseif l:range[0] > l:change.end
+				call add(l:new_ranges, [l:range[0] + l:change.added, l:range[1] + l:change.added, l:range[2]])
+			else
+				let l:merged[0] = min([l:merged[0], l:range[0]])
+				let l:merged[1] = max([l:merged[1], l:range[1]])
+				let l:merged[2] += l:range[2]
+				let l:covered += l:range[1] - l:range[0]
+			endif
+		endfor
+		" the lines no range covered are still the old ones
+		let l:merged[2] += l:merged[1] - l:merged[0] - l:covered
+		let l:merged[1] += l:change.added
+		call add(l:new_ranges, l:merged)
+		let l:ranges = sort(l:new_ranges, {a, b -> a[0] - b[0]})
+	endfor
+
+	let l:shift = 0
+	let l:entries = []
+	for [l:first, l:end, l:old_count] in l:ranges
+		call insert(l:entries, [l:first - l:shift, l:first - l:shift + l:old_count, getbufline(a:bufnr, l:first, l:end - 1)])
+		let l:shift += l:end - l:first - l:old_count
+	endfor
+	call extend(getbufvar(a:bufnr, 'green_crdt_changes'), l:entries)
+endfunction
+)"
+
+R"(
+function! GreenCRDTSendFullBuffer() abort
+	if exists('b:green_crdt_listener')
+		" the full buffer has them
+		call listener_flush()
+		let b:green_crdt_changes = []
+	endif
+	call ch_sendexpr(b:channel, [{'cmd': 'full_buffer', 'lines': getbufline(bufnr(), 1, '$')}])
+endfunction
+)"
+
+R"(
+function! GreenCRDTSendChanges() abort
+	if exists('b:green_crdt_listener')
+		call listener_flush()
+		if ! empty(b:green_crdt_changes)
+			call ch_sendexpr(b:channel, [{'cmd': 'line_changes', 'changes': b:green_crdt_changes}])
+			let b:green_crdt_changes = []
+		endif
+	else
+		call GreenCRDTSendFullBuffer()
+	endif
+endfunction
 )"
 
 // send
@@ -196,7 +167,7 @@ R"(
 function! GreenCRDTCheckTimeAndSend() abort
 	if b:green_crdt_timer_can_send && b:green_crdt_dirty
 		let b:green_crdt_timer_can_send = v:false
-		call ch_sendexpr(b:channel, [{'cmd': 'full_buffer', 'lines': getbufline(bufnr(), 1, '$')}])
+		call GreenCRDTSendChanges()
 		let b:green_crdt_dirty = v:false
 		call timer_start(100, 'GreenCRDTSendTimerCallback')
 	endif
@@ -218,24 +189,82 @@ function! GreenCRDTCheckTimeAndFetch()
 	if b:green_crdt_timer_can_fetch
 		let b:green_crdt_timer_can_fetch = v:false
 
+		" the daemon applies remote changes in slices, if it has more it wants us back soon
+		let l:fetch_delay = 203
+
 		" dont update when inserting or visual (or atleast not in visual)
 		if mode() is# 'n'
-			let l:response = ch_evalexpr(b:channel, [{'cmd': 'fetch_changes'}])
+			let l:request = {'cmd': 'fetch_changes', 'viewport': [line('w0'), line('w$')], 'line_count': line('$')}
+
+			" the daemon has to know about our changes before we get its
+			if exists('b:green_crdt_listener') || b:green_crdt_dirty
+				call GreenCRDTSendChanges()
+				let b:green_crdt_dirty = v:false
+			endif
+
+			" now and then, so the daemon can tell if we drifted apart
+			if ! b:green_crdt_dirty && exists('*sha256') && reltimefloat(reltime(b:green_crdt_checksum_time)) >= 2.0
+				let l:request.checksum = sha256(join(getline(1, '$'), "\n"))
+				let b:green_crdt_checksum_time = reltime()
+			endif
+
+			if get(b:, 'green_crdt_fetch_lost', v:false)
+				let l:request.full_text = v:true
+			endif
+
+			let l:response = ch_evalexpr(b:channel, [l:request])
+			if type(l:response) isnot v:t_dict
+				" timed out, the changes in the answer are lost. get everything next time
+				let b:green_crdt_fetch_lost = v:true
+				let l:response = {'lines': [], 'more': v:true}
+			else
+				let b:green_crdt_fetch_lost = v:false
+			endif
+
+			if get(l:response, 'resync', v:false)
+				" it did, our buffer wins
+				call GreenCRDTSendFullBuffer()
+			endif
+
+			" only the changed lines, the new lines replace [first, end)
+			for [l:first, l:end, l:lines] in get(l:response, 'changes', [])
+				let l:common = min([l:end - l:first, len(l:lines)])
+				if l:common > 0
+					call setline(l:first, l:lines[: l:common - 1])
+				endif
+				if len(l:lines) > l:common
+					call append(l:first + l:common - 1, l:lines[l:common :])
+				elseif l:end - l:first > l:common
+					call deletebufline(bufnr(), l:first + l:common, l:end - 1)
+				endif
+			endfor
+
+			" or all of them
 			" TODO: dont use empty as an indicator
-			if ! empty(l:response)
-				for [line_number, line] in l:response
+			if ! empty(l:response.lines)
+				for [line_number, line] in l:response.lines
 					call setline(line_number, line)
 				endfor
 
 				let l:buffer_line_count = line('$')
-				let l:new_line_count = len(l:response)
+				let l:new_line_count = len(l:response.lines)
 				if l:buffer_line_count > new_line_count
 					call deletebufline(bufnr(), l:new_line_count+1, buffer_line_count)
 				endif
 			endif
+
+			if exists('b:green_crdt_listener')
+				" the daemon already has what we just set
+				call listener_flush()
+				let b:green_crdt_changes = []
+			endif
+
+			if l:response.more
+				let l:fetch_delay = 10
+			endif
 		endif
 
-		let b:green_crdt_fetch_timer = timer_start(203, 'GreenCRDTFetchTimerCallback')
+		let b:green_crdt_fetch_timer = timer_start(l:fetch_delay, 'GreenCRDTFetchTimerCallback')
 	endif
 endfunction
 )"
@@ -261,8 +290,16 @@ function! GreenCRDTStop()
 
 	call timer_stop(b:green_crdt_fetch_timer)
 
+	if exists('b:green_crdt_listener')
+		call listener_remove(b:green_crdt_listener)
+		unlet b:green_crdt_listener
+	endif
+
 	call ch_close(b:channel)
 
+	delfunction GreenCRDTListener
+	delfunction GreenCRDTSendFullBuffer
+	delfunction GreenCRDTSendChanges
 	delfunction GreenCRDTCheckTimeAndSend
 	delfunction GreenCRDTCheckTimeAndFetch
 	delfunction GreenCRDTSendTimerCallback
@@ -276,11 +313,18 @@ endfunction
 // this is a hack, bc for some EX mode IPC buggyness reason, it only works as single commands OR inside a function
 R"(
 function! GreenCRDTSetupEvents() abort
+	" which document the buffer is, before anything else. the path relative to the cwd, unless b:green_crdt_doc is set
+	call ch_sendexpr(b:channel, [{'cmd': 'open', 'doc': get(b:, 'green_crdt_doc', expand('%:.'))}])
+
 	augroup green_crdt
 		au!
 		au TextChanged <buffer> call GreenCRDTChangeEvent()
 		au TextChangedI <buffer> call GreenCRDTChangeEvent()
 	augroup END
+
+	if exists('*listener_add')
+		let b:green_crdt_listener = listener_add('GreenCRDTListener', bufnr())
+	endif
 endfunction
 call GreenCRDTSetupEvents()
 delfunction GreenCRDTSetupEvents
@@ -295,23 +339,11 @@ echo 'setup done'
 
 } // namespace vim
 
-// visibility hack
-struct RequestCommand {
-	Agent agent;
-	uint64_t seq{0};
-};
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(RequestCommand,
-	agent,
-	seq
-)
-
-// hash for unordered_set
-template<>
-struct std::hash<std::pair<uint32_t, Agent>> {
-	std::size_t operator()(std::pair<uint32_t, Agent> const& s) const noexcept {
-		return std::hash<uint32_t>{}(s.first) << 3 ^ std::hash<Agent>{}(s.second);
-	}
-};
+// the sync threads wake up at least this often, so quiet command logs still get synced
+static constexpr std::chrono::milliseconds c_log_sync_interval {250};
+
+// free space we want for each read from an editor
+static constexpr size_t c_min_recv_size {16*1024};
 
 struct SharedContext {
 	std::atomic_bool should_quit {false};
@@ -320,89 +352,73 @@ struct SharedContext {
 	ToxPubKey agent;
 	std::promise<void> agent_set;
 
-	std::mutex command_lists_mutex; // for list and frontier!!
-	std::unordered_map<ToxPubKey, std::unordered_map<uint64_t, Command>> command_lists;
-	std::unordered_map<ToxPubKey, uint64_t> command_frontier; // last applied seq
-
-	// contains remote changes we can apply in the main thread
-	std::mutex staging_mutex;
-	std::unordered_map<ToxPubKey, uint64_t> staging_frontier; // last seq we have in command_lists, via tox
-	// (can be lower then command_frontier for local agent
-
-	// TODO
-	std::mutex unknown_agents_mutex;
-	std::unordered_set<ToxPubKey> unknown_agents; // list of agents we read about but dont have in command/saging frontier
-
-	// contains remote changes with missing parent seq
-	// could merge into comamnd_lists
-	std::unordered_map<ToxPubKey, std::unordered_map<uint64_t, Command>> buffer;
+	// every document, with its own gossip state and logs
+	doc_registry::Registry registry;
 
-	std::atomic_bool should_gossip_local{false}; // local changes (set by main thread, reset by tox thread)
-	std::unordered_set<ToxPubKey> should_gossip_remote; // list of ids we have new seq for (only modified by tox thread)
-	std::unordered_map<ToxPubKey, uint64_t> heard_gossip; // seq frontiers we have heard about
-
-	// peer ids that requested the last known seq for agent
-	std::unordered_set<std::pair<uint32_t, Agent>> requested_frontier;
-
-	// peer ids that requested a command
-	std::unordered_map<uint32_t, RequestCommand> requested_commands;
+	event_loop::Notifier sync_wake; // main -> sync thread, local changes or quit
+	event_loop::Notifier main_wake; // sync thread -> main, remote commands got staged
 
 	Tox* tox {nullptr};
 	bool tox_dht_online {false};
 	bool tox_group_online {false};
 	uint32_t tox_group_number {-1u};
-	std::unordered_set<uint32_t> tox_seen_peers;
 };
 
-namespace tox {
-
-namespace pkg {
-
-	enum PKGID : uint8_t {
-		FRONTIER = 32,
-		REQUEST_FRONTIER,
-		REQUEST_FRONTIERS,
+// the agent is the same for every document, the docs loaded before it was known need it too
+static void setAgent(SharedContext& ctx, const Agent& agent) {
+	std::lock_guard lg{ctx.registry.mutex};
+	ctx.agent = agent;
+	ctx.registry.agent = agent;
+	for (auto& [doc_id, document] : ctx.registry.loaded) {
+		document->doc.local_agent = agent;
+	}
+}
 
-		COMMAND,
-		REQUEST_COMMAND,
-	};
+// one round over every loaded document on the sync thread: gossip (without a transport only the logs),
+// get quiet logs onto disk and unload idle documents. what got staged goes to the editors of the
+// document, or to its worker if it has none.
+// returns how long until the next round is needed, nullopt if only packets or local changes can give it work
+static std::optional<std::chrono::steady_clock::duration> syncDocuments(SharedContext& ctx, gossip::Transport* transport, bool announce) {
+	const auto now = std::chrono::steady_clock::now();
+	std::optional<std::chrono::steady_clock::duration> until_tick;
 
-	// send the currently last known seq you have (excluding buffer)
-	struct Frontier {
-		Agent agent;
-		uint64_t seq{0};
-	};
+	std::lock_guard lg{ctx.registry.mutex};
+	ctx.registry.evict(now);
 
-	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Frontier,
-		agent,
-		seq
-	)
+	for (auto& [doc_id, document] : ctx.registry.loaded) {
+		if (document->loading || document->unloading) {
+			continue; // its worker has it
+		}
 
-	// request the last known seq another peer has for agent
-	struct RequestFrontier {
-		Agent agent;
-	};
+		if (transport != nullptr) {
+			// new ones want to know what they missed
+			if (std::exchange(document->should_announce, false) || announce) {
+				gossip::requestFrontiers(*document, *transport);
+			}
 
-	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(RequestFrontier,
-		agent
-	)
+			if (gossip::tick(*document, *transport, ctx.agent, now)) {
+				document->staged = true;
+				if (document->editors != 0) {
+					document->should_fetch = true;
+					ctx.main_wake.notify();
+				} else {
+					ctx.registry.integrate(document);
+				}
+			}
 
-	using Command = ::Command;
+			if (const auto doc_until_tick = gossip::timeUntilTick(*document, ctx.agent, now); doc_until_tick.has_value()) {
+				until_tick = std::min(until_tick.value_or(doc_until_tick.value()), doc_until_tick.value());
+			}
+		}
 
-	// request every command for agent after_seq - until_seq (inclusive)
-	//struct RequestCommands {
-		//Agent agent;
-		//uint64_t after_seq{0};
-		//uint64_t until_seq{0};
-	//};
-	using RequestCommand = ::RequestCommand;
+		std::lock_guard lg_log{document->command_lists_mutex};
+		document->command_log_store.maybeSync();
+	}
 
-	//NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(RequestCommand,
-		//agent,
-		//seq
-	//)
+	return until_tick;
+}
 
-} // namespace pkg
+namespace tox {
 
 static std::vector<uint8_t> hex2bin(const std::string& str) {
 	std::vector<uint8_t> bin{};
@@ -430,11 +446,39 @@ static void self_connection_status_cb(Tox*, TOX_CONNECTION connection_status, vo
 static void group_custom_packet_cb(Tox* tox, uint32_t group_number, uint32_t peer_id, const uint8_t* data, size_t length, void* user_data);
 static void group_custom_private_packet_cb(Tox* tox, uint32_t group_number, uint32_t peer_id, const uint8_t* data, size_t length, void* user_data);
 
+// gossip over the tox group, peer ids are group peer ids
+struct Transport : gossip::Transport {
+	Tox* tox {nullptr};
+	uint32_t group_number {-1u};
+
+	bool broadcast(const std::vector<uint8_t>& data) override {
+		Tox_Err_Group_Send_Custom_Packet send_err{TOX_ERR_GROUP_SEND_CUSTOM_PACKET_OK};
+		if (!tox_group_send_custom_packet(tox, group_number, true, data.data(), data.size(), &send_err)) {
+			std::cerr << "tox_group_send_custom_packet failed " << send_err << "\n";
+			assert(send_err != TOX_ERR_GROUP_SEND_CUSTOM_PACKET_TOO_LONG);
+			return false;
+		}
+		return true;
+	}
+
+	bool sendTo(gossip::PeerID peer_id, const std::vector<uint8_t>& data) override {
+		Tox_Err_Group_Send_Custom_Private_Packet send_err{TOX_ERR_GROUP_SEND_CUSTOM_PRIVATE_PACKET_OK};
+		if (!tox_group_send_custom_private_packet(tox, group_number, peer_id, true, data.data(), data.size(), &send_err)) {
+			std::cerr << "tox_group_send_custom_private_packet failed " << send_err << "\n";
+			assert(send_err != TOX_ERR_GROUP_SEND_CUSTOM_PRIVATE_PACKET_TOO_LONG);
+			return false;
+		}
+		return true;
+	}
+
+	bool connected(gossip::PeerID peer_id) override {
+		return tox_group_peer_get_connection_status(tox, group_number, peer_id, nullptr) != TOX_CONNECTION_NONE;
+	}
+};
+
 void toxThread(SharedContext* ctx) {
 	using namespace std::chrono_literals;
 
-	std::minstd_rand rng{1337};
-
 	TOX_ERR_OPTIONS_NEW err_opt_new;
 	Tox_Options* options = tox_options_new(&err_opt_new);
 	assert(err_opt_new == TOX_ERR_OPTIONS_NEW::TOX_ERR_OPTIONS_NEW_OK);
@@ -489,8 +533,8 @@ void toxThread(SharedContext* ctx) {
 		}
 	}
 
-	// "thread local"
-	Agent agent_local;
+	event_loop::Loop loop;
+	loop.add(ctx->sync_wake.fd, EPOLLIN, [ctx](uint32_t) { ctx->sync_wake.drain(); });
 
 	while (!ctx->should_quit) {
 		// tox iterate
@@ -508,13 +552,14 @@ void toxThread(SharedContext* ctx) {
 				const std::string_view name {"green_crdt_vim2"};
 				ctx->tox_group_number = tox_group_join(ctx->tox, chat_id.data(), reinterpret_cast<const uint8_t*>(name.data()), name.size(), nullptr, 0, nullptr);
 
-				if (!tox_group_self_get_public_key(ctx->tox, ctx->tox_group_number, ctx->agent.data(), nullptr)) {
+				Agent agent_local;
+				if (!tox_group_self_get_public_key(ctx->tox, ctx->tox_group_number, agent_local.data(), nullptr)) {
 					std::cerr << "failed to get own pub key\n";
 					ctx->should_quit = true;
 					ctx->agent_set.set_value();
 					return; // fuck everything
 				}
-				agent_local = ctx->agent;
+				setAgent(*ctx, agent_local);
 				ctx->agent_set.set_value();
 			}
 		} else if (!ctx->tox_group_online) { // then wait for group to connect
@@ -522,242 +567,34 @@ void toxThread(SharedContext* ctx) {
 				ctx->tox_group_online = true;
 				std::cout << "tox connected to group\n";
 			}
-		} else { // do the thing
-			std::vector<std::pair<Agent, uint64_t>> missing_in_buffer;
-			{ // pump from buffer to staging
-				const size_t max_commands = 2;
-				size_t number_of_commands_done = 0;
-				std::vector<Agent> empty_buffers;
-				{
-					std::lock_guard lg_staging{ctx->staging_mutex};
-					for (auto& [agent, buffer] : ctx->buffer) {
-						if (buffer.empty()) {
-							empty_buffers.push_back(agent);
-							continue;
-						}
-						if (agent == agent_local) {
-							// skip ? self
-							continue;
-						}
-						if (number_of_commands_done >= max_commands) {
-							break;
-						}
-
-						// determain the seq we are looking for in buffer
-						uint64_t seq {0};
-						if (ctx->staging_frontier.count(agent)) {
-							seq = ctx->staging_frontier.at(agent) + 1;
-						}
-
-						if (!buffer.count(seq)) { // not in buffer, skip
-							// check if old in buffer
-							for (const auto& it : buffer) {
-								if (it.first < seq) {
-									assert(false && "buffer not clean !!");
-								}
-							}
-
-							//std::cout << "!!! buffer not empty but not next seq\n";
-							missing_in_buffer.push_back(std::make_pair(agent, seq));
-							continue;
-						}
-
-						std::vector<uint64_t> seq_to_remove;
-						{ // this can lead to dead locks, if other code does this wrong
-							std::lock_guard lg{ctx->command_lists_mutex};
-							for (; buffer.count(seq); seq++) {
-								ctx->command_lists[agent][seq] = buffer.at(seq);
-								ctx->staging_frontier[agent] = seq;
-								seq_to_remove.push_back(seq);
-
-								number_of_commands_done++;
-								if (number_of_commands_done >= max_commands) {
-									break;
-								}
-							}
-
-							//ctx->staging_frontier[agent] = seq;
-						}
-						ctx->should_gossip_remote.emplace(agent);
-
-						for (const auto key : seq_to_remove) {
-							buffer.erase(key);
-						}
-						if (buffer.empty()) {
-							empty_buffers.push_back(agent);
-						}
-					}
-				} // scope for staging lock
-				for (const auto& agent : empty_buffers) {
-					ctx->buffer.erase(agent);
-				}
-			}
-
-			{ // request missing in buffer
-				// (every tick lol)
-				for (const auto& [agent, seq] : missing_in_buffer) {
-					// ask random peer_id we have seen before
-					const uint32_t peer_id = *ctx->tox_seen_peers.cbegin() + (rng() % ctx->tox_seen_peers.size());
-					const auto status = tox_group_peer_get_connection_status(ctx->tox, ctx->tox_group_number, peer_id, nullptr);
-					if (status == TOX_CONNECTION_NONE) {
-						// bad luck, skip
-						// TODO: do seen peers cleanup
-						continue;
-					}
-
-					// send request for command
-					pkg::RequestCommand rc_pkg{
-						agent, seq
-					};
-					std::vector<uint8_t> data = nlohmann::json::to_msgpack(rc_pkg);
-					// prepend pkgid
-					data.emplace(data.begin(), static_cast<uint8_t>(pkg::PKGID::REQUEST_COMMAND));
-
-					Tox_Err_Group_Send_Custom_Private_Packet send_err{TOX_ERR_GROUP_SEND_CUSTOM_PRIVATE_PACKET_OK};
-					if (!tox_group_send_custom_private_packet(ctx->tox, ctx->tox_group_number, peer_id, true, data.data(), data.size(), &send_err)) {
-						std::cerr << "failed to send command request packet for " << std::dec << seq << " from " << std::hex << (int)agent[0] << " " << std::dec << (int)send_err << "\n";
-						assert(send_err != TOX_ERR_GROUP_SEND_CUSTOM_PRIVATE_PACKET_TOO_LONG);
-					} else {
-						std::cout << "sent command request packet for " << std::dec << seq << " from " << std::hex << (int)agent[0] << " to " << std::dec << peer_id << "\n";
-					}
-				}
-			}
-
-			// request frontier (implicit list of agents)
-			// only every couple of second, can get large
-			// OR get back random agent and do it often
-
-			{ // handle requests
-				// TODO: this lock is trash
-				if (!ctx->requested_commands.empty()) {
-					std::lock_guard lg{ctx->command_lists_mutex};
-					for (const auto& [peer_id, request] : ctx->requested_commands) {
-						if (ctx->command_lists.count(request.agent) && ctx->command_lists.at(request.agent).count(request.seq)) {
-							const auto& command = ctx->command_lists.at(request.agent).at(request.seq);
-
-							// send command
-
-							std::vector<uint8_t> data = nlohmann::json::to_msgpack(command);
-							// prepend pkgid
-							data.emplace(data.begin(), static_cast<uint8_t>(pkg::PKGID::COMMAND));
-
-							Tox_Err_Group_Send_Custom_Private_Packet send_err{TOX_ERR_GROUP_SEND_CUSTOM_PRIVATE_PACKET_OK};
-							if (!tox_group_send_custom_private_packet(ctx->tox, ctx->tox_group_number, peer_id, true, data.data(), data.size(), &send_err)) {
-								std::cerr << "failed to send command packet " << send_err << "\n";
-								assert(send_err != TOX_ERR_GROUP_SEND_CUSTOM_PRIVATE_PACKET_TOO_LONG);
-							} else {
-								std::cout << "sent requested command to " << peer_id << "\n";
-							}
-						}
-						// else, we dont care. maybe check staging too
-					}
-
-					// HACK: clear each tick
-					ctx->requested_commands.clear();
-					std::cout << "cleared requested commands\n";
-				}
-			}
-
-			{ // gossip frontier
-				// for mutex locking simplicity this is an either-or
-				if (ctx->should_gossip_local.exchange(false)) {
-					pkg::Frontier f_pkg{
-						agent_local,
-						0u
-					};
-
-					pkg::Command c_pkg{
-						agent_local,
-						0u,
-						{}
-					};
-
-					{ // lock
-						std::lock_guard lg{ctx->command_lists_mutex};
-						assert(ctx->command_frontier.count(agent_local));
-
-						f_pkg.seq = ctx->command_frontier.at(agent_local);
-
-						c_pkg = ctx->command_lists[agent_local][f_pkg.seq];
-						assert(!c_pkg.ops.empty());
-					}
-
-					{ // gossip
-						std::vector<uint8_t> data = nlohmann::json::to_msgpack(f_pkg);
-						// prepend pkgid
-						data.emplace(data.begin(), static_cast<uint8_t>(pkg::PKGID::FRONTIER));
-
-						Tox_Err_Group_Send_Custom_Packet send_err{TOX_ERR_GROUP_SEND_CUSTOM_PACKET_OK};
-						if (!tox_group_send_custom_packet(ctx->tox, 0, true, data.data(), data.size(), &send_err)) {
-							std::cerr << "failed to send gossip packet of local agent" << send_err << "\n";
-							assert(send_err != TOX_ERR_GROUP_SEND_CUSTOM_PACKET_TOO_LONG);
-							// TODO: set should_gossip_local back to true?
-						} else {
-							std::cout << "sent gossip of local agent\n";
-						}
-					}
-					{ // command
-						std::vector<uint8_t> data = nlohmann::json::to_msgpack(c_pkg);
-						// prepend pkgid
-						data.emplace(data.begin(), static_cast<uint8_t>(pkg::PKGID::COMMAND));
-
-						Tox_Err_Group_Send_Custom_Packet send_err{TOX_ERR_GROUP_SEND_CUSTOM_PACKET_OK};
-						if (!tox_group_send_custom_packet(ctx->tox, 0, true, data.data(), data.size(), &send_err)) {
-							std::cerr << "failed to send command packet of local agent\n";
-							assert(send_err != TOX_ERR_GROUP_SEND_CUSTOM_PACKET_TOO_LONG);
-						} else {
-							std::cout << "sent command of local agent\n";
-						}
-					}
-				} else if (!ctx->should_gossip_remote.empty()) {
-					// we got new remote staged, lets amp the traffic
-
-					// only do first
-					auto it = ctx->should_gossip_remote.cbegin();
-
-					pkg::Frontier f_pkg{
-						*it,
-						0u
-					};
-
-					{ // lock
-						std::lock_guard lg{ctx->staging_mutex};
-						assert(ctx->staging_frontier.count(*it));
-
-						f_pkg.seq = ctx->staging_frontier.at(*it);
-					}
+		}
 
-					std::vector<uint8_t> data = nlohmann::json::to_msgpack(f_pkg);
-					// prepend pkgid
-					data.emplace(data.begin(), static_cast<uint8_t>(pkg::PKGID::FRONTIER));
+		std::optional<std::chrono::steady_clock::duration> until_tick;
+		if (ctx->tox_group_online) { // do the thing, for every document
+			Transport transport;
+			transport.tox = ctx->tox;
+			transport.group_number = ctx->tox_group_number;
 
-					Tox_Err_Group_Send_Custom_Packet send_err{TOX_ERR_GROUP_SEND_CUSTOM_PACKET_OK};
-					if (!tox_group_send_custom_packet(ctx->tox, 0, true, data.data(), data.size(), &send_err)) {
-						std::cerr << "failed to send gossip packet " << send_err << "\n";
-						assert(send_err != TOX_ERR_GROUP_SEND_CUSTOM_PACKET_TOO_LONG);
-					} else {
-						std::cout << "sent gossip of remote agent\n";
-					}
-
-					ctx->should_gossip_remote.erase(it);
-				}
-			}
+			until_tick = syncDocuments(*ctx, &transport, false);
+		} else {
+			// still get quiet logs onto disk
+			syncDocuments(*ctx, nullptr, false);
 		}
 
-		std::this_thread::sleep_for(20ms);
+		// tox tells us when it wants to be iterated next, local changes wake us up earlier
+		auto timeout = std::min<std::chrono::milliseconds>(std::chrono::milliseconds(tox_iteration_interval(ctx->tox)), c_log_sync_interval);
+		if (until_tick.has_value()) {
+			timeout = std::min(timeout, std::chrono::ceil<std::chrono::milliseconds>(until_tick.value()));
+		}
+		loop.wait(static_cast<int>(timeout.count()));
 	}
 
+	loop.remove(ctx->sync_wake.fd);
+
 	tox_kill(ctx->tox);
 }
 
 } // namespace tox
-
-std::ostream& operator<<(std::ostream& out, const ToxPubKey& id) {
-	out << std::hex << static_cast<int>(id.front());
-
-	return out;
-}
-
 std::ostream& operator<<(std::ostream& out, const std::optional<ListType::ListID>& id) {
 	if (id.has_value()) {
 		out << id.value().id << "-" << id.value().seq;
@@ -818,29 +655,207 @@ std::ostream& operator<<(std::ostream& out, const ListType::Entry& e) {
 	return out;
 }
 
-int main(void) {
+namespace lan {
+
+// gossip over udp with a fixed set of peers (plus whoever talks to us)
+void lanThread(SharedContext* ctx, uint16_t port, std::vector<zed_net_address_t> peers) {
+	using namespace std::chrono_literals;
+
+	Transport transport;
+	if (!transport.open(port)) {
+		ctx->should_quit = true;
+		ctx->agent_set.set_value();
+		return;
+	}
+	for (const auto& address : peers) {
+		transport.addPeer(address);
+	}
+
+	std::cout << "lan transport on udp port " << port << " with " << peers.size() << " peers\n";
+
+	{ // no group key to use, so a new agent each start (like a new tox instance)
+		Agent agent_local;
+		std::random_device rd;
+		for (auto& byte : agent_local) {
+			byte = static_cast<uint8_t>(rd());
+		}
+		setAgent(*ctx, agent_local);
+	}
+	ctx->agent_set.set_value();
+
+	event_loop::Loop loop;
+	loop.add(ctx->sync_wake.fd, EPOLLIN, [ctx](uint32_t) { ctx->sync_wake.drain(); });
+	loop.add(transport.socket.handle, EPOLLIN, [ctx, &transport](uint32_t) {
+		transport.poll([ctx](const uint8_t* data, size_t length, gossip::PeerID peer_id) {
+			ctx->registry.handlePkg(data, length, peer_id);
+		});
+	});
+
+	const auto announce_interval {1s};
+	auto last_announce = std::chrono::steady_clock::now() - announce_interval;
+	while (!ctx->should_quit) {
+		// until everyone knows us, and to pick up peers that (re)joined
+		const auto now = std::chrono::steady_clock::now();
+		const bool announce = now - last_announce >= announce_interval;
+		if (announce) {
+			last_announce = now;
+		}
+
+		const auto until_tick = syncDocuments(*ctx, &transport, announce);
+
+		// sleep until packets, local changes or the next timed thing
+		auto timeout = std::min<std::chrono::milliseconds>(
+			std::chrono::ceil<std::chrono::milliseconds>(last_announce + announce_interval - std::chrono::steady_clock::now()),
+			c_log_sync_interval
+		);
+		if (until_tick.has_value()) {
+			timeout = std::min(timeout, std::chrono::ceil<std::chrono::milliseconds>(until_tick.value()));
+		}
+		loop.wait(static_cast<int>(std::max<std::chrono::milliseconds>(timeout, 0ms).count()));
+	}
+
+	loop.remove(transport.socket.handle);
+	loop.remove(ctx->sync_wake.fd);
+}
+
+} // namespace lan
+
+// maps the (1 based, inclusive) vim line range to a range of list indices [first, second)
+static std::pair<size_t, size_t> linesToListRange(const doc_registry::View& view, int64_t first_line, int64_t last_line) {
+	if (last_line < first_line) {
+		return {0u, 0u};
+	}
+	return {
+		view.lineStart(static_cast<size_t>(std::max<int64_t>(first_line, 1))),
+		view.lineStart(static_cast<size_t>(std::max<int64_t>(last_line, 0)) + 1)
+	};
+}
+
+static std::vector<ListType::ListID> opIDs(const std::vector<Doc::Op>& ops) {
+	std::vector<ListType::ListID> ids;
+	ids.reserve(ops.size());
+	for (const auto& op : ops) {
+		ids.push_back(std::visit([](const auto& o) { return o.id; }, op));
+	}
+	return ids;
+}
+
+// every line, as [line number, line]
+static nlohmann::json docLines(const doc_registry::View& view) {
+	auto j_lines = nlohmann::json::array();
+
+	const auto crdt_text = view.getText();
+	std::string_view text_view {crdt_text};
+	for (int64_t i = 1; ; i++) {
+		const auto nl_pos = text_view.find_first_of("\n");
+		if (nl_pos == std::string_view::npos) {
+			// no more lines
+			j_lines.push_back(nlohmann::json::array({i, text_view}));
+			break;
+		} else {
+			const auto line = text_view.substr(0, nl_pos);
+			j_lines.push_back(nlohmann::json::array({i, line}));
+
+			assert(text_view.size() >= nl_pos+1);
+			text_view = text_view.substr(nl_pos+1);
+		}
+	}
+
+	return j_lines;
+}
+
+// same as sha256(join(getline(1, '$'), "\n")) in vim
+static std::string textChecksum(const doc_registry::View& view) {
+	const auto text = view.getText();
+
+	std::array<uint8_t, crypto_hash_sha256_BYTES> hash;
+	crypto_hash_sha256(hash.data(), reinterpret_cast<const uint8_t*>(text.data()), text.size());
+
+	std::string hex(hash.size()*2 + 1, '\0');
+	sodium_bin2hex(hex.data(), hex.size(), hash.data(), hash.size());
+	hex.pop_back(); // null
+	return hex;
+}
+
+// ops an editor made, on the worker of the document. the other editors get them with the view
+static doc_registry::Change addLocalOps(SharedContext& ctx, doc_registry::Document& document, const std::vector<Doc::Op>& ops) {
+	if (gossip::addLocalOps(document, ctx.agent, ops) != 0) {
+		ctx.sync_wake.notify(); // gossip now, not on the next timeout
+	}
+
+	doc_registry::Change change;
+	change.ids = opIDs(ops);
+	change.writers_own = true;
+	return change;
+}
+
+// directory with a directory per document, with the command logs of all agents we know and a snapshot
+static constexpr std::string_view c_log_dir {"./green_crdt_log"};
+
+// documents are named by the editor (the file name by default), the id is the sha256 of the name
+static DocID docIDFromName(std::string_view name) {
+	DocID doc_id;
+	crypto_hash_sha256(doc_id.data(), reinterpret_cast<const uint8_t*>(name.data()), name.size());
+	return doc_id;
+}
+
+int main(int argc, char** argv) {
+	// tox by default, or direct udp with --lan
+	std::optional<uint16_t> lan_port;
+	std::vector<zed_net_address_t> lan_peers;
+	for (int i = 1; i < argc; i++) {
+		const std::string_view arg {argv[i]};
+		zed_net_address_t address {};
+		if (arg == "--lan" && i + 1 < argc) {
+			lan_port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+		} else if (lan_port.has_value() && lan::parseAddress(arg, address)) {
+			lan_peers.push_back(address);
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--lan <udp port> [host:port ...]]\n";
+			return -1;
+		}
+	}
+
 	SharedContext ctx;
-	std::cout << "starting tox thread\n";
-	auto tox_thread = std::thread(tox::toxThread, &ctx);
 
-	std::cout << "waiting for agent id\n";
-	ctx.agent_set.get_future().wait();
-	if (ctx.should_quit) {
-		tox_thread.join(); // wait for thread
+	if (!ctx.registry.open(std::filesystem::path{c_log_dir})) {
+		std::cerr << "failed to open doc dir " << c_log_dir << "\n";
 		return -1;
 	}
+	// documents get loaded (and restored from disk) once an editor opens them
+	std::cout << "hosting " << ctx.registry.known.size() << " docs from " << c_log_dir << "\n";
 
-	std::cout << "starting vim ipc server\n";
+	// the crdts live on the workers, the main thread reads the views they publish
+	ctx.registry.on_changes = [&ctx]() { ctx.main_wake.notify(); };
+	ctx.registry.workers.start(std::thread::hardware_concurrency());
+	std::cout << "started " << ctx.registry.workers.size() << " doc workers\n";
 
 	if (zed_net_init() != 0) {
-		ctx.should_quit.store(true);
 		std::cerr << "zed_net_init failed: " << zed_net_get_error() << "\n";
-		tox_thread.join(); // wait for thread
 		return -1;
 	}
 
 	std::cout << "initialized zed_net\n";
 
+	std::thread sync_thread;
+	if (lan_port.has_value()) {
+		std::cout << "starting lan thread\n";
+		sync_thread = std::thread(lan::lanThread, &ctx, lan_port.value(), lan_peers);
+	} else {
+		std::cout << "starting tox thread\n";
+		sync_thread = std::thread(tox::toxThread, &ctx);
+	}
+
+	std::cout << "waiting for agent id\n";
+	ctx.agent_set.get_future().wait();
+	if (ctx.should_quit) {
+		sync_thread.join(); // wait for thread
+		zed_net_shutdown();
+		return -1;
+	}
+
+	std::cout << "starting vim ipc server\n";
+
 	const uint16_t port_start {1337};
 	const uint16_t port_end {1437};
 	uint16_t port = port_start;
@@ -860,9 +875,10 @@ int main(void) {
 
 	if (!found_free_port) {
 		ctx.should_quit.store(true);
+		ctx.sync_wake.notify();
 		std::cerr << "zed_net_tcp_socket_open failed: " << zed_net_get_error() << "\n";
 		zed_net_shutdown();
-		tox_thread.join(); // wait for thread
+		sync_thread.join(); // wait for thread
 		return -1;
 	}
 
@@ -870,78 +886,189 @@ int main(void) {
 
 	std::cout << "paste these commands into your vim for the current buffer:\n";
 	std::cout << "  :let b:channel = ch_open('localhost:" << port << "')\n";
+	std::cout << "the document is named after the file, set b:green_crdt_doc before to pick another name\n";
 
 	std::cout << "paste this command to disconnect:\n  :call GreenCRDTStop()\n";
 
-	zed_net_socket_t remote_socket;
-	zed_net_address_t remote_address;
-	if (zed_net_tcp_accept(&listen_socket, &remote_socket, &remote_address) != 0) {
-		ctx.should_quit.store(true);
-		std::cerr << "zed_net_tcp_accept failed: " << zed_net_get_error() << "\n";
-		zed_net_socket_close(&listen_socket);
-		zed_net_shutdown();
-		tox_thread.join(); // wait for thread
-		return -1;
-	}
+	// every connected vim
+	struct Editor {
+		uint64_t id {0}; // the writer of its writes, fds get reused
+		zed_net_socket_t socket;
+		std::shared_ptr<doc_registry::Document> document; // after it sent open, stays loaded while it is here
+		std::optional<uint64_t> open_ticket; // the doc gets sent once the view has it
+		bool send_full_text {false}; // it needs the whole doc, eg. when it just connected
+		dirty_lines::DirtyRanges dirty; // where the doc changed since the editor last saw it
+		uint64_t seen_ticket {0}; // the view dirty is in, its messages wait for the writes posted before them
+		bool resync {false}; // its changes did not fit the doc, get its full buffer
+		bool want_full_buffer {false}; // it sent its full buffer while behind, it sends it again once it caught up
+
+		// vim waits for the answer, which waits for the writes before it
+		struct Fetch {
+			int64_t command_seq {0};
+			uint64_t ticket {0}; // answered from the first view that has it
+			std::optional<int64_t> line_count;
+			std::optional<std::string> checksum;
+			bool more {false};
+		};
+		std::optional<Fetch> fetch;
 
-	std::cout << "got connection from " << zed_net_host_to_str(remote_address.host) << ":" << remote_address.port << "\n";
+		LineBuffer recv_buffer; // partial messages wait here for the rest
+		vim::Message message; // reused, so big buffers dont allocate every time
+	};
+	std::unordered_map<int, Editor> editors; // by socket fd
+	uint64_t next_editor_id {1};
 
-	std::cout << "sending setup\n";
-	vim::sendSetup(&remote_socket);
-	// send doauto text changed for inital buffer
+	// the main thread reads views only, pinned for as long as it looks at one
+	auto& view_reader = ctx.registry.views.reader();
 
-	Doc doc;
-	doc.local_agent = ctx.agent;
+	// its edits only go in on top of what it has, on top of anything else they land on the wrong lines
+	const auto up_to_date = [](const Editor& editor) {
+		return editor.dirty.empty() && !editor.send_full_text && !editor.open_ticket.has_value();
+	};
 
-	while (true) {
-		// 100MiB
-		auto buffer = std::make_unique<std::array<uint8_t, 1024*1024*100>>();
+	// the view has everything the editor sent before the fetch
+	const auto answer_fetch = [&](Editor& editor, const doc_registry::View& view) {
+		const auto fetch = std::move(editor.fetch.value());
+		editor.fetch.reset();
 
-		int64_t bytes_received {0};
-		bytes_received = zed_net_tcp_socket_receive(&remote_socket, buffer->data(), buffer->size());
-		if (bytes_received < 0) {
-			ctx.should_quit.store(true);
-			std::cerr << "zed_net_tcp_socket_receive failed: " << zed_net_get_error() << "\n";
-			zed_net_socket_close(&remote_socket);
-			zed_net_socket_close(&listen_socket);
-			zed_net_shutdown();
-			tox_thread.join(); // wait for thread
-			return -1;
-		} else if (bytes_received == 0) {
-			std::cout << "got 0 bytes?\n";
-			break; // connection closed
+		// only comparable if it is up to date
+		if (fetch.checksum.has_value() && !editor.send_full_text && editor.dirty.empty() && !editor.resync) {
+			if (fetch.checksum.value() != textChecksum(view)) {
+				std::cerr << "editor checksum mismatch, resyncing\n";
+				editor.resync = true;
+			}
+		}
+
+		if (std::exchange(editor.resync, false)) {
+			// no text and no new changes, it sends its full buffer next
+			editor.want_full_buffer = false;
+			vim::sendResponse(&editor.socket, fetch.command_seq, {
+				{"lines", nlohmann::json::array()},
+				{"more", true},
+				{"resync", true},
+			});
+			return;
 		}
 
-		std::cout << "got " << bytes_received << " bytes\n";
+		auto j_res_line_list = nlohmann::json::array();
+		auto j_res_changes = nlohmann::json::array();
+		if (editor.send_full_text || !editor.dirty.empty()) { // external changes
+			std::optional<nlohmann::json> delta;
+			if (!editor.send_full_text && fetch.line_count.has_value()) {
+				// only the lines that changed
+				delta = dirty_lines::dirtyLines(view, editor.dirty, fetch.line_count.value());
+			}
+
+			if (delta.has_value()) {
+				j_res_changes = std::move(delta.value());
+			} else {
+				j_res_line_list = docLines(view);
+			}
+
+			editor.send_full_text = false;
+			editor.dirty.clear();
+		}
 
-		// expect json array(s separated by newlines)
-		// TODO: new lines
-		auto view = std::string_view{reinterpret_cast<const char*>(buffer->data()), static_cast<size_t>(bytes_received)};
-		std::cout << "  raw: " << view;
+		vim::sendResponse(&editor.socket, fetch.command_seq, {
+			{"lines", j_res_line_list},
+			{"changes", j_res_changes},
+			{"more", fetch.more},
+		});
 
-		auto j = nlohmann::json::parse(view, nullptr, false);
-		if (j.is_discarded()) {
+		if (std::exchange(editor.want_full_buffer, false)) {
+			// with its edits on top of what it just got
+			vim::sendRequestFullBuffer(&editor.socket);
+		}
+	};
+
+	// what the workers published for a document since the last time, for all of its editors
+	const auto take_changes = [&](doc_registry::Document& document) {
+		epoch::Guard guard {ctx.registry.views, view_reader};
+
+		std::vector<doc_registry::Change> changes;
+		const doc_registry::View* view {nullptr};
+		{ // the marks have to match the view
+			std::lock_guard lg{document.view_mutex};
+			changes.swap(document.changes);
+			view = document.view.load();
+		}
+		if (view == nullptr) {
+			return; // the first write is not in yet
+		}
+
+		for (auto& [fd, editor] : editors) {
+			if (editor.document.get() != &document) {
+				continue;
+			}
+
+			for (const auto& change : changes) {
+				const bool writer = change.writer == editor.id;
+				if (writer) {
+					if (change.failed) {
+						editor.resync = true;
+					}
+					if (editor.fetch.has_value() && editor.fetch->ticket == change.ticket) {
+						editor.fetch->more = change.more_pending;
+					}
+				}
+
+				// the other editors of the doc dont have it yet
+				if (!dirty_lines::markDirty(editor.dirty, change.located, writer && change.writers_own)) {
+					editor.dirty.clear();
+					editor.send_full_text = true;
+				}
+			}
+			editor.seen_ticket = std::max(editor.seen_ticket, view->ticket);
+
+			if (editor.open_ticket.has_value() && view->ticket >= editor.open_ticket.value()) {
+				editor.open_ticket.reset();
+
+				// the doc (restored or edited by others) needs to be sent to vim, even without new remote changes
+				editor.send_full_text = !view->empty();
+				if (!editor.send_full_text) {
+					// nothing to give it, take what it has
+					vim::sendRequestFullBuffer(&editor.socket);
+				}
+			}
+
+			if (editor.fetch.has_value() && view->ticket >= editor.fetch->ticket) {
+				answer_fetch(editor, *view);
+			}
+		}
+	};
+
+	// one complete message from an editor, returns false if the editor should be dropped
+	const auto handle_message = [&](Editor& editor, std::string_view view) -> bool {
+		std::cout << "  raw: " << view << "\n";
+
+		const auto parse_res = vim::parseMessage(view, editor.message);
+		if (parse_res == vim::ParseResult::invalid_json) {
 			std::cerr << "invalid json\n";
 			//break;
-			continue; // whatever
+			return true; // whatever
+		} else if (parse_res == vim::ParseResult::invalid_lines) {
+			std::cerr << "lines list contains non strings!\n";
+			return false;
 		}
+		const auto& j = editor.message.j;
 
 		//std::cout << "  j: " << j.dump() << "\n";
 
 		if (!j.is_array()) {
 			std::cerr << "json not array!\n";
-			break;
+			return false;
 		}
 
 		int64_t command_seq = j.at(0);
-		auto j_command_data = j.at(1);
+		const auto& j_command_data = j.at(1);
 
 		if (!j_command_data.is_array()) {
 			std::cerr << "j_command_data not array!\n";
-			break;
+			return false;
 		}
 
-		for (const auto& j_command : j_command_data) {
+		for (size_t command_idx = 0; command_idx < j_command_data.size(); command_idx++) {
+			const auto& j_command = j_command_data.at(command_idx);
 			if (!j_command.is_object()) {
 				std::cerr << "j_command not obj!\n";
 				break;
@@ -964,258 +1091,397 @@ int main(void) {
 				break;
 			} else if (command == "setup") { // setup callbacks etc, basically the plugin
 				std::cout << "sending setup\n";
-				vim::sendSetup(&remote_socket);
+				vim::sendSetup(&editor.socket);
+			} else if (command == "open") { // which document the buffer is
+				if (!j_command.count("doc") || !j_command.at("doc").is_string()) {
+					std::cerr << "doc name not a string!\n";
+					return false;
+				}
+
+				if (editor.document) {
+					std::cerr << "editor already opened a doc!\n";
+					continue;
+				}
+
+				const auto& doc_name = j_command.at("doc").get_ref<const std::string&>();
+				{
+					std::lock_guard lg{ctx.registry.mutex};
+					const DocID doc_id = docIDFromName(doc_name);
+					if (ctx.registry.get(doc_id, true) == nullptr) {
+						std::cerr << "failed to load doc '" << doc_name << "'\n";
+						return false;
+					}
+					editor.document = ctx.registry.loaded.at(doc_id);
+					editor.document->editors++; // workers leave it alone from here on
+				}
+				ctx.sync_wake.notify(); // a new doc wants to announce itself
+
+				std::cout << "editor opened doc '" << doc_name << "'\n";
+
+				// after whatever a worker was still doing with it, then it is sent
+				editor.open_ticket = ctx.registry.write(editor.document, editor.id, [](const auto&) {
+					return doc_registry::Change{};
+				});
+			} else if (!editor.document) {
+				std::cerr << "command '" << command << "' before open!\n";
+				if (command == "fetch_changes") {
+					// dont let it wait for the timeout
+					vim::sendResponse(&editor.socket, command_seq, {
+						{"lines", nlohmann::json::array()},
+						{"more", false},
+					});
+				}
 			} else if (command == "fetch_changes") { // setup callbacks etc, basically the plugin
 				// apply changes (some) and gen vim inserts
 				std::cout << "got fetch changes\n";
 
-				bool changes {false};
-				{ // apply changes
-					// TODO: make less locky, we dont need to hold both at the same time etc
-					//std::lock_guard lg {ctx.staging_mutex};
-					std::scoped_lock sl {ctx.staging_mutex, ctx.command_lists_mutex};
-
-					// TODO: limit number of ops for responsiveness
-					for (const auto& [agent, staging_seq] : ctx.staging_frontier) {
-						// check if remote newer
-						if (!ctx.command_frontier.count(agent) || ctx.command_frontier.at(agent) < staging_seq) {
-							uint64_t seq {0};
-							if (ctx.command_frontier.count(agent)) {
-								seq = ctx.command_frontier[agent] + 1;
-							}
-							for (; seq <= staging_seq; seq++) {
-								assert(ctx.command_lists.count(agent));
-								assert(ctx.command_lists.at(agent).count(seq));
-
-								// !! this can get expensive, while we are holding locks :/
-								bool r = doc.apply(ctx.command_lists.at(agent).at(seq).ops);
-								// TODO: actually this can fail with missing parents of an agent we never heard about before
-								if (!r) {
-									std::cout << "faild to apply:\n";
-									for (const auto& op : ctx.command_lists.at(agent).at(seq).ops) {
-										std::cout << "  " << op << "\n";
-									}
-								}
-								assert(r && "this should not happen");
-							}
-
-							ctx.command_frontier[agent] = staging_seq;
-							changes = true;
-						}
-					}
+				auto& document = *editor.document;
+
+				if (j_command.count("full_text") && j_command.at("full_text").is_boolean() && j_command.at("full_text").get<bool>()) {
+					// it missed an answer
+					editor.send_full_text = true;
 				}
 
-				auto j_res_line_list = nlohmann::json::array();
-				if (changes) { // external changes
-					const auto crdt_text = doc.getText();
-					std::string_view text_view {crdt_text};
-					for (int64_t i = 1; ; i++) {
-						const auto nl_pos = text_view.find_first_of("\n");
-						if (nl_pos == std::string_view::npos) {
-							// no more lines
-							j_res_line_list.push_back(nlohmann::json::array({i, text_view}));
-							break;
-						} else {
-							const auto line = text_view.substr(0, nl_pos);
-							j_res_line_list.push_back(nlohmann::json::array({i, line}));
+				Editor::Fetch fetch;
+				fetch.command_seq = command_seq;
+				if (j_command.count("line_count") && j_command.at("line_count").is_number_integer()) {
+					fetch.line_count = j_command.at("line_count").get<int64_t>();
+				}
+				if (j_command.count("checksum") && j_command.at("checksum").is_string()) {
+					fetch.checksum = j_command.at("checksum").get<std::string>();
+				}
 
-							assert(text_view.size() >= nl_pos+1);
-							text_view = text_view.substr(nl_pos+1);
+				if (document.staged) {
+					// lines of the view, the slice comes after the writes the lines are from
+					std::optional<std::pair<size_t, size_t>> viewport;
+					if (j_command.count("viewport") && j_command.at("viewport").is_array() && j_command.at("viewport").size() == 2) {
+						epoch::Guard guard {ctx.registry.views, view_reader};
+						if (const auto* view = document.view.load(); view != nullptr) {
+							viewport = linesToListRange(*view, j_command.at("viewport").at(0), j_command.at("viewport").at(1));
 						}
 					}
+
+					// budgeted, so vim does not wait for long
+					fetch.ticket = ctx.registry.integrateFor(editor.document, editor.id, viewport);
+				} else {
+					fetch.ticket = document.tickets; // only the writes it sent
 				}
 
-				vim::sendResponse(&remote_socket, command_seq, j_res_line_list);
+				// a previous one that timed out in vim is not waited on anymore
+				editor.fetch = std::move(fetch);
+				take_changes(document); // right away, if the view has it already
 			} else if (command == "full_buffer") { // vim is sending the full buffer
 				// array of lines
 
-				if (!j_command.count("lines")) {
-					std::cerr << "lines list empty!\n";
+				// already joined while parsing
+				const auto lines = editor.message.lines(command_idx);
+				if (!lines.has_value()) {
+					if (!j_command.count("lines")) {
+						std::cerr << "lines list empty!\n";
+					} else {
+						std::cerr << "lines list not an array!\n";
+					}
 					continue;
 				}
 
-				const auto& j_lines = j_command.at("lines");
-				if (!j_lines.is_array()) {
-					std::cerr << "lines list not an array!\n";
+				if (!up_to_date(editor)) {
+					// merged it would undo what it did not get yet. it gets that first and sends
+					// its buffer again after
+					std::cout << "full buffer of an editor that is behind, asking again after its fetch\n";
+					editor.want_full_buffer = true;
+					vim::sendFetchNow(&editor.socket);
 					continue;
 				}
+				editor.want_full_buffer = false;
+
+				ctx.registry.write(editor.document, editor.id, [&ctx, new_text = std::string{lines.value()}](const std::shared_ptr<doc_registry::Document>& document) {
+					auto& doc = document->doc;
 
-				std::string new_text;
-				for (size_t i = 0; i < j_lines.size(); i++) {
-					if (!j_lines.at(i).empty()) {
-						new_text += static_cast<std::string>(j_lines.at(i));
+					//std::cout << "new_text:\n" << new_text << "\n";
+					//std::cout << "old_text:\n" << doc.getText() << "\n";
+					std::cout << "doc state: ";
+					for (const auto& e : doc.state.list) {
+						std::cout << e << " ";
 					}
+					std::cout << "\n";
 
-					if (i+1 < j_lines.size()) {
-						new_text += "\n";
+					const auto ops = doc.merge(new_text);
+					if (!ops.empty()) {
+						std::cout << "ops.size: " << ops.size() << "\n";
+						std::cout << "ops: ";
+						for (const auto& op : ops) {
+							std::cout << op << " ";
+						}
+						std::cout << "\n";
 					}
-				}
+					assert(doc.getText() == new_text);
 
-				//std::cout << "new_text:\n" << new_text << "\n";
-				//std::cout << "old_text:\n" << doc.getText() << "\n";
-				std::cout << "doc state: ";
-				for (const auto& e : doc.state.list) {
-					std::cout << e << " ";
+					return addLocalOps(ctx, *document, ops);
+				});
+			} else if (command == "line_changes") { // vim is sending only the changed lines
+				if (!j_command.count("changes") || !j_command.at("changes").is_array()) {
+					std::cerr << "changes list not an array!\n";
+					continue;
 				}
-				std::cout << "\n";
-
-				const auto ops = doc.merge(new_text);
-				if (!ops.empty()) {
-					std::cout << "ops.size: " << ops.size() << "\n";
-					std::cout << "ops: ";
-					for (const auto& op : ops) {
-						std::cout << op << " ";
+
+				// [first line, end line, lines joined], merged on the worker
+				std::vector<dirty_lines::LineChange> line_changes;
+				for (const auto& j_change : j_command.at("changes")) {
+					// [first line, end line, [new lines]]
+					if (
+						!j_change.is_array() || j_change.size() != 3 ||
+						!j_change.at(0).is_number_unsigned() || !j_change.at(1).is_number_unsigned() ||
+						!j_change.at(2).is_array()
+					) {
+						std::cerr << "invalid line change!\n";
+						editor.resync = true;
+						break;
 					}
-					std::cout << "\n";
+
+					std::string replacement;
+					for (const auto& j_line : j_change.at(2)) {
+						if (j_line.is_string()) {
+							replacement += j_line.get_ref<const std::string&>();
+						}
+						replacement += '\n';
+					}
+					line_changes.push_back({j_change.at(0), j_change.at(1), std::move(replacement)});
 				}
-				assert(doc.getText() == new_text);
 
-				if (!ops.empty()) {
-					// TODO: make something less locky
-					// TODO: make method
-					{
-						std::lock_guard mg{ctx.command_lists_mutex};
-						//assert(ctx.command_lists.size() == ctx.command_frontier.size());
+				if (line_changes.empty() || editor.resync) {
+					continue; // or its full buffer has them
+				}
 
-						auto& local_command_list = ctx.command_lists[ctx.agent];
+				if (!up_to_date(editor)) {
+					// in its lines, the doc has more. moved to the lines of the doc they go on top
+					bool rebased = !editor.send_full_text && !editor.open_ticket.has_value();
+					if (rebased) {
+						epoch::Guard guard {ctx.registry.views, view_reader};
+						const auto* doc_view = editor.document->view.load();
+						rebased =
+							doc_view != nullptr && doc_view->ticket == editor.seen_ticket &&
+							dirty_lines::rebaseLineChanges(*doc_view, editor.dirty, line_changes)
+						;
+					}
 
-						uint64_t seq {0};
-						if (ctx.command_frontier.count(ctx.agent)) { // get last own seq
-							seq = ctx.command_frontier[ctx.agent] + 1;
-						}
+					if (!rebased) {
+						// lines it did not get yet, the doc wins those
+						std::cerr << "line changes of an editor that is behind do not fit, dropping them\n";
+						editor.dirty.clear();
+						editor.send_full_text = true;
+						vim::sendFetchNow(&editor.socket);
+						continue;
+					}
+				}
 
-						// 5 can be too much
-						// 3 seems save, but is slow
-						const size_t max_ops {4}; // limit ops per command so we can fit them into packets
-						size_t check_op_count {0};
-						for (size_t i = 0; i < ops.size(); seq++) {
-							// TODO: check
-							//size_t chunk_size = std::min(max_ops, ops.size()-i);
-							//std::vector<Doc::Op> tmp_ops {ops.cbegin()+i, ops.cbegin()+i+chunk_size};
-							std::vector<Doc::Op> tmp_ops;
-							for (auto it = ops.cbegin()+i; it != ops.cend() && tmp_ops.size() <= max_ops; it++) {
-								tmp_ops.push_back(*it);
-							}
-
-							assert(!tmp_ops.empty());
-
-							local_command_list.emplace(seq, Command{
-								ctx.agent,
-								seq,
-								tmp_ops
-							});
-							ctx.command_frontier[ctx.agent] = seq;
-
-							i += tmp_ops.size();
-							check_op_count += tmp_ops.size();
+				ctx.registry.write(editor.document, editor.id, [&ctx, line_changes = std::move(line_changes)](const std::shared_ptr<doc_registry::Document>& document) {
+					bool failed {false};
+					std::vector<Doc::Op> ops;
+					for (const auto& [first_line, end_line, replacement] : line_changes) {
+						const auto change_ops = mergeLines(document->doc, first_line, end_line, replacement);
+						if (!change_ops.has_value()) {
+							std::cerr << "line change " << first_line << "-" << end_line << " does not fit the doc!\n";
+							failed = true;
+							break;
 						}
-						assert(check_op_count == ops.size());
+						ops.insert(ops.end(), change_ops.value().cbegin(), change_ops.value().cend());
 					}
-					ctx.should_gossip_local.store(true);
-				}
+
+					if (!ops.empty()) {
+						std::cout << "ops.size: " << ops.size() << "\n";
+					}
+
+					auto change = addLocalOps(ctx, *document, ops);
+					change.failed = failed; // the editor resyncs
+					return change;
+				});
 			} else {
 				std::cout << "unknown command '" << command << "'\n";
 			}
 		}
+
+		return true;
+	};
+
+	// the messages an editor sent, until one has to wait. its edits are in its lines, those only map to
+	// the doc once every write posted before them (of the others too) is in its dirty ranges.
+	// returns false if the editor should be dropped
+	const auto handle_messages = [&](Editor& editor) -> bool {
+		// json arrays separated by newlines, the read might have ended in the middle of one
+		while (!editor.document || editor.seen_ticket >= editor.document->tickets) {
+			const auto message = editor.recv_buffer.nextMessage();
+			if (!message.has_value()) {
+				break;
+			}
+			if (!handle_message(editor, message.value())) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	event_loop::Loop loop;
+	if (!loop.valid() || !ctx.main_wake.valid() || !ctx.sync_wake.valid()) {
+		ctx.should_quit.store(true);
+		ctx.sync_wake.notify();
+		std::cerr << "failed to create event loop\n";
+		zed_net_socket_close(&listen_socket);
+		zed_net_shutdown();
+		sync_thread.join(); // wait for thread
+		return -1;
 	}
 
-	std::cout << "shutting down\n";
+	bool quit {false};
 
-	ctx.should_quit.store(true);
+	const auto close_editor = [&](int fd) {
+		loop.remove(fd);
+		zed_net_socket_close(&editors.at(fd).socket);
+		if (const auto& document = editors.at(fd).document; document) {
+			// can be unloaded once it is idle
+			ctx.registry.release(document);
+		}
+		editors.erase(fd);
 
-	tox_thread.join(); // wait for thread
+		if (editors.empty()) {
+			// the last one left, like before with a single vim
+			quit = true;
+		}
+	};
 
-	zed_net_socket_close(&remote_socket);
-	zed_net_socket_close(&listen_socket);
-	zed_net_shutdown();
-	return 0;
-}
+	loop.add(listen_socket.handle, EPOLLIN, [&](uint32_t) {
+		zed_net_socket_t remote_socket;
+		zed_net_address_t remote_address;
+		if (zed_net_tcp_accept(&listen_socket, &remote_socket, &remote_address) != 0) {
+			std::cerr << "zed_net_tcp_accept failed: " << zed_net_get_error() << "\n";
+			return;
+		}
 
-namespace tox {
+		std::cout << "got connection from " << zed_net_host_to_str(remote_address.host) << ":" << remote_address.port << "\n";
 
-static void log_cb(Tox*, TOX_LOG_LEVEL level, const char *file, uint32_t line, const char *func, const char *message, void *) {
-	std::cerr << "TOX " << level << " " << file << ":" << line << "(" << func << ") " << message << "\n";
-}
+		const int fd = remote_socket.handle;
+		auto& editor = editors[fd];
+		editor.id = next_editor_id++;
+		editor.socket = remote_socket;
 
-static void self_connection_status_cb(Tox*, TOX_CONNECTION connection_status, void *) {
-	std::cout << "self_connection_status_cb " << connection_status << "\n";
-}
+		// it tells us its doc first thing after the setup
+		std::cout << "sending setup\n";
+		vim::sendSetup(&editor.socket);
 
-static void handle_pkg(SharedContext& ctx, const uint8_t* data, size_t length, uint32_t peer_id) {
-	if (length < 2) {
-		std::cerr << "got too short pkg " << length << "\n";
-		return;
-	}
+		loop.add(fd, EPOLLIN, [&, fd](uint32_t) {
+			auto& editor = editors.at(fd);
 
-	pkg::PKGID pkg_id = static_cast<pkg::PKGID>(data[0]);
-	const auto p_j = nlohmann::json::from_msgpack(data+1, data+1 + (length-1), true, false);
-	if (p_j.is_discarded()) {
-		std::cerr << "got invalid msgpack for " << pkg_id << "\n";
-		return;
-	}
+			// grows for big buffers, a single message over the max is not from vim
+			if (!editor.recv_buffer.reserve(c_min_recv_size)) {
+				std::cerr << "message too big, dropping editor\n";
+				close_editor(fd);
+				return;
+			}
+
+			const int64_t bytes_received = zed_net_tcp_socket_receive(&editor.socket, editor.recv_buffer.writeData(), static_cast<int>(editor.recv_buffer.writeSize()));
+			if (bytes_received < 0) {
+				std::cerr << "zed_net_tcp_socket_receive failed: " << zed_net_get_error() << "\n";
+				close_editor(fd);
+				return;
+			} else if (bytes_received == 0) {
+				std::cout << "got 0 bytes?\n";
+				close_editor(fd); // connection closed
+				return;
+			}
 
-	// TODO: keep track of time/connected disconnected
-	ctx.tox_seen_peers.emplace(peer_id);
+			std::cout << "got " << bytes_received << " bytes\n";
+			editor.recv_buffer.commit(static_cast<size_t>(bytes_received));
 
-	std::cout << "pkg " << pkg_id << " j:" << p_j.dump() << "\n";
+			if (!handle_messages(editor)) {
+				close_editor(fd);
+			}
+		});
+	});
 
-	switch (pkg_id) {
-		case pkg::PKGID::FRONTIER: {
-			pkg::Frontier pkg = p_j;
+	// a worker published a view, or remote changes are staged
+	loop.add(ctx.main_wake.fd, EPOLLIN, [&](uint32_t) {
+		ctx.main_wake.drain();
 
-			if (!ctx.heard_gossip.count(pkg.agent) || ctx.heard_gossip[pkg.agent] < pkg.seq) {
-				ctx.heard_gossip[pkg.agent] = pkg.seq;
-				std::cout << "new seq " << pkg.seq << " from " << pkg.agent << "\n";
+		std::unordered_set<doc_registry::Document*> documents;
+		for (auto& [fd, editor] : editors) {
+			if (editor.document) {
+				documents.emplace(editor.document.get());
 			}
-			break;
 		}
-		case pkg::PKGID::REQUEST_FRONTIER: {
-			pkg::RequestFrontier pkg = p_j;
-			ctx.requested_frontier.emplace(peer_id, pkg.agent);
-			break;
-		}
-		case pkg::PKGID::COMMAND: {
-			pkg::Command pkg = p_j;
-
-			// push to buffer, if not in buffer
-			if (!ctx.buffer[pkg.agent].count(pkg.seq)) {
-				{ // also check staging frontier, if its not a dup
-					std::lock_guard lg {ctx.staging_mutex};
-					if (ctx.staging_frontier.count(pkg.agent) && pkg.seq <= ctx.staging_frontier.at(pkg.agent)) {
-						break; // allready in staging or master
+
+		for (auto* document : documents) {
+			take_changes(*document);
+
+			// get the editors to fetch now instead of on their next poll
+			if (document->should_fetch.exchange(false)) {
+				for (auto& [fd, editor] : editors) {
+					if (editor.document.get() == document) {
+						vim::sendFetchNow(&editor.socket);
 					}
 				}
-				ctx.buffer[pkg.agent].emplace(pkg.seq, pkg);
-				std::cout << "pushed to buffer " << pkg.seq << " from " << pkg.agent << "\n";
 			}
-			// TODO: notify something?
-			break;
 		}
-		case pkg::PKGID::REQUEST_COMMAND: {
-			pkg::RequestCommand pkg = p_j;
-			// TODO: this can lead to double requests
-			// TODO: maybe settle for single seq requests for now?, since they are indivitual packets anyway
-			ctx.requested_commands[peer_id] = pkg;
-			break;
+
+		// the ones that waited for the writes
+		std::vector<int> dropped;
+		for (auto& [fd, editor] : editors) {
+			if (!handle_messages(editor)) {
+				dropped.push_back(fd);
+			}
+		}
+		for (const int fd : dropped) {
+			close_editor(fd);
 		}
-		default:
-			std::cerr << "unknown pkg id " << pkg_id << "\n";
+	});
+
+	while (!quit) {
+		if (loop.wait(-1) < 0) {
+			std::cerr << "epoll_wait failed\n";
 			break;
+		}
+	}
+
+	for (auto& [fd, editor] : editors) {
+		zed_net_socket_close(&editor.socket);
 	}
+
+	std::cout << "shutting down\n";
+
+	ctx.should_quit.store(true);
+	ctx.sync_wake.notify();
+	ctx.sync_wake.notify();
+
+	sync_thread.join(); // wait for thread
+
+	// everything to disk, so the next start does not have to apply it all again
+	ctx.registry.unloadAll();
+
+	zed_net_socket_close(&listen_socket);
+	zed_net_shutdown();
+	return 0;
+}
+
+namespace tox {
+
+static void log_cb(Tox*, TOX_LOG_LEVEL level, const char *file, uint32_t line, const char *func, const char *message, void *) {
+	std::cerr << "TOX " << level << " " << file << ":" << line << "(" << func << ") " << message << "\n";
+}
+
+static void self_connection_status_cb(Tox*, TOX_CONNECTION connection_status, void *) {
+	std::cout << "self_connection_status_cb " << connection_status << "\n";
 }
 
 static void group_custom_packet_cb(Tox*, uint32_t group_number, uint32_t peer_id, const uint8_t* data, size_t length, void* user_data) {
 	std::cout << "group_custom_packet_cb\n";
 	SharedContext& ctx = *static_cast<SharedContext*>(user_data);
 	assert(ctx.tox_group_number == group_number);
-	handle_pkg(ctx, data, length, peer_id);
+	ctx.registry.handlePkg(data, length, peer_id);
 }
 
 static void group_custom_private_packet_cb(Tox*, uint32_t group_number, uint32_t peer_id, const uint8_t* data, size_t length, void* user_data) {
 	std::cout << "group_custom_private_packet_cb\n";
 	SharedContext& ctx = *static_cast<SharedContext*>(user_data);
 	assert(ctx.tox_group_number == group_number);
-	handle_pkg(ctx, data, length, peer_id);
+	ctx.registry.handlePkg(data, length, peer_id);
 }
 
 }
@@ -0,0 +1,840 @@
+#include <green_crdt/v0/text_document.hpp>
+
+#include "./line_merge.hpp"
+#include "./line_buffer.hpp"
+#include "./vim_message.hpp"
+#include "./doc_view.hpp"
+#include "./dirty_lines.hpp"
+#include "./apply_scheduler.hpp"
+#include "./command_log.hpp"
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <cassert>
+#include <variant>
+#include <array>
+#include <filesystem>
+#include <fstream>
+
+// single letter agent, for testing only
+using Agent = char;
+using Doc = GreenCRDT::V0::TextDocument<Agent>;
+using Op = Doc::Op;
+using ListType = Doc::ListType;
+
+using Rng = std::ranlux24_base;
+
+// the text split like mergeLines sees it, every line ends in a '\n' (the last one in the virtual one)
+static std::vector<std::string> toLines(std::string_view text) {
+	std::vector<std::string> lines {""};
+	for (const char c : text) {
+		lines.back() += c;
+		if (c == '\n') {
+			lines.emplace_back();
+		}
+	}
+	lines.back() += '\n';
+	return lines;
+}
+
+static std::string fromLines(const std::vector<std::string>& lines) {
+	std::string text;
+	for (const auto& line : lines) {
+		text += line;
+	}
+	if (!text.empty()) {
+		text.pop_back(); // the virtual one
+	}
+	return text;
+}
+
+static std::string randomText(Rng& rng, size_t max_size, std::string_view chars) {
+	std::string text;
+	const size_t size = rng() % (max_size + 1);
+	for (size_t i = 0; i < size; i++) {
+		text += chars[rng() % chars.size()];
+	}
+	return text;
+}
+
+static void applyOps(Doc& doc, const std::vector<Op>& ops) {
+	for (const auto& op : ops) {
+		if (std::holds_alternative<ListType::OpAdd>(op)) {
+			const auto& add_op = std::get<ListType::OpAdd>(op);
+			const bool r = doc.state.add(add_op.id, add_op.value, add_op.parent_left, add_op.parent_right);
+			assert(r);
+		} else if (std::holds_alternative<ListType::OpDel>(op)) {
+			const auto& del_op = std::get<ListType::OpDel>(op);
+			doc.state.del(del_op.id); // false if both sides deleted it, that is fine
+		}
+	}
+}
+
+// random line changes against a vector of lines, the ops have to get a replica to the same text
+void testMergeLines1(size_t seed) {
+	Rng rng(seed);
+
+	Doc doc;
+	doc.local_agent = 'A';
+	doc.addText(std::nullopt, std::nullopt, randomText(rng, 20, "ab\n"));
+
+	// only gets the ops
+	Doc replica = doc;
+	replica.local_agent = 'B';
+	assert(replica.getText() == doc.getText());
+
+	for (size_t step = 0; step < 50; step++) {
+		auto lines = toLines(doc.getText());
+
+		// sometimes out of range, one past the last line is an append
+		size_t first_line = 1 + rng() % (lines.size() + 2);
+		size_t end_line = first_line + rng() % 3;
+		if (rng() % 8 == 0) {
+			first_line = rng() % 2; // 0 is invalid
+			end_line = first_line + rng() % (lines.size() + 2);
+		}
+
+		std::string replacement;
+		for (size_t i = rng() % 4; i > 0; i--) {
+			replacement += randomText(rng, 3, "abc") + '\n';
+		}
+		const bool bad_replacement = rng() % 16 == 0;
+		if (bad_replacement) {
+			replacement += 'x'; // not ending in a '\n'
+		}
+
+		const std::string old_text = doc.getText();
+		const auto ops = mergeLines(doc, first_line, end_line, replacement);
+
+		const bool valid =
+			!bad_replacement &&
+			first_line >= 1 && first_line <= end_line &&
+			end_line <= lines.size() + 1 &&
+			(first_line <= lines.size() || end_line == first_line)
+		;
+		if (!valid) {
+			assert(!ops.has_value());
+			assert(doc.getText() == old_text);
+			continue;
+		}
+		assert(ops.has_value());
+
+		lines.erase(lines.begin() + (first_line - 1), lines.begin() + std::min(end_line - 1, lines.size()));
+		const auto new_lines = replacement.empty() ? std::vector<std::string>{} : toLines(std::string_view{replacement}.substr(0, replacement.size() - 1));
+		lines.insert(lines.begin() + (first_line - 1), new_lines.cbegin(), new_lines.cend());
+		const std::string expected_text = fromLines(lines);
+
+		if (doc.getText() != expected_text) {
+			std::cerr << "lines [" << first_line << ", " << end_line << ") of '" << old_text << "' to '" << replacement << "'\n";
+			std::cerr << "expected '" << expected_text << "' got '" << doc.getText() << "'\n";
+		}
+		assert(doc.getText() == expected_text);
+
+		applyOps(replica, ops.value());
+		assert(replica.getText() == expected_text);
+		assert(replica.state.list.size() == doc.state.list.size());
+	}
+}
+
+void testMergeLinesEdges(void) {
+	{ // into an empty doc, line 1 exists and is empty
+		Doc doc;
+		doc.local_agent = 'A';
+		assert(mergeLines(doc, 1, 2, "a\nb\n").has_value());
+		assert(doc.getText() == "a\nb");
+	}
+	{ // appending past the last line, the virtual '\n' becomes real
+		Doc doc;
+		doc.local_agent = 'A';
+		doc.addText(std::nullopt, std::nullopt, "a");
+		assert(mergeLines(doc, 2, 2, "b\n").has_value());
+		assert(doc.getText() == "a\nb");
+		assert(!mergeLines(doc, 4, 4, "c\n").has_value());
+		assert(!mergeLines(doc, 3, 4, "c\n").has_value());
+	}
+	{ // deleting the last lines takes the '\n' before them
+		Doc doc;
+		doc.local_agent = 'A';
+		doc.addText(std::nullopt, std::nullopt, "a\nb\nc");
+		assert(mergeLines(doc, 2, 4, "").has_value());
+		assert(doc.getText() == "a");
+		assert(mergeLines(doc, 1, 2, "").has_value());
+		assert(doc.getText() == "");
+		assert(mergeLines(doc, 1, 2, "").has_value()); // already empty
+		assert(doc.getText() == "");
+	}
+	{ // tombstones in and around the range
+		Doc doc;
+		doc.local_agent = 'A';
+		doc.addText(std::nullopt, std::nullopt, "a\nbxx\nc");
+		doc.delRange(doc.state.list.at(3).id, doc.state.list.at(5).id); // "xx"
+		assert(doc.getText() == "a\nb\nc");
+		assert(mergeLines(doc, 2, 3, "B\n").has_value());
+		assert(doc.getText() == "a\nB\nc");
+		assert(mergeLines(doc, 3, 4, "").has_value());
+		assert(doc.getText() == "a\nB");
+		assert(mergeLines(doc, 3, 3, "c\n").has_value());
+		assert(doc.getText() == "a\nB\nc");
+	}
+}
+
+// a stream of messages cut into random reads, with a small buffer so it wraps and grows
+void testLineBuffer1(size_t seed) {
+	Rng rng(seed);
+
+	std::vector<std::string> messages;
+	std::string stream;
+	for (size_t i = rng() % 64; i > 0; i--) {
+		messages.push_back(randomText(rng, rng() % 8 == 0 ? 300 : 20, "abc"));
+		stream += messages.back() + '\n';
+	}
+
+	LineBuffer buffer {16};
+	std::vector<std::string> received;
+	size_t pos {0};
+	while (pos < stream.size()) {
+		const size_t read_size = 1 + rng() % 40;
+		assert(buffer.reserve(read_size));
+		assert(buffer.writeSize() >= read_size);
+
+		const size_t count = std::min(read_size, stream.size() - pos);
+		std::memcpy(buffer.writeData(), stream.data() + pos, count);
+		buffer.commit(count);
+		pos += count;
+
+		// not always everything, so some is still pending at the next read
+		for (size_t i = rng() % 4; i > 0; i--) {
+			const auto message = buffer.nextMessage();
+			if (!message.has_value()) {
+				break;
+			}
+			received.emplace_back(message.value());
+		}
+	}
+
+	while (const auto message = buffer.nextMessage()) {
+		received.emplace_back(message.value());
+	}
+
+	assert(received == messages);
+	assert(buffer.size() == 0);
+	assert(buffer.capacity() <= 1024); // no more than twice the longest message
+}
+
+void testLineBufferEdges(void) {
+	{ // rounded up to a power of 2
+		LineBuffer buffer {100};
+		assert(buffer.capacity() == 128);
+	}
+	{ // a partial message is not returned, and not searched again
+		LineBuffer buffer {8};
+		assert(buffer.reserve(3));
+		std::memcpy(buffer.writeData(), "abc", 3);
+		buffer.commit(3);
+		assert(!buffer.nextMessage().has_value());
+		assert(buffer._scanned == 3);
+
+		assert(buffer.reserve(2));
+		std::memcpy(buffer.writeData(), "\n\n", 2);
+		buffer.commit(2);
+		assert(buffer.nextMessage() == "abc");
+		assert(buffer.nextMessage() == ""); // empty message
+		assert(!buffer.nextMessage().has_value());
+		assert(buffer.size() == 0);
+	}
+	{ // a message growing past max_capacity is garbage
+		LineBuffer buffer {16, 64};
+		while (buffer.reserve(16)) {
+			std::memset(buffer.writeData(), 'x', 16);
+			buffer.commit(16);
+			assert(!buffer.nextMessage().has_value());
+		}
+		assert(buffer.capacity() == 64);
+		assert(buffer.size() > 48);
+	}
+}
+
+// random messages, the sax parse has to give the same as the dom with the lines taken out
+void testParseMessage1(size_t seed) {
+	Rng rng(seed);
+
+	vim::Message msg; // reused, like for an editor
+
+	for (size_t step = 0; step < 20; step++) {
+		nlohmann::json j_commands = nlohmann::json::array();
+		std::vector<std::optional<std::string>> expected_lines;
+		for (size_t i = rng() % 4; i > 0; i--) {
+			nlohmann::json j_command {{"cmd", randomText(rng, 8, "abc")}};
+
+			if (rng() % 4 != 0) {
+				nlohmann::json j_lines = nlohmann::json::array();
+				std::string joined;
+				for (size_t k = rng() % 4; k > 0; k--) {
+					// needs escaping in json
+					j_lines.push_back(randomText(rng, 6, "a\"\\\t"));
+				}
+				for (size_t k = 0; k < j_lines.size(); k++) {
+					if (k != 0) {
+						joined += '\n';
+					}
+					joined += j_lines[k].get_ref<const std::string&>();
+				}
+				j_command["lines"] = std::move(j_lines);
+				expected_lines.push_back(std::move(joined));
+			} else {
+				expected_lines.push_back(std::nullopt);
+			}
+
+			if (rng() % 4 == 0) {
+				// not the lines of a command
+				j_command["x"] = {{"lines", {1, 2}}};
+			}
+
+			j_commands.push_back(std::move(j_command));
+		}
+		const nlohmann::json j_full = nlohmann::json::array({rng() % 1000, j_commands});
+
+		assert(vim::parseMessage(j_full.dump(), msg) == vim::ParseResult::ok);
+
+		nlohmann::json j_expected = j_full;
+		for (auto& j_command : j_expected.at(1)) {
+			j_command.erase("lines");
+		}
+		assert(msg.j == j_expected);
+
+		for (size_t i = 0; i < expected_lines.size(); i++) {
+			assert(msg.lines(i) == expected_lines[i]);
+		}
+		assert(!msg.lines(expected_lines.size()).has_value());
+	}
+}
+
+void testParseMessageEdges(void) {
+	vim::Message msg;
+
+	// null is an empty line, the lines are joined without a trailing '\n'
+	assert(vim::parseMessage(R"([1,[{"cmd":"full_buffer","lines":["a",null,"b"]}]])", msg) == vim::ParseResult::ok);
+	assert(msg.j == nlohmann::json::parse(R"([1,[{"cmd":"full_buffer"}]])"));
+	assert(msg.lines(0) == "a\n\nb");
+
+	// an empty list is one empty line, there is no way to send none
+	assert(vim::parseMessage(R"([2,[{"cmd":"full_buffer","lines":[]}]])", msg) == vim::ParseResult::ok);
+	assert(msg.lines(0) == "");
+
+	// not a list, stays in the json for the caller to complain about
+	assert(vim::parseMessage(R"([3,[{"cmd":"full_buffer","lines":"a"}]])", msg) == vim::ParseResult::ok);
+	assert(msg.j.at(1).at(0).at("lines") == "a");
+	assert(!msg.lines(0).has_value());
+
+	// outside of a command
+	assert(vim::parseMessage(R"({"lines":[1]})", msg) == vim::ParseResult::ok);
+	assert(msg.j.at("lines") == nlohmann::json::array({1}));
+	assert(msg.lines_ranges.empty());
+
+	assert(vim::parseMessage(R"([4,[{"cmd":"full_buffer","lines":["a",1]}]])", msg) == vim::ParseResult::invalid_lines);
+	assert(vim::parseMessage(R"([5,[{"cmd":"full_buffer","lines":[["a"]]}]])", msg) == vim::ParseResult::invalid_lines);
+	assert(vim::parseMessage(R"([6,[{"cmd":"full_buffer","lines":[{}]}]])", msg) == vim::ParseResult::invalid_lines);
+
+	assert(vim::parseMessage(R"([7,[{"cmd":"full_buffer","lines":["a")", msg) == vim::ParseResult::invalid_json);
+	assert(vim::parseMessage("", msg) == vim::ParseResult::invalid_json);
+
+	// nothing left over from the failed ones
+	assert(vim::parseMessage(R"([8,[{"cmd":"a"},{"cmd":"b","lines":["c"]}]])", msg) == vim::ParseResult::ok);
+	assert(msg.lines_ranges.size() == 1);
+	assert(!msg.lines(0).has_value());
+	assert(msg.lines(1) == "c");
+}
+
+using View = doc_view::View<ListType>;
+
+// same entries in the same order, and the per chunk counts add up
+static void assertSameView(const View& view, const View& built) {
+	assert(view.size() == built.size());
+	assert(view.starts.size() == view.chunks.size() + 1 || view.chunks.empty());
+	for (size_t i = 0; i < view.size(); i++) {
+		assert(view[i].id == built[i].id);
+		assert(view[i].value == built[i].value);
+	}
+
+	for (size_t chunk_i = 0; chunk_i < view.chunks.size(); chunk_i++) {
+		const auto& chunk = *view.chunks[chunk_i];
+		assert(!chunk.entries.empty());
+		assert(view.starts[chunk_i] + chunk.entries.size() == view.starts[chunk_i + 1]);
+
+		size_t newlines {0};
+		size_t visible {0};
+		for (const auto& entry : chunk.entries) {
+			newlines += entry.value == '\n';
+			visible += entry.value.has_value();
+		}
+		assert(chunk.newlines == newlines);
+		assert(chunk.visible == visible);
+	}
+
+	assert(view.getText() == built.getText());
+	for (size_t line = 1; line < 8; line++) {
+		assert(view.lineStart(line) == built.lineStart(line));
+	}
+	for (size_t idx = 0; idx <= view.size(); idx += 97) {
+		assert(view.newlinesBefore(idx) == built.newlinesBefore(idx));
+	}
+}
+
+// random batches of local and remote edits, a view updated from the one before has to
+// look like one built from scratch
+void testViewUpdate1(size_t seed) {
+	Rng rng(seed);
+
+	Doc doc;
+	doc.local_agent = 'A';
+	doc.addText(std::nullopt, std::nullopt, randomText(rng, 2500, "ab\n"));
+
+	Doc other = doc;
+	other.local_agent = 'B';
+
+	auto view = View::build(doc.state);
+
+	for (size_t step = 0; step < 10; step++) {
+		std::vector<Op> ops;
+		const auto edit = [&rng](Doc& d, std::vector<Op>& out) {
+			const auto& list = d.state.list;
+			const size_t idx = list.empty() ? 0 : rng() % (list.size() + 1);
+			std::vector<Op> new_ops;
+			if (rng() % 3 == 0 && !list.empty()) {
+				const size_t end_idx = std::min(idx + rng() % 40, list.size());
+				new_ops = d.delRange(
+					idx < list.size() ? std::make_optional(list[idx].id) : std::nullopt,
+					end_idx < list.size() ? std::make_optional(list[end_idx].id) : std::nullopt
+				);
+			} else {
+				new_ops = d.addText(
+					idx == 0 ? std::nullopt : std::make_optional(list[idx-1].id),
+					idx == list.size() ? std::nullopt : std::make_optional(list[idx].id),
+					randomText(rng, rng() % 8 == 0 ? 600 : 20, "ab\n")
+				);
+			}
+			out.insert(out.end(), new_ops.cbegin(), new_ops.cend());
+		};
+
+		for (size_t i = rng() % 4; i > 0; i--) {
+			edit(doc, ops);
+		}
+
+		// concurrent ones from the other side, so new entries land between old ones of other agents
+		std::vector<Op> other_ops;
+		for (size_t i = rng() % 3; i > 0; i--) {
+			edit(other, other_ops);
+		}
+		applyOps(doc, other_ops);
+		applyOps(other, ops);
+		ops.insert(ops.end(), other_ops.cbegin(), other_ops.cend());
+
+		std::vector<ListType::ListID> changed_ids;
+		for (const auto& op : ops) {
+			if (std::holds_alternative<ListType::OpAdd>(op)) {
+				changed_ids.push_back(std::get<ListType::OpAdd>(op).id);
+			} else {
+				changed_ids.push_back(std::get<ListType::OpDel>(op).id);
+			}
+		}
+		if (rng() % 4 == 0 && !doc.state.list.empty()) {
+			// more than changed is fine
+			changed_ids.push_back(doc.state.list[rng() % doc.state.list.size()].id);
+		}
+
+		auto updated = View::update(*view, doc.state, changed_ids);
+		const auto built = View::build(doc.state);
+		assertSameView(*updated, *built);
+
+		// a small change leaves most chunks shared
+		if (changed_ids.size() < 8 && view->chunks.size() > 4) {
+			size_t shared {0};
+			for (const auto& chunk : updated->chunks) {
+				shared += std::find(view->chunks.cbegin(), view->chunks.cend(), chunk) != view->chunks.cend();
+			}
+			assert(shared + changed_ids.size() * 2 >= view->chunks.size());
+		}
+
+		view = std::move(updated);
+	}
+
+	assert(doc.getText() == other.getText());
+}
+
+// an editor of the daemon (test2), what vim has and what it did not get yet
+struct SimEditor {
+	std::vector<std::string> lines; // like vim, without the '\n'
+	dirty_lines::DirtyRanges dirty;
+};
+
+static std::vector<std::string> splitLines(std::string_view text) {
+	std::vector<std::string> lines {""};
+	for (const char c : text) {
+		if (c == '\n') {
+			lines.emplace_back();
+		} else {
+			lines.back() += c;
+		}
+	}
+	return lines;
+}
+
+static std::string joinLines(const std::vector<std::string>& lines) {
+	std::string text;
+	for (const auto& line : lines) {
+		text += line;
+		text += '\n';
+	}
+	text.pop_back();
+	return text;
+}
+
+// like vim does with the changes of a fetch, or the user with an edit
+static void replaceLines(std::vector<std::string>& lines, size_t first_line, size_t end_line, const std::vector<std::string>& new_lines) {
+	assert(first_line >= 1 && first_line <= end_line && end_line <= lines.size() + 1);
+	lines.erase(lines.begin() + static_cast<std::ptrdiff_t>(first_line - 1), lines.begin() + static_cast<std::ptrdiff_t>(end_line - 1));
+	lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(first_line - 1), new_lines.cbegin(), new_lines.cend());
+}
+
+// two editors of one doc, the first edits the lines above a marker line, the second the ones below.
+// they send their edits before they fetched what the other one sent, in the lines they have. the edits
+// have to land on the lines they were made on, and a fetch must not touch what the editor did
+void testTwoEditors1(size_t seed) {
+	Rng rng(seed);
+
+	const std::string marker {"----"};
+	std::string text;
+	for (size_t i = rng() % 6; i > 0; i--) {
+		text += randomText(rng, 6, "ab") + "\n";
+	}
+	text += marker;
+	for (size_t i = rng() % 6; i > 0; i--) {
+		text += "\n" + randomText(rng, 6, "ab");
+	}
+
+	Doc doc;
+	doc.local_agent = 'A';
+	doc.addText(std::nullopt, std::nullopt, text);
+	auto view = View::build(doc.state);
+
+	std::array<SimEditor, 2> editors;
+	for (auto& editor : editors) {
+		editor.lines = splitLines(text);
+	}
+
+	// [first, end) 1 based, the lines editor e may touch
+	const auto ownLines = [&marker](const SimEditor& editor, size_t e) -> std::pair<size_t, size_t> {
+		const size_t marker_line = static_cast<size_t>(std::find(editor.lines.cbegin(), editor.lines.cend(), marker) - editor.lines.cbegin()) + 1;
+		assert(marker_line <= editor.lines.size());
+		return e == 0 ? std::make_pair(size_t{1}, marker_line) : std::make_pair(marker_line + 1, editor.lines.size() + 1);
+	};
+
+	const auto randomChange = [&rng](SimEditor& editor, size_t first, size_t end) {
+		const size_t first_line = first + rng() % (end - first + 1);
+		const size_t end_line = first_line + rng() % std::min<size_t>(end - first_line + 1, 3);
+		std::vector<std::string> new_lines;
+		for (size_t i = rng() % 3; i > 0; i--) {
+			new_lines.push_back(randomText(rng, 6, "cd"));
+		}
+
+		dirty_lines::LineChange change {first_line, end_line, {}};
+		for (const auto& line : new_lines) {
+			change.replacement += line + "\n";
+		}
+		replaceLines(editor.lines, first_line, end_line, new_lines);
+		return change;
+	};
+
+	// the worker applies it and publishes a view, the main thread moves the dirty ranges of both
+	const auto write = [&](size_t writer, const std::vector<dirty_lines::LineChange>& changes) {
+		std::vector<ListType::ListID> ids;
+		for (const auto& change : changes) {
+			const auto ops = mergeLines(doc, change.first_line, change.end_line, change.replacement);
+			assert(ops.has_value());
+			for (const auto& op : ops.value()) {
+				ids.push_back(std::visit([](const auto& o) { return o.id; }, op));
+			}
+		}
+
+		const auto changed = View::findIdxs(doc.state, ids);
+		auto next = View::update(*view, doc.state, changed);
+		const std::optional<std::vector<View::Located>> located = View::locate(*view, *next, changed);
+		view = std::move(next);
+
+		for (size_t e = 0; e < editors.size(); e++) {
+			const bool r = dirty_lines::markDirty(editors[e].dirty, located, e == writer);
+			assert(r);
+		}
+	};
+
+	const auto send = [&](size_t e) {
+		auto& editor = editors[e];
+		const auto [first, end] = ownLines(editor, e);
+
+		// vim sends what piled up bottom up, in the lines from before them
+		std::vector<dirty_lines::LineChange> changes {randomChange(editor, first, end)};
+		if (rng() % 3 == 0 && changes.front().first_line > first) {
+			changes.push_back(randomChange(editor, first, changes.front().first_line - 1));
+		}
+
+		if (!editor.dirty.empty()) {
+			const bool r = dirty_lines::rebaseLineChanges(*view, editor.dirty, changes);
+			assert(r); // not the lines of the other one
+		}
+		write(e, changes);
+	};
+
+	const auto fetch = [&](size_t e) {
+		auto& editor = editors[e];
+		const auto [first, end] = ownLines(editor, e);
+		const std::vector<std::string> own(editor.lines.cbegin() + static_cast<std::ptrdiff_t>(first - 1), editor.lines.cbegin() + static_cast<std::ptrdiff_t>(end - 1));
+
+		const auto delta = dirty_lines::dirtyLines(*view, editor.dirty, static_cast<int64_t>(editor.lines.size()));
+		assert(delta.has_value() == !editor.dirty.empty());
+		if (delta.has_value()) {
+			for (const auto& j_change : delta.value()) {
+				replaceLines(editor.lines, j_change.at(0), j_change.at(1), j_change.at(2).get<std::vector<std::string>>());
+			}
+		}
+		editor.dirty.clear();
+		assert(joinLines(editor.lines) == doc.getText());
+
+		const auto [new_first, new_end] = ownLines(editor, e);
+		assert(std::equal(own.cbegin(), own.cend(), editor.lines.cbegin() + static_cast<std::ptrdiff_t>(new_first - 1), editor.lines.cbegin() + static_cast<std::ptrdiff_t>(new_end - 1)));
+	};
+
+	for (size_t step = 0; step < 40; step++) {
+		const size_t e = rng() % 2;
+		if (rng() % 3 == 0) {
+			fetch(e);
+		} else {
+			send(e);
+		}
+	}
+	fetch(0);
+	fetch(1);
+	assert(editors[0].lines == editors[1].lines);
+}
+
+// edits of both on the same line, the one that did not get the other's can not go on top
+void testTwoEditorsSameLine(void) {
+	Doc doc;
+	doc.local_agent = 'A';
+	doc.addText(std::nullopt, std::nullopt, "a\nb\nc");
+	auto view = View::build(doc.state);
+
+	dirty_lines::DirtyRanges dirty;
+	const auto ops = mergeLines(doc, 2, 3, "B\nB\n");
+	assert(ops.has_value());
+	std::vector<ListType::ListID> ids;
+	for (const auto& op : ops.value()) {
+		ids.push_back(std::visit([](const auto& o) { return o.id; }, op));
+	}
+	const auto changed = View::findIdxs(doc.state, ids);
+	auto next = View::update(*view, doc.state, changed);
+	assert(dirty_lines::markDirty(dirty, std::make_optional(View::locate(*view, *next, changed)), false));
+	view = std::move(next);
+
+	// the same line, and a new one in the middle of the lines it did not get
+	std::vector<dirty_lines::LineChange> changes {{2, 3, "x\n"}};
+	assert(!dirty_lines::rebaseLineChanges(*view, dirty, changes));
+
+	// the line after moves down by the one that came in
+	changes = {{3, 4, "C\n"}, {1, 2, "A\n"}};
+	assert(dirty_lines::rebaseLineChanges(*view, dirty, changes));
+	assert(changes[0].first_line == 4 && changes[0].end_line == 5);
+	assert(changes[1].first_line == 1 && changes[1].end_line == 2);
+}
+
+// only the ops matter to the scheduler
+struct TestCommand {
+	std::vector<Op> ops;
+};
+
+// two agents delete the same entry, the second one is already in the doc and changes nothing
+void testSchedulerSkipped(void) {
+	using Scheduler = apply::Scheduler<Doc, Agent, TestCommand>;
+
+	Doc doc_a;
+	doc_a.local_agent = 'A';
+	const auto adds = doc_a.addText(std::nullopt, std::nullopt, "ab");
+	const ListType::OpDel del {doc_a.state.list.front().id};
+
+	Scheduler::CommandLists command_lists;
+	command_lists['A'][0] = {adds};
+	command_lists['B'][0] = {{del}};
+	command_lists['C'][0] = {{del}};
+	const Scheduler::Frontier staging_frontier {{'A', 0}, {'B', 0}, {'C', 0}};
+
+	Doc doc;
+	Scheduler scheduler;
+	Scheduler::Frontier command_frontier;
+	auto res = scheduler.run(doc, command_lists, command_frontier, staging_frontier, {});
+	assert(doc.getText() == "b");
+	assert(res.ops_applied == 3);
+	assert(res.ops_skipped == 1);
+	assert(res.applied_ids.size() == 3);
+	assert(res.changes);
+	assert(command_frontier.size() == 3);
+
+	// only the duplicate staged, nothing to publish
+	command_lists['D'][0] = {{del}};
+	res = scheduler.run(doc, command_lists, command_frontier, {{'D', 0}}, {});
+	assert(res.ops_applied == 0);
+	assert(res.ops_skipped == 1);
+	assert(res.applied_ids.empty());
+	assert(!res.changes);
+	assert(command_frontier.at('D') == 0);
+}
+
+static std::vector<std::string> readLog(const std::string& path) {
+	std::vector<std::string> records;
+	command_log::Reader reader;
+	assert(reader.open(path));
+	reader.forEach([&records](const uint8_t* data, size_t size) {
+		records.emplace_back(reinterpret_cast<const char*>(data), size);
+	});
+	return records;
+}
+
+static bool appendString(command_log::Writer& writer, std::string_view str) {
+	return writer.append(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+}
+
+// a crash while writing the header leaves less than a header, that file is still ours
+void testCommandLogTornHeader(void) {
+	const auto dir = std::filesystem::temp_directory_path() / "crdt_test3_command_log";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	const std::string path = (dir / "log").string();
+
+	for (const size_t torn_size : {size_t{1}, size_t{5}, command_log::c_magic.size(), size_t{12}, command_log::c_header_size - 1}) {
+		{
+			command_log::Writer writer;
+			assert(writer.open(path));
+			assert(appendString(writer, "old"));
+		}
+		std::filesystem::resize_file(path, torn_size);
+
+		{
+			command_log::Writer writer;
+			assert(writer.open(path));
+			assert(appendString(writer, "new"));
+		}
+		assert(std::filesystem::file_size(path) > command_log::c_header_size);
+		assert((readLog(path) == std::vector<std::string>{"new"}));
+
+		std::filesystem::remove(path);
+	}
+
+	// a full header that is not ours, or a short file that does not start like one, stays untouched
+	for (const std::string_view content : {std::string_view{"GCRDTLOX\x01\0\0\0\0\0\0\0", command_log::c_header_size}, std::string_view{"hello"}}) {
+		{
+			std::ofstream file {path, std::ios::binary | std::ios::trunc};
+			file.write(content.data(), content.size());
+		}
+
+		command_log::Writer writer;
+		assert(!writer.open(path));
+		assert(std::filesystem::file_size(path) == content.size());
+	}
+
+	std::filesystem::remove_all(dir);
+}
+
+int main(void) {
+	const size_t loops = 1'000;
+	{
+		std::cout << "testMergeLines1:\n";
+		for (size_t i = 0; i < loops; i++) {
+			testMergeLines1(1337+i);
+		}
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testMergeLinesEdges:\n";
+		testMergeLinesEdges();
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testLineBuffer1:\n";
+		for (size_t i = 0; i < loops; i++) {
+			testLineBuffer1(1337+i);
+		}
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testLineBufferEdges:\n";
+		testLineBufferEdges();
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testParseMessage1:\n";
+		for (size_t i = 0; i < loops; i++) {
+			testParseMessage1(1337+i);
+		}
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testParseMessageEdges:\n";
+		testParseMessageEdges();
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testViewUpdate1:\n";
+		for (size_t i = 0; i < loops / 20; i++) {
+			testViewUpdate1(1337+i);
+		}
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testTwoEditors1:\n";
+		for (size_t i = 0; i < loops; i++) {
+			testTwoEditors1(1337+i);
+		}
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testTwoEditorsSameLine:\n";
+		testTwoEditorsSameLine();
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testSchedulerSkipped:\n";
+		testSchedulerSkipped();
+	}
+
+	std::cout << std::string(40, '=') << "\n";
+
+	{
+		std::cout << "testCommandLogTornHeader:\n";
+		testCommandLogTornHeader();
+	}
+
+	return 0;
+}
+
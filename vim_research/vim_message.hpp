@@ -0,0 +1,230 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstdint>
+
+namespace vim {
+
+// a message from vim, [seq, [command, ...]]
+// the lines of a full_buffer can be megabytes, building a json value per line only to copy
+// them out again doubles the memory and most of the parse time. so they skip the dom and get
+// joined into text right away, everything else is a normal json value.
+struct Message {
+	nlohmann::json j; // without the "lines" of the commands
+
+	// the joined lines of all commands, reused between messages
+	std::string text;
+
+	struct LinesRange {
+		size_t command_idx;
+		size_t begin;
+		size_t end;
+	};
+	std::vector<LinesRange> lines_ranges;
+
+	void clear(void) {
+		j = nullptr;
+		text.clear(); // keeps the capacity
+		lines_ranges.clear();
+	}
+
+	// the lines of command command_idx, joined by '\n'
+	[[nodiscard]] std::optional<std::string_view> lines(size_t command_idx) const {
+		for (const auto& range : lines_ranges) {
+			if (range.command_idx == command_idx) {
+				return std::string_view{text}.substr(range.begin, range.end - range.begin);
+			}
+		}
+		return std::nullopt;
+	}
+};
+
+struct MessageSax : nlohmann::json_sax<nlohmann::json> {
+	Message& msg;
+
+	std::vector<nlohmann::json*> _stack; // open arrays and objects
+	nlohmann::json* _object_element {nullptr}; // where the value after a key goes
+
+	bool _lines_key {false}; // the next value belongs to "lines" of a command
+	bool _in_lines {false};
+	bool _first_line {true};
+
+	bool syntax_error {false};
+
+	explicit MessageSax(Message& msg_) : msg(msg_) {}
+
+	// the open object is a command, [seq, [{...}]]
+	[[nodiscard]] bool _inCommand(void) const {
+		return _stack.size() == 3
+			&& _stack[0]->is_array() && _stack[0]->size() == 2
+			&& _stack[1]->is_array()
+			&& _stack[2]->is_object()
+		;
+	}
+
+	template<typename Value>
+	nlohmann::json* _addValue(Value&& v) {
+		if (_stack.empty()) {
+			msg.j = nlohmann::json(std::forward<Value>(v));
+			return &msg.j;
+		}
+
+		if (_stack.back()->is_array()) {
+			_stack.back()->emplace_back(std::forward<Value>(v));
+			return &_stack.back()->back();
+		}
+
+		*_object_element = nlohmann::json(std::forward<Value>(v));
+		return _object_element;
+	}
+
+	bool _line(std::string_view line) {
+		if (!_first_line) {
+			msg.text += '\n';
+		}
+		msg.text += line;
+		_first_line = false;
+		return true;
+	}
+
+	bool null(void) override {
+		if (_in_lines) {
+			return _line({}); // empty line
+		}
+		_lines_key = false;
+		_addValue(nullptr);
+		return true;
+	}
+
+	bool boolean(bool val) override {
+		if (_in_lines) {
+			return false; // lines are only strings
+		}
+		_lines_key = false;
+		_addValue(val);
+		return true;
+	}
+
+	bool number_integer(number_integer_t val) override {
+		if (_in_lines) {
+			return false; // lines are only strings
+		}
+		_lines_key = false;
+		_addValue(val);
+		return true;
+	}
+
+	bool number_unsigned(number_unsigned_t val) override {
+		if (_in_lines) {
+			return false; // lines are only strings
+		}
+		_lines_key = false;
+		_addValue(val);
+		return true;
+	}
+
+	bool number_float(number_float_t val, const string_t&) override {
+		if (_in_lines) {
+			return false; // lines are only strings
+		}
+		_lines_key = false;
+		_addValue(val);
+		return true;
+	}
+
+	bool string(string_t& val) override {
+		if (_in_lines) {
+			return _line(val);
+		}
+		_lines_key = false;
+		_addValue(std::move(val));
+		return true;
+	}
+
+	bool binary(binary_t&) override {
+		return false; // not in json text
+	}
+
+	bool start_object(std::size_t) override {
+		if (_in_lines) {
+			return false; // lines are only strings
+		}
+		_lines_key = false;
+		_stack.push_back(_addValue(nlohmann::json::object()));
+		return true;
+	}
+
+	bool key(string_t& val) override {
+		_lines_key = val == "lines" && _inCommand();
+		_object_element = &(*_stack.back())[val];
+		return true;
+	}
+
+	bool end_object(void) override {
+		_stack.pop_back();
+		return true;
+	}
+
+	bool start_array(std::size_t) override {
+		if (_in_lines) {
+			return false; // lines are only strings
+		}
+
+		if (_lines_key) {
+			// the command gets no "lines", they go to text
+			_stack.back()->erase("lines");
+			_object_element = nullptr;
+
+			_lines_key = false;
+			_in_lines = true;
+			_first_line = true;
+			msg.lines_ranges.push_back({_stack[1]->size() - 1, msg.text.size(), msg.text.size()});
+			return true;
+		}
+
+		_stack.push_back(_addValue(nlohmann::json::array()));
+		return true;
+	}
+
+	bool end_array(void) override {
+		if (_in_lines) {
+			_in_lines = false;
+			msg.lines_ranges.back().end = msg.text.size();
+			return true;
+		}
+
+		_stack.pop_back();
+		return true;
+	}
+
+	bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override {
+		syntax_error = true;
+		return false;
+	}
+};
+
+enum class ParseResult {
+	ok,
+	invalid_json,
+	invalid_lines, // valid json, but lines that are not strings
+};
+
+inline ParseResult parseMessage(std::string_view view, Message& msg) {
+	msg.clear();
+	// the lines are never longer than their json
+	msg.text.reserve(view.size());
+
+	MessageSax sax {msg};
+	if (nlohmann::json::sax_parse(view.begin(), view.end(), &sax)) {
+		return ParseResult::ok;
+	}
+	return sax.syntax_error ? ParseResult::invalid_json : ParseResult::invalid_lines;
+}
+
+} // namespace vim
+
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// a thread per core, for the work of many documents
+//
+// every worker has two queues:
+//   owned:  tasks posted to its shard, only it runs them, in order. a document always posts to the
+//           same shard, so its crdt is only ever touched by one thread and needs no locks of its own.
+//   shared: sibling tasks that only read copies (encoding, writing snapshots, ...). the worker runs its
+//           own newest first, idle workers steal the oldest ones of the others, so a hot document
+//           does not keep the rest of its shard waiting.
+namespace work_pool {
+
+struct Pool {
+	using Task = std::function<void(void)>;
+
+	struct Worker {
+		std::mutex mutex; // guards the queues, also what it sleeps on
+		std::condition_variable cv;
+		std::deque<Task> owned;
+		std::deque<Task> shared;
+		std::thread thread;
+	};
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::atomic_bool _quit {false};
+
+	// shared tasks waiting in any queue, so sleeping workers know there is something to steal
+	std::atomic_size_t _stealable {0};
+
+	// queued + running, for wait()
+	std::mutex _pending_mutex;
+	std::condition_variable _pending_cv;
+	size_t _pending {0};
+
+	std::atomic_size_t _next_shared {0}; // where shared tasks from outside go
+
+	std::atomic_size_t stolen {0}; // stats, tasks run by another worker than the one they were queued on
+
+	Pool(void) = default;
+	explicit Pool(size_t thread_count) { start(thread_count); }
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+	~Pool(void) { stop(); }
+
+	// the index of the worker the calling thread is, if it is one of ours
+	static size_t& _currentIdx(void) {
+		static thread_local size_t idx {SIZE_MAX};
+		return idx;
+	}
+
+	void start(size_t thread_count) {
+		if (thread_count == 0) {
+			thread_count = 1;
+		}
+
+		_quit = false;
+		for (size_t i = 0; i < thread_count; i++) {
+			_workers.push_back(std::make_unique<Worker>());
+		}
+		// all of them exist before the first one could steal
+		for (size_t i = 0; i < _workers.size(); i++) {
+			_workers[i]->thread = std::thread(&Pool::_run, this, i);
+		}
+	}
+
+	// runs what is already queued, then joins the workers
+	void stop(void) {
+		if (_workers.empty()) {
+			return;
+		}
+
+		wait();
+
+		_quit = true;
+		for (auto& worker : _workers) {
+			{ std::lock_guard lg{worker->mutex}; } // not between its check and the wait
+			worker->cv.notify_one();
+		}
+		for (auto& worker : _workers) {
+			worker->thread.join();
+		}
+		_workers.clear();
+	}
+
+	[[nodiscard]] size_t size(void) const {
+		return _workers.size();
+	}
+
+	[[nodiscard]] size_t shardOf(size_t key) const {
+		return _workers.empty() ? 0u : key % _workers.size();
+	}
+
+	// runs on the worker of shard (eg. the hash of a document), after everything posted there before.
+	// without workers it runs right away
+	void post(size_t shard, Task task) {
+		if (_workers.empty()) {
+			task();
+			return;
+		}
+
+		_addPending();
+
+		auto& worker = *_workers[shardOf(shard)];
+		{
+			std::lock_guard lg{worker.mutex};
+			worker.owned.push_back(std::move(task));
+		}
+		worker.cv.notify_one();
+	}
+
+	// runs on any worker, no order. from a worker it goes into its own queue (its caches are warm)
+	void spawn(Task task) {
+		if (_workers.empty()) {
+			task();
+			return;
+		}
+
+		_addPending();
+
+		size_t idx = _currentIdx();
+		if (idx >= _workers.size()) {
+			idx = _next_shared++ % _workers.size();
+		}
+
+		{
+			auto& worker = *_workers[idx];
+			std::lock_guard lg{worker.mutex};
+			worker.shared.push_back(std::move(task));
+			_stealable++;
+		}
+
+		// whoever sleeps can steal it
+		for (auto& worker : _workers) {
+			{ std::lock_guard lg{worker->mutex}; } // not between its check and the wait
+			worker->cv.notify_one();
+		}
+	}
+
+	// until every queued task ran, including the ones they posted/spawned. not from a worker
+	void wait(void) {
+		std::unique_lock ul{_pending_mutex};
+		_pending_cv.wait(ul, [this]() { return _pending == 0; });
+	}
+
+	void _addPending(void) {
+		std::lock_guard lg{_pending_mutex};
+		_pending++;
+	}
+
+	void _donePending(void) {
+		std::lock_guard lg{_pending_mutex};
+		if (--_pending == 0) {
+			_pending_cv.notify_all();
+		}
+	}
+
+	// own shard first, then own siblings (newest), then the oldest sibling of someone else
+	bool _next(size_t idx, Task& task) {
+		auto& self = *_workers[idx];
+		{
+			std::lock_guard lg{self.mutex};
+			if (!self.owned.empty()) {
+				task = std::move(self.owned.front());
+				self.owned.pop_front();
+				return true;
+			}
+			if (!self.shared.empty()) {
+				task = std::move(self.shared.back());
+				self.shared.pop_back();
+				_stealable--;
+				return true;
+			}
+		}
+
+		if (_stealable == 0) {
+			return false;
+		}
+
+		for (size_t i = 1; i < _workers.size(); i++) {
+			auto& victim = *_workers[(idx + i) % _workers.size()];
+			std::lock_guard lg{victim.mutex};
+			if (!victim.shared.empty()) {
+				task = std::move(victim.shared.front());
+				victim.shared.pop_front();
+				_stealable--;
+				stolen++;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void _run(size_t idx) {
+		_currentIdx() = idx;
+		auto& self = *_workers[idx];
+
+		Task task;
+		while (true) {
+			if (_next(idx, task)) {
+				task();
+				task = nullptr; // captures go now, not with the next task
+				_donePending();
+				continue;
+			}
+
+			std::unique_lock ul{self.mutex};
+			self.cv.wait(ul, [&]() {
+				return _quit || !self.owned.empty() || !self.shared.empty() || _stealable != 0;
+			});
+
+			if (_quit && self.owned.empty() && self.shared.empty()) {
+				return;
+			}
+		}
+	}
+};
+
+} // namespace work_pool
+